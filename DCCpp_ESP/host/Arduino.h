@@ -0,0 +1,22 @@
+/**********************************************************************
+ Arduino.h
+ Part of DCC++ BASE STATION for the Arduino / ESP8266
+ **********************************************************************/
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/*
+ * Just enough of the Arduino core for the host checks of the ESP's own headers (see host/QueueCheck.cpp): micros(),
+ * which the check defines, and a String that is a std::string.
+ */
+unsigned long micros();
+
+class String {
+	std::string s;
+public:
+	String(const char *text = "") : s(text) {}
+	const char *c_str() const { return s.c_str(); }
+	size_t length() const { return s.size(); }
+};
@@ -0,0 +1,183 @@
+/**********************************************************************
+ ParserBench.cpp
+ Part of DCC++ BASE STATION for the Arduino / ESP8266
+ **********************************************************************/
+
+/*
+ * Commands per second and heap allocations of reading the commands of PARSER_CLIENTS clients whose bytes arrive
+ * in chunks of random size, interleaved between the clients: CommandParser (see CommandParser.h) against the
+ * vector the clients had before, which inserted each chunk at its end, erased what it used from its front and
+ * made a string of each command (a std::string here, which unlike the ESP's String keeps short ones off the
+ * heap).  Both must hand every client exactly the commands it sent.
+ *
+ *   parser_bench [seconds per case]
+ */
+
+#include "CommandParser.h"
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#define PARSER_CLIENTS 10
+#define PARSER_COMMANDS 2000     // per client
+#define PARSER_CHUNK_MAX 32      // bytes
+
+namespace {
+	size_t allocations;
+	uint32_t sink;
+
+	class VectorParser {
+		std::vector<uint8_t> buffer;
+	public:
+		template<class Emit> void push_back(const uint8_t *data, size_t len, Emit &&emit)
+		{
+			buffer.insert(buffer.end(), data, data + len);
+			auto s = buffer.begin();
+			auto consumed = buffer.begin();
+			for(; s != buffer.end();) {
+				s = std::find(s, buffer.end(), '<');
+				auto e = std::find(s, buffer.end(), '>');
+				if(s != buffer.end() && e != buffer.end()) {
+					*e = 0;
+					std::string str(reinterpret_cast<char*>(&*s));
+					str += '>';
+					emit(str.c_str(), str.size());
+					consumed = e + 1;
+				}
+				s = e;
+			}
+			buffer.erase(buffer.begin(), consumed);
+		}
+	};
+
+	class RingParser {
+		CommandParser<64> parser;          // COMMAND_TEXT_MAX
+	public:
+		template<class Emit> void push_back(const uint8_t *data, size_t len, Emit &&emit)
+		{
+			parser.feed(data, len, emit);
+		}
+	};
+
+	struct Chunk {
+		int client;
+		size_t at;
+		size_t length;
+	};
+
+	std::string streams[PARSER_CLIENTS];
+	std::vector<Chunk> chunks;
+
+	void makeInput()
+	{
+		std::mt19937 random(2560);
+		for(int c = 0; c < PARSER_CLIENTS; c++) {
+			for(int i = 0; i < PARSER_COMMANDS; i++) {
+				char command[48];
+				switch(random() % 4) {
+					case 0: snprintf(command, sizeof(command), "<t %d %d %d 1>", c + 1, 1000 + c, (int)(random() % 127)); break;
+					case 1: snprintf(command, sizeof(command), "<T %d %d>", (int)(random() % 200), (int)(random() % 2)); break;
+					case 2: snprintf(command, sizeof(command), "<Z %d %d>\r\n", (int)(random() % 50), (int)(random() % 2)); break;
+					default: snprintf(command, sizeof(command), "<s>"); break;
+				}
+				streams[c] += command;
+			}
+		}
+		size_t at[PARSER_CLIENTS] = {};
+		for(bool more = true; more;) {
+			size_t round = chunks.size();
+			more = false;
+			for(int c = 0; c < PARSER_CLIENTS; c++) {
+				size_t n = std::min<size_t>(1 + random() % PARSER_CHUNK_MAX, streams[c].size() - at[c]);
+				if(n) {
+					chunks.push_back(Chunk{c, at[c], n});
+					at[c] += n;
+					more = true;
+				}
+			}
+			std::shuffle(chunks.begin() + round, chunks.end(), random);   // at most one chunk of each client
+		}
+	}
+
+	// Feeds all chunks, each client to its own parser or all to parsers[0]; returns the number of clients whose
+	// commands come out different from what they sent.
+	template<class Parser> size_t feed(Parser *parsers, bool shared)
+	{
+		std::string got[PARSER_CLIENTS];
+		for(const Chunk &k : chunks) {
+			auto &out = got[k.client];
+			parsers[shared ? 0 : k.client].push_back(
+				reinterpret_cast<const uint8_t *>(streams[k.client].data()) + k.at, k.length,
+				[&out](const char *command, size_t length) { out.append(command, length); });
+		}
+		size_t wrong = 0;
+		for(int c = 0; c < PARSER_CLIENTS; c++) {
+			std::string sent;
+			for(char ch : streams[c]) {
+				if(ch != '\r' && ch != '\n') {
+					sent += ch;
+				}
+			}
+			wrong += sent != got[c];
+		}
+		return wrong;
+	}
+
+	template<class Parser> void run(const char *name, double seconds)
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t commands = 0, before = allocations;
+		double t;
+		do {
+			Parser parsers[PARSER_CLIENTS];
+			for(const Chunk &k : chunks) {
+				parsers[k.client].push_back(
+					reinterpret_cast<const uint8_t *>(streams[k.client].data()) + k.at, k.length,
+					[](const char *command, size_t length) { sink += command[1] + length; });
+			}
+			commands += PARSER_CLIENTS * PARSER_COMMANDS;
+			t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		} while(t < seconds);
+		Parser parsers[PARSER_CLIENTS];
+		printf("%-8s %14.0f %14.2f %14zu\n", name, commands / t, (double)(allocations - before) / commands,
+			feed(parsers, false));
+	}
+}
+
+void *operator new(size_t n)
+{
+	allocations++;
+	if(void *p = malloc(n)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+int main(int argc, char **argv)
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+	makeInput();
+	printf("%d clients, %d commands each, in %zu chunks of 1-%d bytes\n", PARSER_CLIENTS, PARSER_COMMANDS,
+		chunks.size(), PARSER_CHUNK_MAX);
+	printf("%-8s %14s %14s %14s\n", "parser", "commands/s", "allocs/cmd", "clients wrong");
+	run<VectorParser>("vector", seconds);
+	run<RingParser>("ring", seconds);
+	RingParser shared[1];
+	printf("one parser for all clients: %zu of %d clients get wrong commands\n", feed(shared, true), PARSER_CLIENTS);
+	return 0;
+}
@@ -0,0 +1,288 @@
+/**********************************************************************
+ QueueCheck.cpp
+ Part of DCC++ BASE STATION for the Arduino / ESP8266
+ **********************************************************************/
+
+/*
+ * Checks of the ESP's pending command queue (see PendingQueue.h and CommandQueue.h), meant to be built with
+ * -fsanitize=thread as env:queuecheck does.
+ *
+ * First 1, 2, 4 and 8 producer threads, each a client of its own, push QUEUE_CHECK_COMMANDS commands each while
+ * one consumer pops: each producer's commands must come out in the order it pushed them, every push the queue
+ * refused must be counted in dropped or overShare, and the high-water mark must stay within the queue.  Then, on
+ * one thread, the cases where a stop supersedes commands queued before it: eight emergency stops and a <0> with the
+ * urgent lane overflowing into the normal one, <0> against <1 NAME>, and <0 NAME> against <1>.  Last, fairness:
+ * a client flooding the queue while three others push a command now and then, first with nothing popping and then
+ * against a consumer thread that pops slower than the flood comes; the three must have none of theirs refused.
+ *
+ *   queue_check [COMMANDS per producer]
+ *
+ * Prints each check; exits 1 on a failure.
+ */
+
+#include "PendingQueue.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define QUEUE_CHECK_COMMANDS 100000
+
+unsigned long micros()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+namespace {
+	bool check(bool ok, const char *what)
+	{
+		printf("  %-64s %s\n", what, ok ? "ok" : "FAILED");
+		return ok;
+	}
+
+	bool push(PendingQueue &q, const char *text)
+	{
+		return q.push(text, strlen(text));
+	}
+
+	// Pops everything queued, and returns the commands in the order they came out, separated by spaces.
+	std::string drain(PendingQueue &q)
+	{
+		std::string out;
+		DCCpp::Server::Command c;
+		while (q.pop(c)) {
+			if (c.op) {
+				char buf[48];
+				snprintf(buf, sizeof(buf), "<%c %d %d %d %d>", c.op, c.args[0], c.args[1], c.args[2], c.args[3]);
+				out += buf;
+			} else {
+				out += c.text;
+			}
+			out += ' ';
+		}
+		return out;
+	}
+
+	bool producers(int n, long commands)
+	{
+		PendingQueue q;
+		std::vector<long> refused(n, 0);
+		std::vector<std::thread> threads;
+		std::atomic<int> running{n};
+		for (int p = 0; p < n; p++) {
+			threads.emplace_back([&q, &refused, &running, p, commands] {
+				char text[COMMAND_TEXT_MAX];
+				for (long i = 0; i < commands; i++) {
+					int length = snprintf(text, sizeof(text), "<s %d %ld>", p, i);
+					if (!q.push(text, length, 1 + p)) {
+						refused[p]++;
+						std::this_thread::yield();
+					}
+				}
+				running.fetch_sub(1, std::memory_order_release);
+			});
+		}
+		std::vector<long> last(n, -1), got(n, 0);
+		bool ordered = true;
+		DCCpp::Server::Command c;
+		for (;;) {
+			bool done = running.load(std::memory_order_acquire) == 0;
+			while (q.pop(c)) {
+				char *e;
+				int p = strtol(c.text + 3, &e, 10);
+				long i = strtol(e, nullptr, 10);
+				ordered &= p >= 0 && p < n && i > last[p];
+				last[p] = i;
+				got[p]++;
+			}
+			if (done) {
+				break;
+			}
+			std::this_thread::yield();
+		}
+		for (std::thread &t : threads) {
+			t.join();
+		}
+		long pushed = 0, popped = 0, dropped = 0;
+		bool counted = true;
+		for (int p = 0; p < n; p++) {
+			counted &= got[p] + refused[p] == commands;
+			pushed += commands;
+			popped += got[p];
+			dropped += refused[p];
+		}
+		printf("%d producers: %ld pushed, %ld popped, %ld refused, high water %u of %u\n", n, pushed, popped, dropped,
+			q.normal.highWater.load(), q.normal.size());
+		bool ok = true;
+		ok &= check(ordered, "each producer's commands came out in the order it pushed them");
+		ok &= check(counted, "every command either came out or was refused");
+		ok &= check(q.normal.dropped.load() + q.overShare.load() == dropped && q.normal.dequeued.load() == popped,
+			"dropped, overShare and dequeued match the refused and popped commands");
+		bool none = true;
+		for (int p = 0; p < n; p++) {
+			none &= q.waitingFor(1 + p).load() == 0;
+		}
+		ok &= check(none, "no command is counted as waiting once all were popped");
+		ok &= check(q.normal.highWater.load() >= 1
+				&& q.normal.highWater.load() <= std::min<uint32_t>(q.normal.size(), n * QUEUE_CLIENT_SHARE),
+			"the high-water mark is within the queue and the producers' shares");
+		ok &= check(q.urgent.dequeued.load() == 0 && q.superseded == 0, "nothing went to the urgent lane or was superseded");
+		return ok;
+	}
+
+	bool emergencyStops()
+	{
+		PendingQueue q;
+		char text[COMMAND_TEXT_MAX];
+		for (int r = 1; r <= 8; r++) {
+			snprintf(text, sizeof(text), "<t %d %d 50 1>", r, 100 + r);
+			push(q, text);
+		}
+		push(q, "<1 MAIN>");
+		push(q, "<1 PROG>");
+		push(q, "<0>");
+		for (int r = 1; r <= 8; r++) {
+			DCCpp::Server::Command c;
+			c.op = 't';
+			c.n = 4;
+			c.args[0] = r;
+			c.args[1] = 100 + r;
+			c.args[2] = -1;
+			c.args[3] = 1;
+			q.push(c);
+		}
+		std::string out = drain(q);
+		printf("eight throttles and two <1 NAME>, then <0> and eight emergency stops:\n  %s\n", out.c_str());
+		bool ok = true;
+		ok &= check(q.urgent.dropped.load() == 1, "the last stop found the urgent lane full");
+		ok &= check(out.compare(0, 9, "<0> <t 1 ") == 0, "<0> and the stops ran first");
+		ok &= check(out.find("<t 1 101 50 1>") == std::string::npos && out.find("<t 7 107 50 1>") == std::string::npos,
+			"the throttles queued before their stops were dropped");
+		ok &= check(out.find("<1 ") == std::string::npos, "both <1 NAME> queued before <0> were dropped");
+		ok &= check(out.size() > 15 && out.compare(out.size() - 15, 15, "<t 8 108 -1 1> ") == 0,
+			"the stop that overflowed into the normal lane still ran, last");
+		ok &= check(out.find("<t 8 108 50 1>") < out.find("<t 8 108 -1 1>"),
+			"the throttle queued before it in the same lane ran before it");
+		ok &= check(q.superseded == 9, "nine commands were counted as superseded");
+		return ok;
+	}
+
+	bool powerDistricts()
+	{
+		bool ok = true;
+		PendingQueue q;
+		push(q, "<1>");
+		push(q, "<1 MAIN>");
+		push(q, "<1 PROG>");
+		push(q, "<0 MAIN>");
+		std::string out = drain(q);
+		printf("<1>, <1 MAIN>, <1 PROG>, then <0 MAIN>:\n  %s\n", out.c_str());
+		ok &= check(out == "<0 MAIN> <1 PROG> ", "<0 MAIN> drops <1> and <1 MAIN> but not <1 PROG>");
+
+		push(q, "<1 MAIN>");
+		push(q, "<0 PROG>");
+		push(q, "<1>");
+		out = drain(q);
+		printf("then <1 MAIN>, <0 PROG>, <1>:\n  %s\n", out.c_str());
+		ok &= check(out == "<0 PROG> <1 MAIN> <1> ", "a power on queued after the stop runs");
+		return ok;
+	}
+
+	bool fairness()
+	{
+		bool ok = true;
+		PendingQueue q;
+		char text[COMMAND_TEXT_MAX];
+		long refused[5] = {};
+		for (int i = 0; i < 200; i++) {
+			int length = snprintf(text, sizeof(text), "<s 1 %d>", i);
+			refused[1] += !q.push(text, length, 1);
+			if (i % 20 == 0) {
+				for (uint8_t c = 2; c <= 4; c++) {
+					length = snprintf(text, sizeof(text), "<s %u %d>", c, i);
+					refused[c] += !q.push(text, length, c);
+				}
+			}
+		}
+		DCCpp::Server::Command stop;
+		stop.op = 't';
+		stop.n = 4;
+		stop.args[0] = 1;
+		stop.args[1] = 3;
+		stop.args[2] = -1;
+		stop.args[3] = 1;
+		stop.client = 1;
+		bool stopped = q.push(stop);
+		std::string out = drain(q);
+		printf("client 1 pushes 200 commands with nothing popping, clients 2 to 4 one each every 20:\n"
+			"  client 1 had %ld refused, the others %ld, %ld and %ld\n", refused[1], refused[2], refused[3], refused[4]);
+		ok &= check(refused[2] + refused[3] + refused[4] == 0, "none of the other clients' commands was refused");
+		ok &= check(200 - refused[1] == QUEUE_CLIENT_SHARE && q.overShare.load() == refused[1],
+			"the flooding client got its share in, the rest counted in overShare");
+		ok &= check(stopped && out.compare(0, 13, "<t 1 3 -1 1> ") == 0, "its emergency stop still went in, and ran first");
+
+		// the same against a consumer that pops slower than the flood pushes
+		PendingQueue r;
+		std::atomic<bool> flooding{true};
+		std::atomic<long> floodRefused{0}, othersRefused{0};
+		std::thread flood([&r, &flooding, &floodRefused] {
+			char text[COMMAND_TEXT_MAX];
+			for (long i = 0; flooding.load(std::memory_order_relaxed); i++) {
+				int length = snprintf(text, sizeof(text), "<s 1 %ld>", i);
+				floodRefused += !r.push(text, length, 1);
+			}
+		});
+		std::atomic<int> running{3};
+		std::vector<std::thread> others;
+		for (uint8_t c = 2; c <= 4; c++) {
+			others.emplace_back([&r, &othersRefused, &running, c] {
+				char text[COMMAND_TEXT_MAX];
+				for (int i = 0; i < 100; i++) {
+					int length = snprintf(text, sizeof(text), "<s %u %d>", c, i);
+					othersRefused += !r.push(text, length, c);
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+				running.fetch_sub(1, std::memory_order_release);
+			});
+		}
+		long got[5] = {};
+		DCCpp::Server::Command c;
+		while (running.load(std::memory_order_acquire) > 0) {
+			if (r.pop(c)) {
+				got[c.text[3] - '0']++;
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(10));
+		}
+		flooding = false;
+		flood.join();
+		for (std::thread &t : others) {
+			t.join();
+		}
+		while (r.pop(c)) {
+			got[c.text[3] - '0']++;
+		}
+		printf("client 1 floods a slower consumer while clients 2 to 4 push 100 each:\n"
+			"  client 1 had %ld run and %ld refused, the others %ld, %ld and %ld run and %ld refused\n", got[1],
+			floodRefused.load(), got[2], got[3], got[4], othersRefused.load());
+		ok &= check(othersRefused.load() == 0 && got[2] == 100 && got[3] == 100 && got[4] == 100,
+			"every command of the other clients ran");
+		ok &= check(r.normal.dropped.load() == 0, "the normal lane was never full");
+		return ok;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	long commands = argc > 1 ? atol(argv[1]) : QUEUE_CHECK_COMMANDS;
+	bool ok = true;
+	for (int n : {1, 2, 4, 8}) {
+		ok &= producers(n, commands);
+	}
+	ok &= emergencyStops();
+	ok &= powerDistricts();
+	ok &= fairness();
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,10 @@
+/**********************************************************************
+ Stream.h
+ Part of DCC++ BASE STATION for the Arduino / ESP8266
+ **********************************************************************/
+#pragma once
+#include <Arduino.h>
+
+// Only named by DCCpp_ESP.h in the host checks.
+class Print;
+class Stream;
@@ -1,9 +1,9 @@
 #include "config.h"
 #include "CabCache.h"
 #include "DCCpp_ESP.h"
+#include "../../DCCpp_Uno/src/Log.h"
 #include "ArduinoJson.h"
 #include "AsyncJson.h"
-#include "StreamString.h"
 #include <algorithm>
 
 CabCache::CabCache(String const& url)
@@ -54,27 +54,25 @@ void CabCache::handleReq(AsyncWebSocket * server, AsyncWebSocketClient * client,
 	switch(type) {
 		case WS_EVT_CONNECT:
 			mClientBuf[client->id()] = {};
-			Serial.printf("[WS] new client %d\n", client->id());
+			LOG(LOG_CABS, LOG_INFO, LOG_CAB_CLIENT, client->id(), type);
 			pushUpdates(-1, client);
 			break;
 		case WS_EVT_DISCONNECT:
 			mClientBuf.erase(client->id());
-			Serial.printf("[WS] disconnect client %d\n", client->id());
+			LOG(LOG_CABS, LOG_INFO, LOG_CAB_CLIENT, client->id(), type);
 			break;
 		case WS_EVT_PONG:
-			Serial.printf("[WS] pong client %d\n", client->id());
+			LOG(LOG_CABS, LOG_DEBUG, LOG_CAB_CLIENT, client->id(), type);
 			break;
 		case WS_EVT_ERROR:
-			Serial.printf("[WS] error on client %d\n", client->id());
+			LOG(LOG_CABS, LOG_WARN, LOG_CAB_CLIENT, client->id(), type);
 			//well..
 			break;
 		case WS_EVT_DATA:
 			auto info = reinterpret_cast<AwsFrameInfo const*>(arg);
 			auto& buffer = mClientBuf[client->id()];
 
-			Serial.printf("[WS] client data %d\n", client->id());
-			Serial.printf("[WS]   info: index %d len %d final: %d part len %d\n",
-			                            (int)info->index, (int)info->len, (int)info->final, len);
+			LOG(LOG_CABS, LOG_DEBUG, LOG_CAB_FRAME, client->id(), info->index, len, info->final);
             // First packet
             if (info->index == 0) {
                 if(info->len > MAX_WEBSOCKET_DATA_SIZE)
@@ -90,7 +88,6 @@ void CabCache::handleReq(AsyncWebSocket * server, AsyncWebSocketClient * client,
 
             // Last packet
             if (info->index + len == info->len && info->final) {
-				Serial.printf("Found fill packet '%s'\n", buffer.c_str());
                 handleReq(client, buffer);
                 buffer.clear();
             }
@@ -102,8 +99,7 @@ void CabCache::handleReq(AsyncWebSocketClient * client, std::string& message)
 	DynamicJsonBuffer buffer;
 	auto& json = buffer.parseObject(const_cast<char*>(message.c_str()));
 	char const* type = json["type"];
-	Serial.printf("[CC] handles input! type='%s' ", type ? type : "null");
-	json.printTo(Serial);
+	LOG(LOG_CABS, LOG_DEBUG, LOG_CAB_MESSAGE, type ? type[0] : '-');
 
 	if(!type) return;
 	else if(strcmp(type, "command") == 0) {
@@ -115,11 +111,9 @@ void CabCache::handleReq(AsyncWebSocketClient * client, std::string& message)
 		int speed = json["speed"].as<int>();
 		int direction = speed < 0 ? 0 : 1;
 		speed = abs(speed);
-		StreamString msg;
 		auto reg = json["register"];
-		msg.printf(PSTR("<t%d %d %d %d>"), reg ? reg.as<int>() : 10,
+		DCCpp::Server::pushThrottle(reg ? reg.as<int>() : 10,
 			json["id"].as<int>(), speed, direction);
-		DCCpp::Server::pushPendingDCCCommand(std::move(msg));
 	}
 
 }
@@ -0,0 +1,59 @@
+/**********************************************************************
+ CommandParser.h
+ Part of DCC++ BASE STATION for the Arduino / ESP8266
+ **********************************************************************/
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Finds the commands <...> in the bytes one client sends, however they are split into chunks.  Only the command
+ * being read is kept from one chunk to the next, in a buffer of SIZE bytes, so nothing is allocated or moved.
+ * Each complete command is handed to emit(const char *command, size_t length), with its < and > and followed by
+ * a 0 that length does not count; command is only valid during the call.
+ *
+ * Bytes outside <...> are skipped.  A < starts the command again, so a client that lost a > loses one command
+ * only.  A command that needs more than SIZE bytes with its 0 is skipped up to its > and counted in dropped.
+ */
+template<size_t SIZE>
+class CommandParser {
+	static_assert(SIZE >= 3, "CommandParser needs room for <>");
+public:
+	template<class Emit> void feed(const uint8_t *data, size_t n, Emit &&emit);
+	void clear() { length = 0; overlong = false; }
+	uint32_t dropped = 0;
+private:
+	char command[SIZE];
+	size_t length = 0;        // 0 outside a command
+	bool overlong = false;    // the command being read does not fit, wait for its >
+};
+
+template<size_t SIZE>
+template<class Emit>
+void CommandParser<SIZE>::feed(const uint8_t *data, size_t n, Emit &&emit)
+{
+	for(const uint8_t *end = data + n; data < end; data++) {
+		char c = *data;
+		if(c == '<') {
+			command[0] = c;
+			length = 1;
+			overlong = false;
+		} else if(length == 0) {
+			continue;
+		} else if(overlong) {
+			if(c == '>') {
+				dropped++;
+				length = 0;
+			}
+		} else if(c == '>') {
+			command[length++] = c;
+			command[length] = 0;
+			emit(command, length);
+			length = 0;
+		} else if(length + 2 < SIZE) {    // leaves room for the > and the 0
+			command[length++] = c;
+		} else {
+			overlong = true;
+		}
+	}
+}
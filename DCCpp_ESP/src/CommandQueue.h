@@ -0,0 +1,104 @@
+/**********************************************************************
+ CommandQueue.h
+ Part of DCC++ BASE STATION for the Arduino / ESP8266
+ **********************************************************************/
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <stdint.h>
+
+/*
+ * Bounded queue of fixed-size slots that any number of tasks push to without a lock, and that one task pops
+ * from (the loop task, in DCCpp::Server::loop).  Each slot carries a sequence number: a producer claims the
+ * slot at the tail by moving the tail on with compare-and-swap, copies its value in and then publishes it by
+ * setting the sequence, so the consumer never sees a half written slot.  A push to a full queue fails at once
+ * and is counted; nothing here waits.
+ *
+ * The counters may be read from any task while the queue is in use.
+ */
+template<class T, uint32_t N>
+class CommandQueue {
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "CommandQueue size must be a power of two");
+public:
+	CommandQueue() {
+		for(uint32_t i = 0; i < N; i++) {
+			slots[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+	bool push(const T &value);
+	bool pop(T &value);                              // consumer only
+	uint32_t count() const {
+		return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_relaxed);
+	}
+	static constexpr uint32_t size() { return N; }
+
+	std::atomic<uint32_t> dropped{0};                // pushes refused because the queue was full
+	std::atomic<uint32_t> highWater{0};              // most values queued at once
+	std::atomic<uint32_t> dequeued{0};
+	std::atomic<uint32_t> latencyMax{0};             // longest a value waited, in microseconds
+	std::atomic<uint32_t> latencySum{0};             // of all dequeued values, wraps
+private:
+	struct Slot {
+		std::atomic<uint32_t> seq;                   // position + 1 once the value at position is published
+		uint32_t queuedAt;
+		T value;
+	};
+	Slot slots[N];
+	std::atomic<uint32_t> tail{0};
+	std::atomic<uint32_t> head{0};                   // written by the consumer only
+};
+
+template<class T, uint32_t N>
+bool CommandQueue<T, N>::push(const T &value)
+{
+	uint32_t pos = tail.load(std::memory_order_relaxed);
+	Slot *slot;
+	for(;;) {
+		slot = &slots[pos & (N - 1)];
+		int32_t diff = (int32_t)(slot->seq.load(std::memory_order_acquire) - pos);
+		if(diff == 0) {
+			if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if(diff < 0) {
+			// the slot still holds the value from N positions back
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		} else {
+			pos = tail.load(std::memory_order_relaxed);
+		}
+	}
+	slot->value = value;
+	slot->queuedAt = micros();
+	slot->seq.store(pos + 1, std::memory_order_release);
+
+	int32_t used = (int32_t)(pos + 1 - head.load(std::memory_order_relaxed));
+	if(used <= 0) {
+		return true;                                 // the consumer has popped it, and more, already
+	}
+	uint32_t most = highWater.load(std::memory_order_relaxed);
+	while((uint32_t)used > most && !highWater.compare_exchange_weak(most, (uint32_t)used, std::memory_order_relaxed)) {
+	}
+	return true;
+}
+
+template<class T, uint32_t N>
+bool CommandQueue<T, N>::pop(T &value)
+{
+	uint32_t pos = head.load(std::memory_order_relaxed);
+	Slot &slot = slots[pos & (N - 1)];
+	if(slot.seq.load(std::memory_order_acquire) != pos + 1) {
+		return false;
+	}
+	value = slot.value;
+	uint32_t latency = micros() - slot.queuedAt;
+	slot.seq.store(pos + N, std::memory_order_release);
+	head.store(pos + 1, std::memory_order_relaxed);
+
+	dequeued.fetch_add(1, std::memory_order_relaxed);
+	latencySum.fetch_add(latency, std::memory_order_relaxed);
+	if(latency > latencyMax.load(std::memory_order_relaxed)) {
+		latencyMax.store(latency, std::memory_order_relaxed);
+	}
+	return true;
+}
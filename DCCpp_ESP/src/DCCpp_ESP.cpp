@@ -23,18 +23,21 @@
 #include "config.h"
 #include "DCCpp_ESP.h"
 #include "Queue.h"
+#include "PendingQueue.h"
+#include "ReplyEvent.h"
+#include "CommandParser.h"
 #include "PowerDistrict.h"
 #include "Sensor.h"
 #include "Output.h"
 #include "Turnout.h"
 #include "ProgramRequest.h"
 #include "CabCache.h"
+#include "../../DCCpp_Uno/src/Topics.h"
+#include "../../DCCpp_Uno/src/Log.h"
 
 #include <StreamString.h>
 #include <string.h>
 #include <sstream>
-#include <mutex>
-#include <freertos/semphr.h>
 
 #define UNUSED(x) (void)(x)
 namespace {
@@ -44,22 +47,52 @@ AsyncWebServer webServer(80);
 AsyncWebSocket webSocket("/ws");
 CabCache cabServer{"/cabs"};
 
-struct PendingQueue {
-	SemaphoreHandle_t m = xSemaphoreCreateMutex();
-	Queue<String> q{64};
-	auto acquire() { return std::unique_lock<PendingQueue>{ *this };}
-	bool empty() const { return q.empty(); }
-	auto pop() { return q.pop(); }
-	void push(String s) { auto l = acquire(); q.push(std::move(s)); }
-	auto count() { auto l = acquire(); return q.count();}
-	void lock() {xSemaphoreTake(m, portMAX_DELAY);}
-	void unlock() {xSemaphoreGive(m);}
-};
-
 PendingQueue DCCppPendingCommands;
 
+#define ANSWERS_PENDING 16        // commands written to the base station whose answers may still come
+#define ANSWER_TIMEOUT_MS 1000    // longest the answers to one command are waited for
+
+// The client a reply answers, which gets it whatever topics it subscribed to.  With a dispatcher the base station
+// answers while it runs the command.  Over the serial line, ESPInterface ends the answers to each command the ESP
+// wrote with <iESP-ran>, so the replies before it answer the oldest command written; a command whose end got lost
+// is given up after ANSWER_TIMEOUT_MS, and when more are written than this remembers the oldest is forgotten.
+struct AnswerRouting {
+	uint8_t clients[ANSWERS_PENDING];
+	uint8_t head = 0;
+	uint8_t count = 0;
+	unsigned long since = 0;     // when the oldest command started to be answered
+	uint8_t running = 0;         // client of the command the dispatcher runs now
+	void written(uint8_t client) {
+		if (count == ANSWERS_PENDING) {
+			ran();
+		}
+		if (count == 0) {
+			since = millis();
+		}
+		clients[(head + count++) % ANSWERS_PENDING] = client;
+	}
+	void ran() {
+		if (count > 0) {
+			head = (head + 1) % ANSWERS_PENDING;
+			count--;
+			since = millis();
+		}
+	}
+	uint8_t answering() {
+		if (running) {
+			return running;
+		}
+		while (count > 0 && millis() - since > ANSWER_TIMEOUT_MS) {
+			ran();
+		}
+		return count > 0 ? clients[head] : 0;
+	}
+};
+AnswerRouting answerTo;
+
 Print* write_to_dccpp;
 Stream* read_from_dccpp;
+DCCpp::Server::Dispatcher* dispatcher = nullptr;
 
 String currentDCCppCommand = "";
 bool inDCCPPCommand = false;
@@ -143,52 +176,62 @@ void turnoutStatusCallback() {
 		DCCppPendingCommands.push(F("<T>"));
 	}
 }
+// Reads the commands of one TCP or websocket client, see CommandParser.h.
 class PartialCommandParser {
-	std::vector<uint8_t> buffer;
+	CommandParser<COMMAND_TEXT_MAX> parser;
 public:
-	auto alloc_push(size_t len)
-	{
-		auto read_dest = buffer.insert(buffer.end(), len + 1, 0);
-		return read_dest;
+	uint8_t client = 0;          // tags the commands, set once in DCCpp::Server::setup
+	uint8_t topics = TOPIC_ALL;  // set by <U SUB TOPIC ...>, which is answered here instead of being passed on
+	String answer;               // reply to <U SUB>, for the owner to send to its client
+	// replies since the client connected: passed on, and left out by its topics with the bytes that saved
+	uint32_t sent = 0;
+	uint32_t filtered = 0;
+	uint32_t saved = 0;
+	bool gets(uint8_t topic, uint8_t answering) const {
+		return topic == TOPIC_NONE || (topics & topic) || (answering != 0 && answering == client);
 	}
-	void commit_push(std::vector<uint8_t>::iterator read_dest, size_t added)
-	{
-		buffer.erase(read_dest + added, buffer.end()); //to handle if we got < len
-		handle_content();
+	// Like gets, and counts the reply of length bytes as sent or filtered.
+	bool offer(uint8_t topic, uint8_t answering, size_t length) {
+		if (gets(topic, answering)) {
+			sent++;
+			return true;
+		}
+		filtered++;
+		saved += length;
+		return false;
 	}
-	void push_back(uint8_t* data, size_t len)
+	void push_back(const uint8_t* data, size_t len)
 	{
-		buffer.insert(buffer.end(), data, data + len);
-		handle_content();
+		parser.feed(data, len, [this](const char *command, size_t length) {
+			if(strncmp(command, "<U SUB", 6) == 0 && (command[6] == ' ' || command[6] == '>')) {
+				subscribe(command + 6);
+			} else {
+				LOG(LOG_WEB, LOG_DEBUG, LOG_QUEUED, command[1], DCCppPendingCommands.count());
+				DCCppPendingCommands.push(command, length, client);
+			}
+		});
 	}
 
-	void handle_content()
+	void subscribe(const char *names)
 	{
-		auto s = buffer.begin();
-		auto consumed = buffer.begin();
-		for(; s != buffer.end();) {
-			s = std::find(s, buffer.end(), '<');
-			auto e = std::find(s, buffer.end(), '>');
-			if(s != buffer.end() && e != buffer.end()) {
-				*e = 0;
-				String str(reinterpret_cast<char*>(&*s));
-				str += '>';
-				Serial.printf("pushing command to pending: '%s' no of pending: %d\n", str.c_str(), DCCppPendingCommands.count());
-				DCCppPendingCommands.push(std::move(str));
-				consumed = e + 1; // + 1 to include the '>'
-			}
-			s = e;
+		int mask = parseTopics(names, topics);
+		if(mask >= 0) {
+			topics = mask;
+			answer += String(F("<U SUB ")) + String(mask) + String(F(">"));
+		} else {
+			answer += F("<X>");
 		}
-		buffer.erase(buffer.begin(), consumed); // drop everything we used from the buffer.
 	}
 
 	void clear()
 	{
-		buffer.clear();
-		if(buffer.capacity() > 64)
-		buffer.shrink_to_fit();
+		topics = TOPIC_ALL;
+		answer = "";
+		sent = 0;
+		filtered = 0;
+		saved = 0;
+		parser.clear();
 	}
-	auto size() const { return buffer.size(); }
 };
 struct WebSocketClient {
 	bool used;
@@ -196,6 +239,7 @@ struct WebSocketClient {
 	PartialCommandParser partialCommand;
 };
 WebSocketClient webSocketClients[MAX_WEBSOCKET_CLIENTS];
+PartialCommandParser DCCppClientParsers[MAX_DCCPP_CLIENTS];
 
 void onWSEvent(AsyncWebSocket * server, AsyncWebSocketClient * client,
 		AwsEventType type, void * arg, uint8_t *data, size_t len) {
@@ -210,23 +254,37 @@ void onWSEvent(AsyncWebSocket * server, AsyncWebSocketClient * client,
 				clientIndex = index;
 			}
 		}
+		if (clientIndex == -1) {
+			// no parser free for it, and sharing one would mix its commands with another client's
+			client->close(1013, "Server full");
+			return;
+		}
 		client->printf("Welcome. Server Ready %u:%u", client->id(),
 				clientIndex);
 	} else if (type == WS_EVT_DISCONNECT) {
 		for (int index = 0; index < MAX_WEBSOCKET_CLIENTS; index++) {
-			if (webSocketClients[index].id == client->id()) {
+			if (webSocketClients[index].used && webSocketClients[index].id == client->id()) {
 				webSocketClients[index].used = false;
 				webSocketClients[index].partialCommand.clear();
 			}
 		}
 	} else if (type == WS_EVT_DATA) {
-		int clientIndex = 0;
+		int clientIndex = -1;
 		for (int index = 0; index < MAX_WEBSOCKET_CLIENTS; index++) {
-			if (webSocketClients[index].id == client->id()) {
+			if (webSocketClients[index].used && webSocketClients[index].id == client->id()) {
 				clientIndex = index;
 			}
 		}
-		webSocketClients[clientIndex].partialCommand.push_back(data, len);
+		if (clientIndex == -1) {
+			client->close(1013, "Server full");   // refused at connect, its data is not ours to parse
+			return;
+		}
+		auto &parser = webSocketClients[clientIndex].partialCommand;
+		parser.push_back(data, len);
+		if(parser.answer.length()) {
+			client->text(parser.answer);
+			parser.answer = "";
+		}
 	}
 }
 
@@ -402,6 +460,51 @@ void handlePowerStatus(AsyncWebServerRequest *request) {
 	request->send(jsonResponse);
 }
 
+void handleQueue(AsyncWebServerRequest *request) {
+	auto jsonResponse = new AsyncJsonResponse();
+	JsonObject &root = jsonResponse->getRoot();
+	auto lane = [](JsonObject &node, const char *name, const auto &q) {
+		JsonObject &json = node.createNestedObject(name);
+		uint32_t dequeued = q.dequeued.load();
+		json[F("size")] = q.size();
+		json[F("queued")] = q.count();
+		json[F("dropped")] = q.dropped.load();
+		json[F("highWater")] = q.highWater.load();
+		json[F("dequeued")] = dequeued;
+		json[F("latencyMax")] = q.latencyMax.load();
+		json[F("latencyMean")] = dequeued ? q.latencySum.load() / dequeued : 0;
+	};
+	lane(root, "urgent", DCCppPendingCommands.urgent);
+	lane(root, "normal", DCCppPendingCommands.normal);
+	root[F("tooLong")] = DCCppPendingCommands.tooLong.load();
+	root[F("overShare")] = DCCppPendingCommands.overShare.load();
+	root[F("superseded")] = DCCppPendingCommands.superseded;
+	// the connected clients, by the number that tags their commands
+	JsonArray &clients = root.createNestedArray("clients");
+	auto client = [&clients](const PartialCommandParser &parser, const char *kind) {
+		JsonObject &json = clients.createNestedObject();
+		json[F("client")] = parser.client;
+		json[F("kind")] = kind;
+		json[F("topics")] = parser.topics;
+		json[F("waiting")] = DCCppPendingCommands.waitingFor(parser.client).load();
+		json[F("sent")] = parser.sent;
+		json[F("filtered")] = parser.filtered;
+		json[F("saved")] = parser.saved;
+	};
+	for (int i = 0; i < MAX_DCCPP_CLIENTS; i++) {
+		if (DCCppClients[i] && DCCppClients[i].connected()) {
+			client(DCCppClientParsers[i], "tcp");
+		}
+	}
+	for (int index = 0; index < MAX_WEBSOCKET_CLIENTS; index++) {
+		if (webSocketClients[index].used) {
+			client(webSocketClients[index].partialCommand, "websocket");
+		}
+	}
+	jsonResponse->setLength();
+	request->send(jsonResponse);
+}
+
 void handleTurnouts(AsyncWebServerRequest *request) {
 	auto jsonResponse = new AsyncJsonResponse(true);
 	if (request->method() == HTTP_GET) {
@@ -425,15 +528,8 @@ void handleTurnouts(AsyncWebServerRequest *request) {
 		jsonResponse->setLength();
 		request->send(jsonResponse);
 	} else if (request->method() == HTTP_PUT) {
-		if (request->arg(F("state")) == F("true")) {
-			DCCppPendingCommands.push(
-					String(F("<T ")) + request->arg(F("id"))
-							+ String(F(" 1>")));
-		} else {
-			DCCppPendingCommands.push(
-					String(F("<T ")) + request->arg(F("id"))
-							+ String(F(" 0>")));
-		}
+		DCCpp::Server::pushTurnout(request->arg(F("id")).toInt(),
+				request->arg(F("state")) == F("true"));
 		jsonResponse->setCode(200);
 		jsonResponse->setLength();
 		request->send(jsonResponse);
@@ -466,9 +562,8 @@ void handleOutputs(AsyncWebServerRequest *request) {
 		jsonResponse->setLength();
 		request->send(jsonResponse);
 	} else if (request->method() == HTTP_PUT) {
-		DCCppPendingCommands.push(
-				String(F("<Z ")) + request->arg(F("id")) + String(F(" "))
-						+ request->arg(F("state")) + String(F(">")));
+		DCCpp::Server::pushOutput(request->arg(F("id")).toInt(),
+				request->arg(F("state")).toInt());
 		jsonResponse->setCode(202);
 		jsonResponse->setLength();
 		request->send(jsonResponse);
@@ -557,6 +652,7 @@ void loop_DCCppServer()
 					DCCppClients[i].stop();
 				}
 				DCCppClients[i] = DCCppServer.available();
+				DCCppClientParsers[i].clear();
 				continue;
 			}
 		}
@@ -567,376 +663,388 @@ void loop_DCCppServer()
 		if (DCCppClients[i]
 			&& DCCppClients[i].connected()
 			&& DCCppClients[i].available()) {
-			static PartialCommandParser buffer;
-			auto len = DCCppClients[i].available();
-			auto read_dest = buffer.alloc_push(len);
-			auto added = DCCppClients[i].read(&*read_dest, len);
-			buffer.commit_push(read_dest, added);
+			auto &parser = DCCppClientParsers[i];
+			uint8_t chunk[64];
+			int len;
+			while(DCCppClients[i].available()
+				&& (len = DCCppClients[i].read(chunk, sizeof(chunk))) > 0) {
+				parser.push_back(chunk, len);
+			}
+			if(parser.answer.length()) {
+				DCCppClients[i].print(parser.answer);
+				parser.answer = "";
+			}
 		}
 	}
 }
 
-void loop_incoming_from_dcc_generator()
+String nameOf(const DCCpp::Server::ReplyEvent &e)
 {
-	while (read_from_dccpp->available()) {
-		char ch = read_from_dccpp->read();
-		if (!inDCCPPCommand && ch == '<') {
-			inDCCPPCommand = true;
-		}
-		if (inDCCPPCommand) {
-			currentDCCppCommand += ch;
-		}
-		if (inDCCPPCommand && ch == '>') {
-			inDCCPPCommand = false;
-			if (currentDCCppCommand.startsWith(F("<iESP-"))) {
-				if (currentDCCppCommand.indexOf(F("connect")) > 0) {
-					size_t firstSpace = currentDCCppCommand.indexOf(' ');
-					size_t secondSpace = currentDCCppCommand.indexOf(' ',
-							firstSpace + 1);
-					long ssidLength = currentDCCppCommand.substring(
-							firstSpace + 1, secondSpace).toInt();
-					firstSpace = secondSpace++;
-					secondSpace += ssidLength;
-					String ssid = currentDCCppCommand.substring(firstSpace + 1,
-							secondSpace);
-					String password = currentDCCppCommand.substring(
-							secondSpace + 1, currentDCCppCommand.length() - 1);
-					WiFi.setAutoReconnect(false);
-					write_to_dccpp->print(F("<iESP connecting to "));
-					write_to_dccpp->print(ssid);
-					write_to_dccpp->println(F(">"));
-					WiFi.begin(ssid.c_str(), password.c_str());
-					bool connecting = true;
-					// ~30sec timeout
-					int connectTimeout = 120;
-					while (connecting && connectTimeout) {
-						connectTimeout--;
-						delay(250);
-						switch (WiFi.status()) {
-						case WL_CONNECTED:
-							write_to_dccpp->print(F("<iESP connected "));
-							write_to_dccpp->print(WiFi.localIP());
-							write_to_dccpp->println(F(">"));
-							WiFi.setAutoReconnect(true);
-							connecting = false;
-							break;
-						case WL_CONNECT_FAILED:
-							write_to_dccpp->println(F("<iESP connect failed>"));
-							connecting = false;
-							break;
-						case WL_DISCONNECTED:
-							// ignoring this as we get this status until it either succeeds or fails.
-							break;
-						case WL_NO_SSID_AVAIL:
-							write_to_dccpp->println(F("<iESP AP not found>"));
-							connecting = false;
-							break;
-						default:
-							write_to_dccpp->print(F("<iESP status "));
-							write_to_dccpp->print(WiFi.status());
-							write_to_dccpp->println(F(">"));
-							break;
-						}
-					}
-					if (WiFi.status() != WL_CONNECTED && !connectTimeout) {
-						write_to_dccpp->println(F("<iESP connect timeout>"));
-					}
-				} else if (currentDCCppCommand.indexOf(F("start")) > 0) {
-					WiFi.printDiag(Serial);
-					DCCppServer.begin();
-					webServer.begin();
-					auto mdnsIf = WiFi.getMode() == WIFI_AP_STA ? TCPIP_ADAPTER_IF_AP : TCPIP_ADAPTER_IF_STA;
-					Serial.printf("{MDNS} interface=%d\n", mdnsIf);
-					if(!MDNS.begin(HOSTNAME, mdnsIf))
-						Serial.printf("{MDNS} failed to setup. interface=%d\n", mdnsIf);
-					MDNS.addService("_http", "_tcp", 80);
-					MDNS.addService("_dccpp_web", "_tcp", 80);
-					MDNS.addService("_dccpp", "_tcp", 2560);
-					taskScheduler.enableAll();
-					write_to_dccpp->println(F("<iESP ready>"));
-				} else if (currentDCCppCommand.indexOf(F("stop")) > 0) {
-					taskScheduler.disableAll();
-					DCCppServer.stop();
-					write_to_dccpp->println(F("<iESP shutdown>"));
-				} else if (currentDCCppCommand.indexOf(F("reset")) > 0) {
-					ESP.restart();
-				} else if (currentDCCppCommand.indexOf(F("ip")) > 0) {
-					write_to_dccpp->print(F("<iESP ip "));
-					if (WiFi.status() == WL_CONNECTED) {
-						write_to_dccpp->print(WiFi.localIP());
-					} else {
-						write_to_dccpp->print(F("0.0.0.0"));
-					}
-					write_to_dccpp->println(F(">"));
-				} else if (currentDCCppCommand.indexOf(F("scan")) > 0) {
-					int networkCount = WiFi.scanNetworks();
-					for (int net = 0; net < networkCount; net++) {
-						write_to_dccpp->print(F("<iESP-network: "));
-						write_to_dccpp->print(WiFi.SSID(net));
-						write_to_dccpp->println(F(">"));
-					}
-				} else if (currentDCCppCommand.indexOf(F("status")) > 0) {
-					write_to_dccpp->print(F("<iESP-status "));
-					write_to_dccpp->print(WiFi.status());
-					write_to_dccpp->print(F(" "));
-					if (WiFi.status() == WL_CONNECTED) {
-						write_to_dccpp->print(WiFi.localIP());
-					} else {
-						write_to_dccpp->print(F("0.0.0.0"));
-					}
-					write_to_dccpp->print(F(" "));
-#ifndef ESP32
-					write_to_dccpp->print(DCCppServer.status());
-#else
-					write_to_dccpp->print(DCCppServer ? "1" : "0");
-#endif
-					write_to_dccpp->println(F(">"));
-				} else if(currentDCCppCommand.indexOf(F("softAP")) > 0) {
-					//size_t strmax = currentDCCppCommand.length();
-    				char *next_token;
-					auto header = strtok_r(const_cast<char*>(currentDCCppCommand.c_str()),
-						" ", &next_token);
-					auto ssid = strtok_r(nullptr, " >", &next_token);
-					auto passwd = strtok_r(nullptr, " >", &next_token);
-					auto endTag = strtok_r(nullptr, " >", &next_token);
-					auto checkNull = [](auto* p) { return p ? p : "null";};
-					Serial.printf("header = '%s' ssid = '%s' pass='%s' endTag='%s'\n",
-						checkNull(header), checkNull(ssid), checkNull(passwd), checkNull(endTag));
-					if(!WiFi.softAP(ssid, passwd)) {
-						WiFi.printDiag(Serial);
-						write_to_dccpp->println(F("<iESP AP connect timeout>"));
-					} else {
-						write_to_dccpp->print(F("<iESP AP connected "));
-						write_to_dccpp->print(WiFi.softAPIP().toString());
-						write_to_dccpp->println(F(">"));
-					}
+	String name;
+	for (uint8_t i = 0; i < e.nameLength; i++) {
+		name += e.name[i];
+	}
+	name.trim();
+	return name;
+}
 
+// Acts on a reply of the base station about current, a sensor, turnout, output, CV read or cab, from its numbers.
+void applyReply(const DCCpp::Server::ReplyEvent &e)
+{
+	switch (e.letter) {
+	case 'a':
+		// <a CURRENT NAME>: the current of a power district, shown by its name
+		if (e.n >= 1 && e.nameLength > 0) {
+			int powerUsage = e.args[0];
+			String districtName = nameOf(e);
+			bool districtFound = false;
+			for (const auto& node : powerDistricts) {
+				if (node->getDistrictName() == districtName) {
+					districtFound = true;
+					node->setPowerUsage(powerUsage);
 				}
-			} else if (currentDCCppCommand.startsWith(F("<a "))) {
-				// parse current details so we can display it
-				if (currentDCCppCommand.lastIndexOf(' ') > 2) {
-					int powerUsage = currentDCCppCommand.substring(2,
-							currentDCCppCommand.lastIndexOf(' ')).toInt();
-					String districtName = currentDCCppCommand.substring(
-							currentDCCppCommand.lastIndexOf(' '),
-							currentDCCppCommand.length() - 1);
-					districtName.trim();
-					//write_to_dccpp->printf("DETECTED: %s / %d", districtName.c_str(), powerUsage);
-					bool districtFound = false;
-					for (const auto& node : powerDistricts) {
-						if (node->getDistrictName() == districtName) {
-							districtFound = true;
-							node->setPowerUsage(powerUsage);
-						}
-					}
-					if (!districtFound) {
-						powerDistricts.add(
-								new PowerDistrict(districtName, true,
-										powerUsage));
-					}
-					//} else {
-					//	write_to_dccpp->printf("UNABLE TO PARSE: %s", currentDCCppCommand.c_str());
-				}
-			} else if (currentDCCppCommand.startsWith(F("<p"))) {
-				// parse power district status
-				bool districtOn = currentDCCppCommand[2] == '1';
-				bool districtOverPower = (currentDCCppCommand[2] == '2');
-				String districtName = currentDCCppCommand.substring(
-						currentDCCppCommand.lastIndexOf(' '),
-						currentDCCppCommand.length() - 1);
-				districtName.trim();
-				bool districtFound = false;
-				for (const auto& node : powerDistricts) {
-					if (node->getDistrictName() == districtName) {
-						districtFound = true;
-						node->setOverCurrent(districtOverPower);
-						node->setCurrentState(districtOn);
-					}
-				}
-				if (!districtFound) {
-					powerDistricts.add(
-							new PowerDistrict(districtName, districtOn, 0,
-									districtOverPower));
+			}
+			if (!districtFound) {
+				powerDistricts.add(
+						new PowerDistrict(districtName, true,
+								powerUsage));
+			}
+		}
+		break;
+	case 'q':
+	case 'Q':
+		if (e.n >= 3) {
+			// <Q ID PIN PULLUP>
+			int sensorID = e.args[0];
+			bool sensorFound = false;
+			for (const auto& node : sensors) {
+				if (node->getId() == sensorID) {
+					sensorFound = true;
 				}
-			} else if (currentDCCppCommand.equals(F("<0>"))) {
-				// mark track power status as off
-				for (const auto& node : powerDistricts) {
-					node->setCurrentState(false);
+			}
+			if (!sensorFound) {
+				sensors.add(
+						new Sensor(sensorID, e.args[1], false,
+								e.args[2] == 1));
+			}
+		} else if (e.n >= 1) {
+			// <q ID> or <Q ID>
+			bool sensorActive = e.letter == 'Q';
+			bool sensorFound = false;
+			for (const auto& node : sensors) {
+				if (node->getId() == e.args[0]) {
+					sensorFound = true;
+					node->setActive(sensorActive);
 				}
-			} else if (currentDCCppCommand.equals(F("<1>"))) {
-				// mark track power status as on
-				for (const auto& node : powerDistricts) {
-					node->setCurrentState(true);
-					node->setOverCurrent(false);
+			}
+			if (!sensorFound) {
+				forceRefreshSensors = true;
+			}
+		}
+		break;
+	case 'H':
+		if (e.n >= 4) {
+			// <H ID ADDRESS SUBADDRESS THROW>
+			bool foundTurnout = false;
+			for (const auto& node : turnouts) {
+				if (node->getId() == e.args[0]) {
+					node->setThrown(e.args[3] == 1);
+					foundTurnout = true;
 				}
-			} else if (currentDCCppCommand.startsWith(F("<q "))
-					|| currentDCCppCommand.startsWith(F("<Q "))) {
-				// sensor parsing
-				int firstSpace = currentDCCppCommand.indexOf(' ');
-				if (currentDCCppCommand.lastIndexOf(' ') > 2) {
-					// <Q ID PIN PULLUP>
-					int secondSpace = currentDCCppCommand.indexOf(' ',
-							firstSpace + 1);
-					int thirdSpace = currentDCCppCommand.indexOf(' ',
-							secondSpace + 1);
-					int sensorID = currentDCCppCommand.substring(firstSpace,
-							secondSpace).toInt();
-					int sensorPin = currentDCCppCommand.substring(secondSpace,
-							thirdSpace).toInt();
-					bool sensorPullUp =
-							currentDCCppCommand.substring(thirdSpace,
-									currentDCCppCommand.length() - 1).toInt()
-									== 1;
-					bool sensorFound = false;
-					for (const auto& node : sensors) {
-						if (node->getId() == sensorID) {
-							sensorFound = true;
-						}
-					}
-					if (!sensorFound) {
-						sensors.add(
-								new Sensor(sensorID, sensorPin, false,
-										sensorPullUp));
-					}
-				} else {
-					// <q ID> or <Q ID>
-					int sensorID = currentDCCppCommand.substring(firstSpace,
-							currentDCCppCommand.length() - 1).toInt();
-					bool sensorActive = currentDCCppCommand[1] == 'Q';
-					bool sensorFound = false;
-					for (const auto& node : sensors) {
-						if (node->getId() == sensorID) {
-							sensorFound = true;
-							node->setActive(sensorActive);
-						}
-					}
-					if (!sensorFound) {
-						forceRefreshSensors = true;
-					}
+			}
+			if (!foundTurnout) {
+				turnouts.add(
+						new Turnout(e.args[0], e.args[1], e.args[2],
+								e.args[3] == 1));
+			}
+		} else if (e.n >= 2) {
+			// <H ID THROW>
+			for (const auto& node : turnouts) {
+				if (node->getId() == e.args[0]) {
+					node->setThrown(e.args[1] == 1);
 				}
-			} else if (currentDCCppCommand.startsWith(F("<H "))) {
-				// turnout parsing
-				int firstSpace = currentDCCppCommand.indexOf(' ');
-				int secondSpace = currentDCCppCommand.indexOf(' ',
-						firstSpace + 1);
-				int turnoutID = currentDCCppCommand.substring(firstSpace,
-						secondSpace).toInt();
-				if (currentDCCppCommand.lastIndexOf(' ') > secondSpace) {
-					int thirdSpace = currentDCCppCommand.indexOf(' ',
-							secondSpace + 1);
-					int fourthSpace = currentDCCppCommand.indexOf(' ',
-							thirdSpace + 1);
-					int address = currentDCCppCommand.substring(secondSpace + 1,
-							thirdSpace).toInt();
-					int subAddress = currentDCCppCommand.substring(
-							thirdSpace + 1, fourthSpace).toInt();
-					bool state = currentDCCppCommand.substring(fourthSpace + 1,
-							currentDCCppCommand.length() - 1).toInt() == 1;
-					bool foundTurnout = false;
-					for (const auto& node : turnouts) {
-						if (node->getId() == turnoutID) {
-							node->setThrown(state);
-							foundTurnout = true;
-						}
-					}
-					if (!foundTurnout) {
-						turnouts.add(
-								new Turnout(turnoutID, address, subAddress,
-										state));
-					}
-				} else {
-					bool state = currentDCCppCommand.substring(secondSpace + 1,
-							currentDCCppCommand.length() - 1).toInt() == 1;
-					for (const auto& node : turnouts) {
-						if (node->getId() == turnoutID) {
-							node->setThrown(state);
-						}
-					}
+			}
+		}
+		break;
+	case 'Y':
+		if (e.n >= 4) {
+			// <Y ID PIN IFLAG STATE>
+			bool foundOutput = false;
+			for (const auto& node : outputs) {
+				if (node->getId() == e.args[0]) {
+					node->setActive(e.args[3] == 1);
+					foundOutput = true;
 				}
-			} else if (currentDCCppCommand.startsWith(F("<Y "))) {
-				// outputs parsing
-				int firstSpace = currentDCCppCommand.indexOf(' ');
-				int secondSpace = currentDCCppCommand.indexOf(' ',
-						firstSpace + 1);
-				int outputID = currentDCCppCommand.substring(firstSpace,
-						secondSpace).toInt();
-				if (currentDCCppCommand.lastIndexOf(' ') > secondSpace) {
-					int thirdSpace = currentDCCppCommand.indexOf(' ',
-							secondSpace + 1);
-					int fourthSpace = currentDCCppCommand.indexOf(' ',
-							thirdSpace + 1);
-					int pinID = currentDCCppCommand.substring(secondSpace,
-							thirdSpace).toInt();
-					bool inverted = currentDCCppCommand.substring(
-							thirdSpace + 1, fourthSpace).toInt() == 1;
-					bool active = currentDCCppCommand.substring(fourthSpace + 1,
-							currentDCCppCommand.length() - 1).toInt() == 1;
-					bool foundOutput = false;
-					for (const auto& node : outputs) {
-						if (node->getId() == outputID) {
-							node->setActive(active);
-							foundOutput = true;
-						}
-					}
-					if (!foundOutput) {
-						outputs.add(
-								new Output(outputID, pinID, inverted, active));
-					}
-				} else {
-					bool active = currentDCCppCommand.substring(secondSpace + 1,
-							currentDCCppCommand.length() - 1).toInt() == 1;
-					for (const auto& node : outputs) {
-						if (node->getId() == outputID) {
-							node->setActive(active);
-						}
-					}
+			}
+			if (!foundOutput) {
+				outputs.add(
+						new Output(e.args[0], e.args[1], e.args[2] == 1, e.args[3] == 1));
+			}
+		} else if (e.n >= 2) {
+			// <Y ID STATE>
+			for (const auto& node : outputs) {
+				if (node->getId() == e.args[0]) {
+					node->setActive(e.args[1] == 1);
 				}
-			} else if (currentDCCppCommand.startsWith(F("<r"))) {
-				// <rCALLBACK|CALLBACKSUB|CV Value>
-				// <rCALLBACK|CALLBACKSUB|CV VALUE>
-				// <rCALLBACK|CALLBACKSUB|CV BIT VALUE>
-				int firstPipe = currentDCCppCommand.indexOf('|');
-				int secondPipe = currentDCCppCommand.indexOf('|',
-						firstPipe + 1);
-				int lastSpace = currentDCCppCommand.lastIndexOf(' ');
-				int callbackNumber =
-						currentDCCppCommand.substring(2, firstPipe).toInt();
-				int callbackSubNumber = currentDCCppCommand.substring(
-						firstPipe + 1, secondPipe).toInt();
-				for (const auto& node : progRequests) {
-					if (node->getCallbackNumber() == callbackNumber
-							&& node->getCallbackSubNumber()
-									== callbackSubNumber) {
-						node->setValue(
-								currentDCCppCommand.substring(lastSpace + 1,
-										currentDCCppCommand.length() - 1).toInt());
-					}
+			}
+		}
+		break;
+	case 'r':
+		// <rCALLBACK|CALLBACKSUB|CV VALUE>
+		// <rCALLBACK|CALLBACKSUB|CV BIT VALUE>
+		if (e.n >= 4) {
+			for (const auto& node : progRequests) {
+				if (node->getCallbackNumber() == e.args[0]
+						&& node->getCallbackSubNumber() == e.args[1]) {
+					node->setValue(e.args[e.n - 1]);
 				}
-			} else if(currentDCCppCommand.startsWith("<T")) {
-				char *next_token;
-				auto idStr = strtok_r(const_cast<char*>(currentDCCppCommand.c_str()) + 2,
-					" ", &next_token);
-				auto speedStr = strtok_r(nullptr, " ", &next_token);
-				auto dirStr = strtok_r(nullptr, " >", &next_token);
-				cabServer.update(atoi(idStr), atoi(speedStr), atoi(dirStr));
 			}
+		}
+		break;
+	case 'T':
+		// <T ID SPEED DIRECTION>
+		if (e.n >= 3) {
+			cabServer.update(e.args[0], e.args[1], e.args[2]);
+		}
+		break;
+	}
+}
 
-		#ifndef ESP32
-			if (DCCppServer.status() == LISTEN) {
-		#else
-			if (DCCppServer) {
-		#endif
-				for (int i = 0; i < MAX_DCCPP_CLIENTS; i++) {
-					if (DCCppClients[i] && DCCppClients[i].connected()) {
-						DCCppClients[i].print(currentDCCppCommand);
-						delay(1);
-					}
+// Passes a reply of the base station on to the clients.
+void forwardReply(const char *reply)
+{
+#ifndef ESP32
+	if (DCCppServer.status() == LISTEN) {
+#else
+	if (DCCppServer) {
+#endif
+		// only to clients that subscribed to the topic of the reply, see <U SUB> in DCCpp_Uno/src/SerialCommand.cpp,
+		// and to the client whose command it answers
+		uint8_t topic = topicOf(reply[1]);
+		uint8_t answering = answerTo.answering();
+		size_t length = strlen(reply);
+		for (int i = 0; i < MAX_DCCPP_CLIENTS; i++) {
+			if (DCCppClients[i] && DCCppClients[i].connected()
+				&& DCCppClientParsers[i].offer(topic, answering, length)) {
+				DCCppClients[i].print(reply);
+				delay(1);
+			}
+		}
+		for (int index = 0; index < MAX_WEBSOCKET_CLIENTS; index++) {
+			if (webSocketClients[index].used
+				&& webSocketClients[index].partialCommand.offer(topic, answering, length)) {
+				webSocket.text(webSocketClients[index].id, reply);
+			}
+		}
+	}
+}
+
+
+// Acts on one complete reply of the base station in currentDCCppCommand, and passes it on to the clients.
+void handleDCCppReply()
+{
+	if (currentDCCppCommand == F("<iESP-ran>")) {
+		answerTo.ran();
+		return;
+	}
+	if (currentDCCppCommand.startsWith(F("<iESP-"))) {
+		if (currentDCCppCommand.indexOf(F("connect")) > 0) {
+			size_t firstSpace = currentDCCppCommand.indexOf(' ');
+			size_t secondSpace = currentDCCppCommand.indexOf(' ',
+					firstSpace + 1);
+			long ssidLength = currentDCCppCommand.substring(
+					firstSpace + 1, secondSpace).toInt();
+			firstSpace = secondSpace++;
+			secondSpace += ssidLength;
+			String ssid = currentDCCppCommand.substring(firstSpace + 1,
+					secondSpace);
+			String password = currentDCCppCommand.substring(
+					secondSpace + 1, currentDCCppCommand.length() - 1);
+			WiFi.setAutoReconnect(false);
+			write_to_dccpp->print(F("<iESP connecting to "));
+			write_to_dccpp->print(ssid);
+			write_to_dccpp->println(F(">"));
+			WiFi.begin(ssid.c_str(), password.c_str());
+			bool connecting = true;
+			// ~30sec timeout
+			int connectTimeout = 120;
+			while (connecting && connectTimeout) {
+				connectTimeout--;
+				delay(250);
+				switch (WiFi.status()) {
+				case WL_CONNECTED:
+					write_to_dccpp->print(F("<iESP connected "));
+					write_to_dccpp->print(WiFi.localIP());
+					write_to_dccpp->println(F(">"));
+					WiFi.setAutoReconnect(true);
+					connecting = false;
+					break;
+				case WL_CONNECT_FAILED:
+					write_to_dccpp->println(F("<iESP connect failed>"));
+					connecting = false;
+					break;
+				case WL_DISCONNECTED:
+					// ignoring this as we get this status until it either succeeds or fails.
+					break;
+				case WL_NO_SSID_AVAIL:
+					write_to_dccpp->println(F("<iESP AP not found>"));
+					connecting = false;
+					break;
+				default:
+					write_to_dccpp->print(F("<iESP status "));
+					write_to_dccpp->print(WiFi.status());
+					write_to_dccpp->println(F(">"));
+					break;
 				}
-				webSocket.textAll(currentDCCppCommand);
 			}
-			currentDCCppCommand = "";
+			if (WiFi.status() != WL_CONNECTED && !connectTimeout) {
+				write_to_dccpp->println(F("<iESP connect timeout>"));
+			}
+		} else if (currentDCCppCommand.indexOf(F("start")) > 0) {
+			WiFi.printDiag(Serial);
+			DCCppServer.begin();
+			webServer.begin();
+			auto mdnsIf = WiFi.getMode() == WIFI_AP_STA ? TCPIP_ADAPTER_IF_AP : TCPIP_ADAPTER_IF_STA;
+			Serial.printf("{MDNS} interface=%d\n", mdnsIf);
+			if(!MDNS.begin(HOSTNAME, mdnsIf))
+				Serial.printf("{MDNS} failed to setup. interface=%d\n", mdnsIf);
+			MDNS.addService("_http", "_tcp", 80);
+			MDNS.addService("_dccpp_web", "_tcp", 80);
+			MDNS.addService("_dccpp", "_tcp", 2560);
+			taskScheduler.enableAll();
+			write_to_dccpp->println(F("<iESP ready>"));
+		} else if (currentDCCppCommand.indexOf(F("stop")) > 0) {
+			taskScheduler.disableAll();
+			DCCppServer.stop();
+			write_to_dccpp->println(F("<iESP shutdown>"));
+		} else if (currentDCCppCommand.indexOf(F("reset")) > 0) {
+			ESP.restart();
+		} else if (currentDCCppCommand.indexOf(F("ip")) > 0) {
+			write_to_dccpp->print(F("<iESP ip "));
+			if (WiFi.status() == WL_CONNECTED) {
+				write_to_dccpp->print(WiFi.localIP());
+			} else {
+				write_to_dccpp->print(F("0.0.0.0"));
+			}
+			write_to_dccpp->println(F(">"));
+		} else if (currentDCCppCommand.indexOf(F("scan")) > 0) {
+			int networkCount = WiFi.scanNetworks();
+			for (int net = 0; net < networkCount; net++) {
+				write_to_dccpp->print(F("<iESP-network: "));
+				write_to_dccpp->print(WiFi.SSID(net));
+				write_to_dccpp->println(F(">"));
+			}
+		} else if (currentDCCppCommand.indexOf(F("status")) > 0) {
+			write_to_dccpp->print(F("<iESP-status "));
+			write_to_dccpp->print(WiFi.status());
+			write_to_dccpp->print(F(" "));
+			if (WiFi.status() == WL_CONNECTED) {
+				write_to_dccpp->print(WiFi.localIP());
+			} else {
+				write_to_dccpp->print(F("0.0.0.0"));
+			}
+			write_to_dccpp->print(F(" "));
+#ifndef ESP32
+			write_to_dccpp->print(DCCppServer.status());
+#else
+			write_to_dccpp->print(DCCppServer ? "1" : "0");
+#endif
+			write_to_dccpp->println(F(">"));
+		} else if(currentDCCppCommand.indexOf(F("softAP")) > 0) {
+			//size_t strmax = currentDCCppCommand.length();
+    				char *next_token;
+			auto header = strtok_r(const_cast<char*>(currentDCCppCommand.c_str()),
+				" ", &next_token);
+			auto ssid = strtok_r(nullptr, " >", &next_token);
+			auto passwd = strtok_r(nullptr, " >", &next_token);
+			auto endTag = strtok_r(nullptr, " >", &next_token);
+			auto checkNull = [](auto* p) { return p ? p : "null";};
+			Serial.printf("header = '%s' ssid = '%s' pass='%s' endTag='%s'\n",
+				checkNull(header), checkNull(ssid), checkNull(passwd), checkNull(endTag));
+			if(!WiFi.softAP(ssid, passwd)) {
+				WiFi.printDiag(Serial);
+				write_to_dccpp->println(F("<iESP AP connect timeout>"));
+			} else {
+				write_to_dccpp->print(F("<iESP AP connected "));
+				write_to_dccpp->print(WiFi.softAPIP().toString());
+				write_to_dccpp->println(F(">"));
+			}
+
+		}
+	} else if (currentDCCppCommand.startsWith(F("<p"))) {
+		// parse power district status
+		bool districtOn = currentDCCppCommand[2] == '1';
+		bool districtOverPower = (currentDCCppCommand[2] == '2');
+		String districtName = currentDCCppCommand.substring(
+				currentDCCppCommand.lastIndexOf(' '),
+				currentDCCppCommand.length() - 1);
+		districtName.trim();
+		bool districtFound = false;
+		for (const auto& node : powerDistricts) {
+			if (node->getDistrictName() == districtName) {
+				districtFound = true;
+				node->setOverCurrent(districtOverPower);
+				node->setCurrentState(districtOn);
+			}
+		}
+		if (!districtFound) {
+			powerDistricts.add(
+					new PowerDistrict(districtName, districtOn, 0,
+							districtOverPower));
 		}
+	} else if (currentDCCppCommand.equals(F("<0>"))) {
+		// mark track power status as off
+		for (const auto& node : powerDistricts) {
+			node->setCurrentState(false);
+		}
+	} else if (currentDCCppCommand.equals(F("<1>"))) {
+		// mark track power status as on
+		for (const auto& node : powerDistricts) {
+			node->setCurrentState(true);
+			node->setOverCurrent(false);
+		}
+	} else {
+		DCCpp::Server::ReplyEvent e;
+		if (DCCpp::Server::parseReply(currentDCCppCommand.c_str(), e)) {
+			applyReply(e);
+		}
+	}
+	forwardReply(currentDCCppCommand.c_str());
+}
+
+void receiveFromDCCpp(char ch)
+{
+	if (!inDCCPPCommand && ch == '<') {
+		inDCCPPCommand = true;
+	}
+	if (inDCCPPCommand) {
+		currentDCCppCommand += ch;
+	}
+	if (inDCCPPCommand && ch == '>') {
+		inDCCPPCommand = false;
+		handleDCCppReply();
+		currentDCCppCommand = "";
+	}
+}
+
+void loop_incoming_from_dcc_generator()
+{
+	while (read_from_dccpp->available()) {
+		receiveFromDCCpp(read_from_dccpp->read());
+	}
+}
+
+String toText(const DCCpp::Server::Command &c)
+{
+	if (c.op == 0) {
+		return String(c.text);
+	}
+	String text = String('<') + c.op;
+	for (int i = 0; i < c.n; i++) {
+		text += ' ';
+		text += String(c.args[i]);
 	}
+	return text + '>';
 }
 }
 
@@ -944,7 +1052,65 @@ namespace DCCpp {
     namespace Server {
 		void pushPendingDCCCommand(String cmd)
 		{
-			DCCppPendingCommands.push(std::move(cmd));
+			DCCppPendingCommands.push(cmd);
+		}
+
+		void pushThrottle(int reg, int cab, int speed, int direction)
+		{
+			Command c;
+			c.op = 't';
+			c.n = 4;
+			c.args[0] = reg;
+			c.args[1] = cab;
+			c.args[2] = speed;
+			c.args[3] = direction;
+			DCCppPendingCommands.push(c);
+		}
+
+		void pushTurnout(int id, bool thrown)
+		{
+			Command c;
+			c.op = 'T';
+			c.n = 2;
+			c.args[0] = id;
+			c.args[1] = thrown;
+			DCCppPendingCommands.push(c);
+		}
+
+		void pushOutput(int id, bool active)
+		{
+			Command c;
+			c.op = 'Z';
+			c.n = 2;
+			c.args[0] = id;
+			c.args[1] = active;
+			DCCppPendingCommands.push(c);
+		}
+
+		void setDispatcher(Dispatcher *d)
+		{
+			dispatcher = d;
+		}
+
+		void onReply(const ReplyEvent &event, const char *reply)
+		{
+			applyReply(event);
+			forwardReply(reply);
+		}
+
+		void onReply(const char *reply)
+		{
+			size_t len = strlen(reply);
+			if (!inDCCPPCommand && len > 1 && reply[0] == '<' && reply[len - 1] == '>') {
+				currentDCCppCommand = reply;
+				handleDCCppReply();
+				currentDCCppCommand = "";
+			} else {
+				// a reply printed in pieces
+				while (*reply) {
+					receiveFromDCCpp(*reply++);
+				}
+			}
 		}
 
 		void setup(Stream& read_from, Print& write_to)
@@ -963,6 +1129,12 @@ namespace DCCpp {
 			WiFi.setHostname(HOSTNAME);
 		#endif
 			currentDCCppCommand.reserve(128);
+			for (int i = 0; i < MAX_DCCPP_CLIENTS; i++) {
+				DCCppClientParsers[i].client = 1 + i;
+			}
+			for (int i = 0; i < MAX_WEBSOCKET_CLIENTS; i++) {
+				webSocketClients[i].partialCommand.client = 1 + MAX_DCCPP_CLIENTS + i;
+			}
 
 			webSocket.onEvent(onWSEvent);
 			webServer.addHandler(&webSocket);
@@ -974,6 +1146,7 @@ namespace DCCpp {
 					&handleProgrammer);
 			webServer.on("/dccpp/config", HTTP_POST, &handleConfig);
 			webServer.on("/dccpp/powerStatus", HTTP_GET, &handlePowerStatus);
+			webServer.on("/dccpp/queue", HTTP_GET, &handleQueue);
 			webServer.on("/dccpp/turnouts",
 					HTTP_GET | HTTP_POST | HTTP_DELETE | HTTP_PUT, &handleTurnouts);
 			webServer.on("/dccpp/sensors", HTTP_GET | HTTP_POST | HTTP_DELETE,
@@ -1003,9 +1176,17 @@ namespace DCCpp {
 			loop_incoming_from_dcc_generator();
 			// drain the queued up commands
 			{
-				DCCppPendingCommands.acquire();
-				while(!DCCppPendingCommands.empty())
-					write_to_dccpp->print(DCCppPendingCommands.pop());
+				DCCpp::Server::Command command;
+				while((!dispatcher || dispatcher->ready()) && DCCppPendingCommands.pop(command)) {
+					if (dispatcher) {
+						answerTo.running = command.client;
+						dispatcher->run(command);
+						answerTo.running = 0;
+					} else {
+						write_to_dccpp->print(toText(command));
+						answerTo.written(command.client);
+					}
+				}
 			}
 		}
 	}
@@ -1,9 +1,35 @@
 #pragma once
 #include "Stream.h"
+#include "ReplyEvent.h"
+
+#define COMMAND_TEXT_MAX 64   // longest text command, with < and > and the terminating 0
 namespace DCCpp {
     namespace Server{
+		// A command for the base station: text, or one of the numeric commands t, T and Z with its arguments.
+		struct Command {
+			char op = 0;          // 0 for text
+			uint8_t n = 0;
+			int32_t args[4];
+			char text[COMMAND_TEXT_MAX] = {};   // the whole command, with < and >
+			uint8_t client = 0;   // who gets the answers whatever it subscribed to, 0 for nobody (see answerTo)
+			unsigned long queued = 0;   // micros() when it was pushed
+		};
+		// When the base station runs in the same binary (COMM_INTERFACE 5) it registers a Dispatcher, and queued
+		// commands are handed to it as they are instead of being written to write_to_dccpp as text.
+		struct Dispatcher {
+			virtual bool ready() = 0;   // may run another command in this pass
+			virtual void run(const Command &command) = 0;
+		};
 		void pushPendingDCCCommand(String cmd);
+		void pushThrottle(int reg, int cab, int speed, int direction);
+		void pushTurnout(int id, bool thrown);
+		void pushOutput(int id, bool active);
         void setup(Stream& read_from_dccpp, Print& write_to_dccpp);
+		void setDispatcher(Dispatcher *dispatcher);
+		// A reply of the base station that is handed over directly rather than read from read_from_dccpp: as an
+		// event with its numbers, which the server acts on without reading reply, or as text only.
+		void onReply(const ReplyEvent &event, const char *reply);
+		void onReply(const char *reply);
         void loop();
     }
 }
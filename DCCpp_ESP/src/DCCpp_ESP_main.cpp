@@ -1,14 +1,26 @@
 #include "DCCpp_ESP.h"
 #include "config.h"
 #include <Arduino.h>
+#include "../../DCCpp_Uno/src/Log.h"
+#include "../../DCCpp_Uno/src/Log.cpp"
+#include "../../DCCpp_Uno/src/SerialLink.h"
+#include "../../DCCpp_Uno/src/SerialLink.cpp"
+
+// the base station is reached over a SerialLink (see SerialLink.h), its ESPInterface speaks the same frames
+SerialLink baseStation(SERIAL_LINK_DEV);
+
 void setup()
 {
 	SERIAL_LINK_DEV.begin(SERIAL_LINK_SPEED);
 	SERIAL_LINK_DEV.flush();
-	DCCpp::Server::setup(SERIAL_LINK_DEV, SERIAL_LINK_DEV);
+	DCCpp::Server::setup(baseStation, baseStation);
 }
 
 void loop()
 {
+	baseStation.poll();
 	DCCpp::Server::loop();
+	baseStation.poll();
+	// the base station ignores text outside link frames, as it did the old debug prints
+	Log::drain(SERIAL_LINK_DEV.availableForWrite(), [](const char *line, int n) { SERIAL_LINK_DEV.write((const uint8_t *)line, n); });
 }
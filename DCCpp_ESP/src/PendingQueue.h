@@ -0,0 +1,200 @@
+/**********************************************************************
+ PendingQueue.h
+ Part of DCC++ BASE STATION for the Arduino / ESP8266
+ **********************************************************************/
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "DCCpp_ESP.h"
+#include "CommandQueue.h"
+
+#define QUEUE_REGISTERS 32    // throttle registers the queue tracks stops for one by one
+#define QUEUE_DISTRICTS 8     // power districts the queue tracks power off for one by one
+#define QUEUE_CLIENTS 24      // clients the queue counts commands for one by one, the last for all beyond
+#define QUEUE_CLIENT_SHARE 16 // commands one client may have waiting, so that it cannot fill the queue for the rest
+
+// What a command stops or starts, for the queue to tell which commands a stop makes stale: kind is 't' for a
+// throttle, with key its register, 'p' for track power, with key a hash of the districts named, or all set when
+// it names none; 0 for the rest.
+struct CommandTarget {
+	char kind = 0;
+	uint32_t key = 0;
+	bool all = false;
+	bool stop = false;        // emergency stop or power off
+};
+
+inline CommandTarget targetOf(const DCCpp::Server::Command &c)
+{
+	CommandTarget t;
+	if (c.op == 't') {
+		t.kind = 't';
+		t.key = c.args[0];
+		t.stop = c.args[2] < 0;
+	} else if (c.op == 0 && c.text[0] == '<' && c.text[1] == 't' && c.text[2] == ' ') {
+		// <t REGISTER CAB SPEED DIRECTION>
+		char *p;
+		t.kind = 't';
+		t.key = strtol(c.text + 3, &p, 10);
+		strtol(p, &p, 10);
+		t.stop = strtol(p, &p, 10) < 0;
+	} else if (c.op == 0 && c.text[0] == '<' && (c.text[1] == '0' || c.text[1] == '1')
+			&& (c.text[2] == ' ' || c.text[2] == '>')) {
+		t.kind = 'p';
+		t.all = c.text[2] == '>';
+		t.key = 2166136261u;
+		for (const char *p = c.text + 2; *p; p++) {
+			t.key = (t.key ^ (uint8_t)*p) * 16777619u;
+		}
+		t.stop = c.text[1] == '0';
+	}
+	return t;
+}
+
+// The ticket of the last stop that ran for one target.
+struct StopTicket {
+	bool set = false;
+	uint32_t ticket = 0;
+	void ran(uint32_t t) { set = true; ticket = t; }
+	bool after(uint32_t t) const { return set && (int32_t)(ticket - t) > 0; }
+};
+
+// Commands for the base station, pushed without a lock from the AsyncTCP handlers, CabCache, the scheduler tasks
+// and the TCP server, and run by loop().  Emergency stops and power off have a lane of their own that loop()
+// empties first.  A throttle or power on that was pushed before a stop of its target but is still queued when the
+// stop has run is dropped, so that it cannot undo the stop.  For that loop() keeps the ticket of the last stop run
+// for each register and each power district, and of the last <0>, which covers every district; a stop beyond what
+// it has room for counts for all registers beyond QUEUE_REGISTERS, or for every district.
+//
+// A TCP or websocket client (Command.client other than 0) that floods the queue is refused once it has
+// QUEUE_CLIENT_SHARE commands waiting, so that the others still get theirs in, and wait behind at most that many
+// of its commands.  Its stops are never refused for that.  The server's own commands, with client 0, are not
+// counted.
+struct PendingQueue {
+	struct Entry {
+		DCCpp::Server::Command command;
+		uint32_t ticket;      // order of the push across both lanes
+	};
+	struct DistrictStop {
+		uint32_t key;
+		StopTicket stop;
+	};
+	CommandQueue<Entry, 8> urgent;
+	CommandQueue<Entry, 64> normal;
+	std::atomic<uint32_t> tickets{0};
+	std::atomic<uint32_t> tooLong{0};   // text commands that do not fit COMMAND_TEXT_MAX
+	std::atomic<uint32_t> overShare{0}; // commands refused because their client had its share waiting
+	std::atomic<uint8_t> waiting[QUEUE_CLIENTS] = {};   // of each client, commands pushed and not yet popped
+	uint32_t superseded = 0;            // commands dropped because a stop pushed after them ran first
+	// read and written by loop() only
+	StopTicket registerStops[QUEUE_REGISTERS + 1];   // the last one for all registers beyond
+	StopTicket powerOff;                // <0>, or a district that did not fit districtStops
+	DistrictStop districtStops[QUEUE_DISTRICTS];
+	uint8_t districts = 0;
+
+	bool push(const DCCpp::Server::Command &c) {
+		bool stop = targetOf(c).stop;
+		if (c.client != 0) {
+			std::atomic<uint8_t> &n = waitingFor(c.client);
+			if (n.fetch_add(1, std::memory_order_relaxed) >= QUEUE_CLIENT_SHARE && !stop) {
+				n.fetch_sub(1, std::memory_order_relaxed);
+				overShare.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+		}
+		Entry e{c, tickets.fetch_add(1, std::memory_order_relaxed)};
+		e.command.queued = micros();
+		// a stop that finds the urgent lane full still runs, in its turn
+		if ((stop && urgent.push(e)) || normal.push(e)) {
+			return true;
+		}
+		popped(c);
+		return false;
+	}
+	bool push(const char *text, size_t length, uint8_t client = 0) {
+		if (length >= COMMAND_TEXT_MAX) {
+			tooLong.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		DCCpp::Server::Command c;
+		memcpy(c.text, text, length);
+		c.text[length] = 0;
+		c.client = client;
+		return push(c);
+	}
+	bool push(const String &s) { return push(s.c_str(), s.length()); }
+	uint32_t count() const { return urgent.count() + normal.count(); }
+	bool pop(DCCpp::Server::Command &c) {
+		Entry e;
+		if (urgent.pop(e)) {
+			popped(e.command);
+			ran(targetOf(e.command), e.ticket);
+			c = e.command;
+			return true;
+		}
+		while (normal.pop(e)) {
+			popped(e.command);
+			CommandTarget t = targetOf(e.command);
+			if (t.stop) {
+				ran(t, e.ticket);
+			} else if (stale(t, e.ticket)) {
+				superseded++;
+				continue;
+			}
+			c = e.command;
+			return true;
+		}
+		return false;
+	}
+	std::atomic<uint8_t> &waitingFor(uint8_t client) {
+		return waiting[client < QUEUE_CLIENTS ? client : QUEUE_CLIENTS - 1];
+	}
+	void popped(const DCCpp::Server::Command &c) {
+		if (c.client != 0) {
+			waitingFor(c.client).fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+	StopTicket &registerStop(uint32_t reg) {
+		return registerStops[reg < QUEUE_REGISTERS ? reg : QUEUE_REGISTERS];
+	}
+	void ran(const CommandTarget &t, uint32_t ticket) {
+		if (t.kind == 't') {
+			registerStop(t.key).ran(ticket);
+		} else if (t.all) {
+			powerOff.ran(ticket);
+		} else {
+			for (uint8_t i = 0; i < districts; i++) {
+				if (districtStops[i].key == t.key) {
+					districtStops[i].stop.ran(ticket);
+					return;
+				}
+			}
+			if (districts < QUEUE_DISTRICTS) {
+				districtStops[districts].key = t.key;
+				districtStops[districts++].stop.ran(ticket);
+			} else {
+				powerOff.ran(ticket);
+			}
+		}
+	}
+	bool stale(const CommandTarget &t, uint32_t ticket) {
+		if (t.kind == 't') {
+			return registerStop(t.key).after(ticket);
+		}
+		if (t.kind != 'p') {
+			return false;
+		}
+		if (powerOff.after(ticket)) {
+			return true;
+		}
+		// <1> powers every district on again, so any district stopped since makes it stale
+		for (uint8_t i = 0; i < districts; i++) {
+			if ((t.all || districtStops[i].key == t.key) && districtStops[i].stop.after(ticket)) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
@@ -0,0 +1,57 @@
+/**********************************************************************
+ ReplyEvent.h
+ Part of DCC++ BASE STATION for the Arduino / ESP8266
+ **********************************************************************/
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLY_EVENT_ARGS 5    // REPLY_ARGS of DCCpp_Uno/src/Reply.h
+
+namespace DCCpp {
+	namespace Server {
+		// A reply of the base station as its letter and numbers, such as <T 3 50 1> or <r1|2|29 6>, for the
+		// server to act on.  In the LocalWeb build (COMM_INTERFACE 5) the replies built with Reply come as events
+		// straight from their numbers; all others are read from text once, by parseReply.
+		struct ReplyEvent {
+			char letter = 0;
+			uint8_t n = 0;
+			int32_t args[REPLY_EVENT_ARGS];
+			uint32_t key = 0;             // the key by which a newer reply replaces it (see TxRing.h), 0 from text
+			const char *name = nullptr;   // text after the numbers, such as the board of <a CURRENT BOARD>
+			uint8_t nameLength = 0;       // name is not terminated
+		};
+
+		// Reads <LETTER NUMBER ...>, the numbers separated by spaces or |, and what text follows them.
+		inline bool parseReply(const char *text, ReplyEvent &e)
+		{
+			if (text[0] != '<' || text[1] == '\0' || text[1] == '>') {
+				return false;
+			}
+			e = ReplyEvent();
+			e.letter = text[1];
+			const char *p = text + 2;
+			for (;;) {
+				while (*p == ' ' || *p == '|') {
+					p++;
+				}
+				if (*p == '>' || *p == '\0') {
+					return true;
+				}
+				char *end;
+				long v = strtol(p, &end, 10);
+				if (end == p) {
+					const char *close = strchr(p, '>');
+					e.name = p;
+					e.nameLength = close ? close - p : strlen(p);
+					return true;
+				}
+				if (e.n < REPLY_EVENT_ARGS) {
+					e.args[e.n++] = v;
+				}
+				p = end;
+			}
+		}
+	}
+}
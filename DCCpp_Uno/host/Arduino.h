@@ -0,0 +1,87 @@
+/**********************************************************************
+
+Arduino.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Just enough of the Arduino core for the host build (env:native in platformio.ini) to compile the
+// packet engine and the virtual track generator.  Pins do nothing, and the clock is the simulated clock
+// of the virtual track, so time only moves while GenerateDCC::run() is generating bits.
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define HEX 16
+#define INPUT 0
+#define OUTPUT 1
+
+#define A0 14
+#define A1 15
+#define A5 19
+#define NUM_ANALOG_INPUTS 8
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+
+inline void pinMode(int, int) {}
+inline void digitalWrite(int, int) {}
+inline int digitalRead(int) { return LOW; }
+inline int analogRead(int) { return 0; }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+struct IPAddress {
+  uint8_t bytes[4];
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : bytes{a, b, c, d} {}
+  uint8_t operator[](int i) const { return bytes[i]; }
+};
+
+// The byte streams SerialLink reads and writes (see host/LinkLoopback.cpp).
+struct Print {
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t *buf, size_t n) { size_t r = 0; while(n--) r += write(*buf++); return r; }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+  virtual ~Print() {}
+};
+
+struct Stream : Print {
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+// Serial output goes to stderr, stdout may be carrying the track stream.
+struct HostSerial {
+  void begin(long) {}
+  int printf(const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
+  void print(const char *s) { fputs(s, stderr); }
+  void print(long v, int base = 10) { fprintf(stderr, base == HEX ? "%lX" : "%ld", v); }
+  void print(const IPAddress &ip) { fprintf(stderr, "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]); }
+  void println(const char *s = "") { fprintf(stderr, "%s\n", s); }
+  void println(long v) { fprintf(stderr, "%ld\n", v); }
+};
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,175 @@
+/**********************************************************************
+
+BinaryBench.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Bytes per command and commands per second of the binary framing (see BinaryCommand.h) against the text
+// protocol, for the commands that have a numeric frame.  Each command goes in through CommInterface::receive()
+// of an interface whose replies are counted, so the figures take in framing, argument parsing, running the
+// command and queuing its replies, in text or, after <U BIN 1>, in binary.
+//
+//   binary_bench [seconds per case]
+
+#include "DCCpp.h"
+#include "PacketRegister.h"
+#include "CommInterface.h"
+#include "SerialCommand.h"
+#include "CurrentMonitor.h"
+#include "Tracks.h"
+#include "EEPROM.h"
+#include <chrono>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+volatile RegisterList mainRegs(MAX_MAIN_REGISTERS);
+volatile RegisterList progRegs(2);
+
+HostSerial Serial;
+EEPROMClass EEPROM;
+
+int HostSerial::printf(const char *fmt, ...){
+  return 0;
+}
+
+unsigned long micros(){
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned long millis(){
+  return micros()/1000;
+}
+
+void delay(unsigned long ms){
+}
+
+void delayMicroseconds(unsigned int us){
+}
+
+void MotorBoardManager::parse(const char *command){
+}
+
+void MotorBoardManager::showStatus(bool toSource){
+}
+
+Track *TrackManager::find(const char *name, size_t length){
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+  // Takes commands from the bench and counts the reply bytes CommInterface hands it.
+  struct BenchInterface : CommInterface{
+    long written=0;
+    BenchInterface(){ pacing=PACE_NONE; }
+    void process(){}
+    void showConfiguration(){}
+    void showInitInfo(){}
+    void send(const char *buf){ written+=strlen(buf); }
+    void write(const uint8_t *buf, size_t len){ written+=len; }
+    bool canSendBinary() const { return true; }
+    void feed(const uint8_t *bytes, size_t n){
+      for(size_t i=0;i<n;i++)
+        receive(bytes[i]);
+      flush();
+    }
+    void feed(const char *text){ feed((const uint8_t *)text,strlen(text)); }
+  };
+
+  BenchInterface bench;
+
+  struct Case{
+    const char *text;                      // the text command
+    char letter;
+    const char *fields;                    // its numeric frame, see BinaryCommand.h
+    int32_t args[4];
+    uint8_t nArgs;
+    uint16_t tag;                          // non zero: sent as <#ID COMMAND>
+  };
+
+  const Case cases[]={
+    {"<t 1 1234 126 1>",'t',"bwcb",{1,1234,126,1},4,0},
+    {"<f 1234 144>",'f',"wb",{1234,144},2,0},
+    {"<a 10 2 1>",'a',"wbb",{10,2,1},3,0},
+    {"<T 1 1>",'T',"wb",{1,1},2,0},
+    {"<Z 1 1>",'Z',"wb",{1,1},2,0},
+    {"<w 3 1 5>",'w',"wwb",{3,1,5},3,0},
+    {"<#12 t 1 1234 126 1>",'t',"bwcb",{1,1234,126,1},4,12},
+  };
+
+  struct Frame{
+    uint8_t bytes[BIN_MAX_FRAME];
+    uint8_t n;
+  };
+
+  Frame binaryFrame(const Case &c){
+    CommandArgs a;
+    a.n=c.nArgs;
+    for(uint8_t i=0;i<c.nArgs;i++)
+      a.v[i]=c.args[i];
+    uint8_t payload[BIN_MAX_PAYLOAD];
+    int n=BinaryCommand::encode(c.fields,a,payload);
+    Frame f;
+    if(c.tag==0){
+      f.n=BinaryCommand::frame(f.bytes,c.letter|BIN_NUMERIC,payload,n);
+    } else{
+      uint8_t tagged[BIN_MAX_PAYLOAD];
+      tagged[0]=(uint8_t)c.tag;
+      tagged[1]=(uint8_t)(c.tag>>8);
+      tagged[2]=c.letter|BIN_NUMERIC;
+      memcpy(tagged+3,payload,n);
+      f.n=BinaryCommand::frame(f.bytes,'#'|BIN_NUMERIC,tagged,n+3);
+    }
+    return f;
+  }
+
+  // Commands per second and reply bytes per command of feeding bytes to the bench interface over and over.
+  double perSecond(const uint8_t *bytes, size_t n, double seconds, double &replyBytes){
+    auto start=std::chrono::steady_clock::now();
+    long done=0;
+    long written=bench.written;
+    double t;
+    do{
+      for(int i=0;i<1000;i++)
+        bench.feed(bytes,n);
+      done+=1000;
+      t=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    } while(t<seconds);
+    replyBytes=(double)(bench.written-written)/done;
+    return done/t;
+  }
+}
+
+int main(int argc, char **argv){
+  double seconds=argc>1 ? atof(argv[1]) : 0.5;
+  SerialCommand::init(&mainRegs, &progRegs);
+  CommManager::registerInterface(&bench);
+  bench.feed("<T 1 10 2><Z 1 5 0>");       // the turnout and output the cases switch
+
+  printf("%-22s %8s %8s %12s %12s %8s %12s %12s\n","command","text in","bin in","text out","bin out","saved","text cmd/s","bin cmd/s");
+  double textIn=0, binIn=0, textOut=0, binOut=0;
+  for(const Case &c : cases){
+    Frame f=binaryFrame(c);
+    double textReply, binReply;
+    bench.feed("<U BIN 0>");
+    double text=perSecond((const uint8_t *)c.text,strlen(c.text),seconds,textReply);
+    bench.feed("<U BIN 1>");
+    double bin=perSecond(f.bytes,f.n,seconds,binReply);
+    size_t in=strlen(c.text);
+    printf("%-22s %7zuB %7uB %11.1fB %11.1fB %7.0f%% %12.0f %12.0f\n",c.text,in,f.n,textReply,binReply,
+      100.0*(1-(f.n+binReply)/(in+textReply)),text,bin);
+    textIn+=in;
+    binIn+=f.n;
+    textOut+=textReply;
+    binOut+=binReply;
+  }
+  bench.feed("<U BIN 0>");
+  size_t n=sizeof(cases)/sizeof(cases[0]);
+  printf("%-22s %7.1fB %7.1fB %11.1fB %11.1fB %7.0f%%\n","(mean)",textIn/n,binIn/n,textOut/n,binOut/n,
+    100.0*(1-(binIn+binOut)/(textIn+textOut)));
+  return 0;
+}
@@ -0,0 +1,170 @@
+/**********************************************************************
+
+DccAnalyse.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Conformance and throughput report for a half-bit timing stream, e.g. from the virtual track:
+//
+//   dccpp_host 60 < script | dcc_analyse [-s] [-e ADDRESS=BYTES ...]
+//
+// Reports decode errors, packets per second and refresh intervals per address, and address spacing
+// violations (S-9.2: at least 5ms from the end of a packet to the start of the next packet for the same address).
+// Exits with 1 if any packet could not be decoded, or with -s also on short preambles and spacing violations,
+// so it can be used as a regression check for changes to the packet engine.  -e expects the last packet on
+// track 0 for a short ADDRESS to be BYTES, in hex without the checksum (e.g. -e 3=033F80), and exits with 1 if
+// it is not; scripts in host/scripts give the -e they are checked with.
+
+#include "DccDecoder.h"
+#include <map>
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#define  DCC_MIN_ADDRESS_SPACING_US   5000
+
+namespace {
+  struct AddressStats{
+    unsigned long packets=0;
+    uint64_t lastStart=0;
+    uint64_t lastEnd=0;
+    uint64_t minInterval=UINT64_MAX;
+    uint64_t maxInterval=0;
+    uint64_t sumInterval=0;
+    unsigned long spacingViolations=0;
+    char last[2*DCC_MAX_PACKET_BYTES+1]={};   // bytes of the last packet in hex, without the checksum
+  };
+
+  struct Analyser : DccListener{
+    std::map<int, AddressStats> addresses[8];
+    unsigned long packets[8]={};
+    unsigned long idle[8]={};
+    unsigned long errors[DCC_ERR_COUNT]={};
+    uint8_t firstTrack[DCC_ERR_COUNT]={};  // where and when each kind of error was first seen
+    uint64_t firstTime[DCC_ERR_COUNT]={};
+    unsigned long spacingViolations=0;
+    uint64_t end=0;
+
+    void packet(const DccPacket &p) override{
+      if(p.end>end)
+        end=p.end;
+      packets[p.track]++;
+      int a=p.address();
+      if(a<0){
+        idle[p.track]++;
+        return;
+      }
+      AddressStats &s=addresses[p.track][a];
+      if(s.packets>0){
+        uint64_t interval=p.start-s.lastStart;
+        s.minInterval=interval<s.minInterval ? interval : s.minInterval;
+        s.maxInterval=interval>s.maxInterval ? interval : s.maxInterval;
+        s.sumInterval+=interval;
+        if(a!=0 && p.start-s.lastEnd<DCC_MIN_ADDRESS_SPACING_US){
+          s.spacingViolations++;
+          spacingViolations++;
+        }
+      }
+      s.packets++;
+      s.lastStart=p.start;
+      s.lastEnd=p.end;
+      for(int i=0;i<p.nBytes-1;i++)
+        snprintf(s.last+2*i, 3, "%02X", p.bytes[i]);
+    }
+
+    void error(uint8_t track, DccError e, uint64_t time) override{
+      if(errors[e]++==0){
+        firstTrack[e]=track;
+        firstTime[e]=time;
+      }
+    }
+
+    void report(){
+      double seconds=end/1e6;
+      printf("stream: %.3f s\n", seconds);
+      for(int t=0;t<8;t++){
+        if(packets[t]==0)
+          continue;
+        printf("\ntrack %d: %lu packets (%.1f/s), %lu idle\n", t, packets[t], packets[t]/seconds, idle[t]);
+        printf("  %-10s %10s %10s %10s %10s %10s %10s\n", "address", "packets", "per s", "min ms", "avg ms", "max ms", "spacing");
+        for(auto &e : addresses[t]){
+          const AddressStats &s=e.second;
+          char name[16];
+          if(e.first>=DCC_ACCESSORY_ADDRESS_BASE)
+            snprintf(name, sizeof(name), "acc %d", e.first-DCC_ACCESSORY_ADDRESS_BASE);
+          else if(e.first>=DCC_LONG_ADDRESS_BASE)
+            snprintf(name, sizeof(name), "long %d", e.first-DCC_LONG_ADDRESS_BASE);
+          else
+            snprintf(name, sizeof(name), "%d", e.first);
+          if(s.packets>1)
+            printf("  %-10s %10lu %10.1f %10.1f %10.1f %10.1f %10lu\n", name, s.packets, s.packets/seconds,
+              s.minInterval/1e3, s.sumInterval/1e3/(s.packets-1), s.maxInterval/1e3, s.spacingViolations);
+          else
+            printf("  %-10s %10lu %10.1f %10s %10s %10s %10lu\n", name, s.packets, s.packets/seconds, "-", "-", "-", s.spacingViolations);
+        }
+      }
+      printf("\nerrors:\n");
+      for(int e=0;e<DCC_ERR_COUNT;e++){
+        printf("  %-22s %lu", dccErrorName((DccError)e), errors[e]);
+        if(errors[e]>0)
+          printf(", first on track %d at %.6f s", firstTrack[e], firstTime[e]/1e6);
+        printf("\n");
+      }
+      printf("  %-22s %lu\n", "address spacing", spacingViolations);
+    }
+
+    bool failed(bool strict){
+      for(int e=0;e<DCC_ERR_COUNT;e++)
+        if(errors[e]>0 && (strict || e!=DCC_ERR_SHORT_PREAMBLE))
+          return true;
+      return strict && spacingViolations>0;
+    }
+
+    // Checks an -e ADDRESS=BYTES expectation.
+    bool expected(const char *e){
+      char *bytes;
+      int a=strtol(e, &bytes, 10);
+      if(*bytes++!='=')
+        return false;
+      auto s=addresses[0].find(a);
+      const char *last=s==addresses[0].end() ? "none" : s->second.last;
+      bool ok=strcasecmp(last, bytes)==0;
+      printf("  %-22s %s, expected %s%s\n", e, last, bytes, ok ? "" : " FAILED");
+      return ok;
+    }
+  };
+}
+
+int main(int argc, char **argv){
+  bool strict=false;
+  const char *name=nullptr;
+  const char *expect[16];
+  int nExpect=0;
+  for(int i=1;i<argc;i++){
+    if(strcmp(argv[i], "-s")==0)
+      strict=true;
+    else if(strcmp(argv[i], "-e")==0 && i+1<argc && nExpect<16)
+      expect[nExpect++]=argv[++i];
+    else
+      name=argv[i];
+  }
+  FILE *in=name ? fopen(name, "rb") : stdin;
+  if(!in){
+    perror(name);
+    return 2;
+  }
+  Analyser analyser;
+  if(!dccDecodeStream(in, analyser)){
+    fprintf(stderr, "not a DCC1 half-bit stream\n");
+    return 2;
+  }
+  analyser.report();
+  bool failed=analyser.failed(strict);
+  if(nExpect>0)
+    printf("\nlast packets:\n");
+  for(int i=0;i<nExpect;i++)
+    failed|=!analyser.expected(expect[i]);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+/**********************************************************************
+
+DccDecoder.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "DccDecoder.h"
+#include <memory>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+
+int DccPacket::address() const{
+  uint8_t b=bytes[0];
+  if(b==0xFF)
+    return -1;                             // idle packet
+  if(b<=127)
+    return b;                              // broadcast or short address
+  if(b<=191)                               // basic accessory: 10AAAAAA 1AAACDDD, upper address bits inverted
+    return DCC_ACCESSORY_ADDRESS_BASE+((b&0x3F)|((~bytes[1]&0x70)<<2));
+  if(b<=231)
+    return DCC_LONG_ADDRESS_BASE+(((b&0x3F)<<8)|bytes[1]);
+  return b;                                // reserved range, reported as is
+} // DccPacket::address
+
+///////////////////////////////////////////////////////////////////////////////
+
+DccDecoder::DccDecoder(uint8_t track, DccListener &listener)
+: track(track), listener(listener), now(0), firstHalf(0){
+  resync();                                // the stream may start in the middle of a packet
+} // DccDecoder::DccDecoder
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DccDecoder::resync(){
+  state=PREAMBLE;
+  ones=0;
+  lost=true;
+  preambleStart=now;
+} // DccDecoder::resync
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DccDecoder::halfBit(uint32_t us){
+  if(!isOne(us) && !isZero(us)){
+    listener.error(track, DCC_ERR_HALF_BIT_TIMING, now);
+    now+=us;
+    firstHalf=0;
+    resync();
+    return;
+  }
+  if(firstHalf==0){
+    firstHalf=us;
+    bitStart=now;
+    now+=us;
+    return;
+  }
+  uint32_t h1=firstHalf;
+  firstHalf=0;
+  now+=us;
+  bool one=isOne(h1);
+  if(one!=isOne(us) || (one && (h1>us ? h1-us : us-h1)>DCC_ONE_HALF_DIFF_MAX)){
+    listener.error(track, DCC_ERR_MISMATCHED_HALVES, bitStart);
+    firstHalf=us;                          // assume we were out of step and the second half starts a new bit
+    bitStart=now-us;
+    resync();
+    return;
+  }
+  uint64_t end=now;
+  now=bitStart;                            // bit() advances the clock by the whole bit
+  bit(one, (uint32_t)(end-bitStart));
+} // DccDecoder::halfBit
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DccDecoder::bit(bool one, uint32_t us){
+  uint64_t start=now;
+  now+=us;
+  switch(state){
+    case PREAMBLE:
+      if(one){
+        if(ones==0)
+          preambleStart=start;
+        if(ones<255)
+          ones++;
+        if(ones>=DCC_DECODE_PREAMBLE)
+          lost=false;
+      } else if(ones<DCC_DECODE_PREAMBLE){
+        if(!lost)
+          listener.error(track, DCC_ERR_NO_PREAMBLE, start);
+        lost=true;
+        ones=0;
+      } else{                              // packet start bit
+        current.track=track;
+        current.start=preambleStart;
+        current.preamble=ones;
+        current.nBytes=0;
+        nBits=0;
+        state=DATA;
+      }
+      break;
+    case DATA:
+      if(current.nBytes<DCC_MAX_PACKET_BYTES)
+        current.bytes[current.nBytes]=(current.bytes[current.nBytes]<<1)|(one ? 1 : 0);
+      if(++nBits==8){
+        current.nBytes++;
+        state=SEPARATOR;
+      }
+      break;
+    case SEPARATOR:
+      if(!one){                            // data byte start bit, another byte follows
+        nBits=0;
+        state=DATA;
+        break;
+      }
+      current.end=now;                     // packet end bit
+      if(current.nBytes<3 || current.nBytes>DCC_MAX_PACKET_BYTES){
+        listener.error(track, DCC_ERR_PACKET_LENGTH, current.start);
+      } else{
+        uint8_t x=0;
+        for(uint8_t i=0;i<current.nBytes;i++)
+          x^=current.bytes[i];
+        if(x!=0){
+          listener.error(track, DCC_ERR_CHECKSUM, current.start);
+        } else{
+          if(current.preamble<DCC_MIN_PREAMBLE)
+            listener.error(track, DCC_ERR_SHORT_PREAMBLE, current.start);
+          listener.packet(current);
+        }
+      }
+      state=PREAMBLE;                      // the end bit may also be the first bit of the next preamble
+      ones=1;
+      preambleStart=start;
+      break;
+  }
+} // DccDecoder::bit
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool dccDecodeStream(FILE *in, DccListener &listener, uint8_t maxTracks){
+  char header[4];
+  if(fread(header, 1, 4, in)!=4 || header[0]!='D' || header[1]!='C' || header[2]!='C' || header[3]!='1')
+    return false;
+  std::vector<std::unique_ptr<DccDecoder>> decoders(maxTracks);
+  DccDecoder *d=nullptr;
+  int c;
+  while((c=getc(in))!=EOF){
+    if(c&0x80){
+      uint8_t t=c&0x7F;
+      if(t>=maxTracks){
+        d=nullptr;
+        continue;
+      }
+      if(!decoders[t])
+        decoders[t].reset(new DccDecoder(t, listener));
+      d=decoders[t].get();
+    } else if(d){
+      d->halfBit(c);
+    }
+  }
+  return true;
+} // dccDecodeStream
+
+///////////////////////////////////////////////////////////////////////////////
+
+const char *dccErrorName(DccError e){
+  switch(e){
+    case DCC_ERR_HALF_BIT_TIMING: return "half-bit timing";
+    case DCC_ERR_MISMATCHED_HALVES: return "mismatched half-bits";
+    case DCC_ERR_SHORT_PREAMBLE: return "short preamble";
+    case DCC_ERR_NO_PREAMBLE: return "missing preamble";
+    case DCC_ERR_PACKET_LENGTH: return "packet length";
+    case DCC_ERR_CHECKSUM: return "checksum";
+    default: return "?";
+  }
+} // dccErrorName
@@ -0,0 +1,90 @@
+/**********************************************************************
+
+DccDecoder.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Host-side decoder for the half-bit timing stream written by the virtual track (GenerateDCC_host.cpp),
+// or by anything else that can report half-bit durations.  It turns half-bits back into DCC bits and packets and
+// checks them against the command station requirements of NMRA S-9.1 and S-9.2: half-bit timing, preamble length,
+// start/stop bits, packet length and the XOR checksum.
+
+#ifndef DccDecoder_h
+#define DccDecoder_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define  DCC_ONE_HALF_MIN          55      // S-9.1: a command station sends ONE half-bits of 55-61us
+#define  DCC_ONE_HALF_MAX          61
+#define  DCC_ONE_HALF_DIFF_MAX     3       // and the two halves of a ONE may differ by at most 3us
+#define  DCC_ZERO_HALF_MIN         95      // ZERO half-bits of 95-9900us
+#define  DCC_ZERO_HALF_MAX         9900
+#define  DCC_MIN_PREAMBLE          14      // S-9.2: a command station sends at least 14 preamble bits
+#define  DCC_DECODE_PREAMBLE       10      // packets with at least this many preamble bits are still decoded
+#define  DCC_MAX_PACKET_BYTES      6
+
+enum DccError{
+  DCC_ERR_HALF_BIT_TIMING,                 // a half-bit that is neither a ONE nor a ZERO half
+  DCC_ERR_MISMATCHED_HALVES,               // the two halves of a bit are of different kinds or differ too much
+  DCC_ERR_SHORT_PREAMBLE,                  // packet decoded, but sent with fewer than DCC_MIN_PREAMBLE bits
+  DCC_ERR_NO_PREAMBLE,                     // start bit after fewer than DCC_DECODE_PREAMBLE ONE bits, not decoded
+  DCC_ERR_PACKET_LENGTH,                   // fewer than 3 or more than DCC_MAX_PACKET_BYTES bytes
+  DCC_ERR_CHECKSUM,
+  DCC_ERR_COUNT
+};
+
+struct DccPacket{
+  uint8_t track;
+  uint64_t start;                          // time of the first preamble bit, in microseconds since the start of the stream
+  uint64_t end;                            // time at the end of the packet end bit
+  uint8_t preamble;                        // number of preamble bits
+  uint8_t nBytes;                          // including the checksum byte
+  uint8_t bytes[DCC_MAX_PACKET_BYTES];
+  int address() const;                     // decoder address (see DccAddress), or -1 for idle packets
+}; // DccPacket
+
+// Addresses are reported in one number space: 0 broadcast, 1-127 short, 128+ (long address + 10000) for long
+// addresses so they never collide with short ones, and 20000 + accessory address for accessory decoders.
+#define  DCC_LONG_ADDRESS_BASE       10000
+#define  DCC_ACCESSORY_ADDRESS_BASE  20000
+
+struct DccListener{
+  virtual void packet(const DccPacket &p) = 0;
+  virtual void error(uint8_t track, DccError e, uint64_t time) = 0;
+  virtual ~DccListener() {}
+}; // DccListener
+
+class DccDecoder{
+public:
+  DccDecoder(uint8_t track, DccListener &listener);
+  void halfBit(uint32_t us);               // the next half-bit, alternating in level
+  void bit(bool one, uint32_t us);         // the next whole bit, for sources that do not have half-bit timing
+  uint64_t time() const { return now; }
+private:
+  enum State { PREAMBLE, DATA, SEPARATOR };
+  uint8_t track;
+  DccListener &listener;
+  uint64_t now;
+  uint32_t firstHalf;                      // duration of the first half of the bit being received, 0 if none
+  State state;
+  uint8_t ones;                            // ONE bits counted towards the preamble
+  bool lost;                               // out of step after an error, missing preambles are not reported until the next one
+  uint64_t preambleStart;
+  uint64_t bitStart;
+  uint8_t nBits;                           // bits received of the current byte
+  DccPacket current;
+  static bool isOne(uint32_t us) { return us >= DCC_ONE_HALF_MIN && us <= DCC_ONE_HALF_MAX; }
+  static bool isZero(uint32_t us) { return us >= DCC_ZERO_HALF_MIN && us <= DCC_ZERO_HALF_MAX; }
+  void resync();
+}; // DccDecoder
+
+// Reads the binary stream format of GenerateDCC_host.cpp and hands the half-bits of each track to its own decoder.
+// Returns false if the stream does not start with the DCC1 header.
+bool dccDecodeStream(FILE *in, DccListener &listener, uint8_t maxTracks = 8);
+
+const char *dccErrorName(DccError e);
+
+#endif
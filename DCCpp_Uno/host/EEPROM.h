@@ -0,0 +1,31 @@
+/**********************************************************************
+
+EEPROM.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Just enough of the Arduino EEPROM library for host builds that run the accessory commands (see host/ParseBench.cpp):
+// the EEPROM is a zeroed array in memory, so nothing stored survives the run.
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define  HOST_EEPROM_SIZE          4096
+
+struct EEPROMClass{
+  uint8_t bytes[HOST_EEPROM_SIZE];
+  template<class T> T &get(int at, T &t){ memcpy(&t,bytes+at,sizeof(T)); return t; }
+  template<class T> const T &put(int at, const T &t){ memcpy(bytes+at,&t,sizeof(T)); return t; }
+  uint8_t read(int at){ return bytes[at]; }
+  void write(int at, uint8_t b){ bytes[at]=b; }
+  void commit(){}
+}; // EEPROMClass
+
+extern EEPROMClass EEPROM;
+
+#endif
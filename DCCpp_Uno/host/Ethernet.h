@@ -0,0 +1,105 @@
+/**********************************************************************
+
+Ethernet.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Just enough of the Arduino Ethernet library for the loopback test of EthernetInterface (see
+// host/EthernetLoopback.cpp).  The W5100 sockets are hostSockets[], which the test connects, feeds and closes
+// from the client side; what the base station writes to a socket collects in its tx.
+
+#ifndef Ethernet_h
+#define Ethernet_h
+
+#include <Arduino.h>
+#include <string>
+
+#define MAX_SOCK_NUM 4
+
+struct HostSocket {
+  enum State : uint8_t { CLOSED, LISTEN, ESTABLISHED, CLOSE_WAIT };
+  State state = CLOSED;
+  std::string rx;                  // sent by the client, not yet read by the base station
+  size_t rxAt = 0;
+  std::string tx;                  // written by the base station
+  void close() { if(state == ESTABLISHED) state = CLOSE_WAIT; }
+};
+extern HostSocket hostSockets[MAX_SOCK_NUM];
+
+class EthernetClient {
+public:
+  EthernetClient() : sock(MAX_SOCK_NUM) {}
+  explicit EthernetClient(uint8_t sock) : sock(sock) {}
+  uint8_t connected() {
+    if(sock == MAX_SOCK_NUM)
+      return 0;
+    HostSocket &s = hostSockets[sock];
+    return s.state == HostSocket::ESTABLISHED || (s.state == HostSocket::CLOSE_WAIT && available() > 0);
+  }
+  int available() { return sock == MAX_SOCK_NUM ? 0 : (int)(hostSockets[sock].rx.size() - hostSockets[sock].rxAt); }
+  int read() { return available() > 0 ? (uint8_t)hostSockets[sock].rx[hostSockets[sock].rxAt++] : -1; }
+  size_t write(const uint8_t *buf, size_t len) {
+    if(sock == MAX_SOCK_NUM || hostSockets[sock].state != HostSocket::ESTABLISHED)
+      return 0;
+    hostSockets[sock].tx.append((const char *)buf, len);
+    return len;
+  }
+  void stop() {
+    if(sock == MAX_SOCK_NUM)
+      return;
+    hostSockets[sock] = HostSocket();
+    sock = MAX_SOCK_NUM;
+  }
+  bool operator==(const EthernetClient &rhs) const { return sock == rhs.sock && sock != MAX_SOCK_NUM; }
+  operator bool() { return sock != MAX_SOCK_NUM; }
+private:
+  uint8_t sock;
+};
+
+class EthernetServer {
+public:
+  explicit EthernetServer(uint16_t port) {}
+  void begin() { listen(); }
+  // Keeps a socket listening, as the library does, and returns the first connected socket with data.
+  EthernetClient available() {
+    listen();
+    for(uint8_t i = 0; i < MAX_SOCK_NUM; i++) {
+      EthernetClient client(i);
+      if(client.connected() && client.available() > 0)
+        return client;
+    }
+    return EthernetClient();
+  }
+private:
+  void listen() {
+    for(HostSocket &s : hostSockets)
+      if(s.state == HostSocket::LISTEN)
+        return;
+    for(HostSocket &s : hostSockets)
+      if(s.state == HostSocket::CLOSED) {
+        s.state = HostSocket::LISTEN;
+        return;
+      }
+  }
+};
+
+struct EthernetClass {
+  void begin(const uint8_t *mac) {}
+  void begin(const uint8_t *mac, IPAddress ip) {}
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+};
+extern EthernetClass Ethernet;
+
+// The client side of a connection: takes the listening socket, -1 if there is none.
+inline int hostConnect() {
+  for(int i = 0; i < MAX_SOCK_NUM; i++)
+    if(hostSockets[i].state == HostSocket::LISTEN) {
+      hostSockets[i].state = HostSocket::ESTABLISHED;
+      return i;
+    }
+  return -1;
+}
+
+#endif
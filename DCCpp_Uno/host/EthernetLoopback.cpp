@@ -0,0 +1,184 @@
+/**********************************************************************
+
+EthernetLoopback.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Loopback test of EthernetInterface (COMM_INTERFACE 1) against the socket model in host/Ethernet.h.
+//
+//   ethernet_loopback [COMMANDS per sender]
+//
+// Three clients connect: two senders, each sending COMMANDS (default 2000) throttle commands in pieces of random
+// size as fast as the socket buffer takes them, and a listener that never sends anything.  A fourth connection
+// must be refused.  Each pass of the main loop is 1ms of simulated time.  Every command must arrive intact and in
+// order, and the listener must see every reply.  Then a sender disconnects, and its slot must go to the next client.
+// Prints commands per simulated second, which the limits in RateLimit.h cap, commands per pass and the host time
+// per command; exits 1 on a failure.
+
+#include "DCCpp.h"
+#include "PacketRegister.h"
+#include "CommInterface.h"
+#include "CommInterfaceEthernet.h"
+#include "SerialCommand.h"
+#include "Accessories.h"
+#include "Outputs.h"
+#include <chrono>
+#include <stdarg.h>
+
+#define  LOOPBACK_SENDERS          2
+#define  LOOPBACK_SOCKET_BUFFER    2048    // W5100 receive buffer per socket
+
+volatile RegisterList mainRegs(MAX_MAIN_REGISTERS);
+volatile RegisterList progRegs(2);
+
+volatile RegisterList *SerialCommand::mRegs=&mainRegs;
+volatile RegisterList *SerialCommand::pRegs=&progRegs;
+
+HostSerial Serial;
+EthernetClass Ethernet;
+HostSocket hostSockets[MAX_SOCK_NUM];
+
+namespace {
+  unsigned long simulated;                 // micros()
+  long next[LOOPBACK_SENDERS+1];           // by register: the next command number expected
+  long wrong;                              // commands that arrived garbled or out of order
+}
+
+int HostSerial::printf(const char *fmt, ...){
+  va_list args;
+  va_start(args, fmt);
+  int n=vfprintf(stderr, fmt, args);
+  va_end(args);
+  return n;
+}
+
+unsigned long micros(){
+  return simulated;
+}
+
+unsigned long millis(){
+  return simulated/1000;
+}
+
+void delay(unsigned long ms){
+  simulated+=ms*1000;
+}
+
+void delayMicroseconds(unsigned int us){
+  simulated+=us;
+}
+
+// Sender s sends <t s+1 CAB SPEED 1> with CAB and SPEED taken from its command number.
+void SerialCommand::parse(const char *com){
+  int reg, cab, speed, direction;
+  char end;
+  if(sscanf(com, "t %d %d %d %d%c", &reg, &cab, &speed, &direction, &end)!=4 || reg<1 || reg>LOOPBACK_SENDERS ||
+     cab!=1+next[reg]%10000 || speed!=next[reg]%127){
+    wrong++;
+    return;
+  }
+  next[reg]++;
+  CommManager::printf("<T %d %d %d>", cab, speed, direction);
+}
+
+void SerialCommand::acknowledge(uint16_t id, uint16_t errors, unsigned long start){
+}
+
+void Turnout::parse(const CommandArgs &a){
+}
+
+void Output::parse(const CommandArgs &a){
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+  struct Sender{
+    int sock;
+    std::string text;                      // all its commands
+    size_t sent;
+  };
+
+  size_t replies(int sock){
+    size_t n=0;
+    for(size_t at=hostSockets[sock].tx.find("<T ");at!=std::string::npos;at=hostSockets[sock].tx.find("<T ",at+1))
+      n++;
+    return n;
+  }
+
+  bool check(bool ok, const char *what){
+    printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+    return ok;
+  }
+}
+
+int main(int argc, char **argv){
+  long commands=argc>1 ? atol(argv[1]) : 2000;
+  bool ok=true;
+  EthernetInterface ethernet;
+  CommManager::registerInterface(&ethernet);
+  CommManager::update();
+
+  Sender senders[LOOPBACK_SENDERS];
+  for(int s=0;s<LOOPBACK_SENDERS;s++){
+    senders[s].sock=hostConnect();
+    CommManager::update();
+    senders[s].sent=0;
+    char buf[32];
+    for(long i=0;i<commands;i++){
+      snprintf(buf, sizeof(buf), "<t %d %ld %ld 1>", s+1, 1+i%10000, i%127);
+      senders[s].text+=buf;
+    }
+  }
+  int listener=hostConnect();
+  CommManager::update();
+  int refused=hostConnect();
+  CommManager::update();
+  ok&=check(listener>=0 && refused>=0 && hostSockets[refused].state==HostSocket::CLOSED, "fourth connection refused");
+
+  srand(1);
+  long passes=0;
+  auto start=std::chrono::steady_clock::now();
+  while(passes<commands*1000){
+    bool done=true;
+    for(Sender &s : senders){
+      HostSocket &sock=hostSockets[s.sock];
+      size_t room=LOOPBACK_SOCKET_BUFFER-(sock.rx.size()-sock.rxAt);
+      size_t piece=1+rand()%48;
+      piece=piece<room ? piece : room;
+      piece=piece<s.text.size()-s.sent ? piece : s.text.size()-s.sent;
+      sock.rx.append(s.text, s.sent, piece);
+      s.sent+=piece;
+      done&=s.sent==s.text.size() && sock.rxAt==sock.rx.size();
+    }
+    if(done)
+      break;
+    CommManager::update();
+    simulated+=1000;
+    passes++;
+  }
+  double host=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+  long total=0;
+  for(int r=1;r<=LOOPBACK_SENDERS;r++)
+    total+=next[r];
+  printf("%ld commands from %d senders in %ld passes (%.1f simulated seconds)\n", total, LOOPBACK_SENDERS, passes, passes/1000.0);
+  printf("%.0f commands/s, %.3f commands/pass, %.2f us host time per command\n",
+    total/(passes/1000.0), (double)total/passes, host*1e6/total);
+  ok&=check(total==commands*LOOPBACK_SENDERS && wrong==0, "every command arrived intact and in order");
+  ok&=check(replies(listener)==(size_t)total, "the listener that never sent saw every reply");
+
+  hostSockets[senders[0].sock].close();
+  CommManager::update();
+  ok&=check(hostSockets[senders[0].sock].state==HostSocket::CLOSED, "a closed client is stopped");
+  int late=hostConnect();
+  CommManager::update();
+  hostSockets[senders[1].sock].rx+="<t 2 1 0 1>";
+  next[2]=0;
+  simulated+=100000;                       // the senders used up their credit
+  CommManager::update();
+  ok&=check(late>=0 && replies(late)==1, "its slot goes to the next client");
+  return ok ? 0 : 1;
+}
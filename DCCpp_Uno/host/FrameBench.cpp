@@ -0,0 +1,216 @@
+/**********************************************************************
+
+FrameBench.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Characters per second and heap allocations of collecting the commands < > of a received stream: FrameAssembler
+// (see FrameAssembler.h) against the loop each interface had before, which grew a String with buffer += ch and
+// emptied it with buffer = "" after each command.  ModelString below does what the AVR core's WString does for
+// those two: += reserves exactly one more character, realloc()ing whenever that is beyond its capacity, and = ""
+// keeps the capacity.
+//
+//   frame_bench [seconds per case]
+//
+// Both must hand over the same commands.  Prints allocations for the first pass over the stream, when the String
+// grows to the longest command, and for all later passes; exits 1 if the commands differ.
+
+#include "FrameAssembler.h"
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+namespace {
+  size_t allocations;                      // realloc()s of ModelString and operator news
+  size_t heapBytes;                        // most held at once by ModelString
+  uint32_t sink;
+
+  // The parts of the AVR core's String that the old framing loops used.
+  class ModelString{
+    char *buffer=NULL;
+    unsigned capacity=0;
+    unsigned len=0;
+    bool reserve(unsigned size){
+      if(buffer && capacity>=size)
+        return true;
+      char *grown=(char *)realloc(buffer, size+1);
+      allocations++;
+      if(grown==NULL)
+        return false;
+      buffer=grown;
+      capacity=size;
+      if(capacity+1>heapBytes)
+        heapBytes=capacity+1;
+      if(len==0)
+        buffer[0]='\0';
+      return true;
+    }
+    bool concat(const char *cstr, unsigned length){
+      if(length==0)
+        return true;
+      if(!reserve(len+length))
+        return false;
+      strcpy(buffer+len, cstr);
+      len+=length;
+      return true;
+    }
+  public:
+    ModelString(const char *cstr){ *this=cstr; }
+    ~ModelString(){ free(buffer); }
+    ModelString &operator=(const char *cstr){
+      unsigned length=strlen(cstr);
+      if(reserve(length)){
+        len=length;
+        strcpy(buffer, cstr);
+      }
+      return *this;
+    }
+    ModelString &operator+=(char c){
+      char buf[2]={c, '\0'};
+      concat(buf, 1);
+      return *this;
+    }
+    const char *c_str() const { return buffer; }
+  };
+
+  // Folds a command into a checksum, so that both ways can be compared.
+  void command(uint32_t &sum, const char *text){
+    for(;*text;text++)
+      sum=sum*31+(uint8_t)*text;
+    sum=sum*31+'>';
+  }
+
+  struct Legacy{
+    ModelString buffer{""};
+    bool inCommandPayload=false;
+    uint32_t sum=0;
+    long commands=0;
+    void feed(const char *s, size_t n){
+      for(size_t i=0;i<n;i++){
+        char ch=s[i];
+        if(ch=='<'){
+          inCommandPayload=true;
+          buffer="";
+        } else if(ch=='>'){
+          command(sum, buffer.c_str());
+          commands++;
+          buffer="";
+          inCommandPayload=false;
+        } else if(inCommandPayload){
+          buffer+=ch;
+        }
+      }
+    }
+  };
+
+  struct Assembled{
+    FrameAssembler frame;
+    uint32_t sum=0;
+    long commands=0;
+    void feed(const char *s, size_t n){
+      for(size_t i=0;i<n;i++){
+        if(frame.feed(s[i])==FrameAssembler::COMMAND){
+          command(sum, frame.text);
+          commands++;
+        }
+      }
+    }
+  };
+
+  // What a throttle or the web server sends: throttles, functions, turnouts, status, with line ends between.
+  std::string makeStream(){
+    std::string s;
+    char buf[48];
+    for(int i=0;i<200;i++){
+      snprintf(buf, sizeof(buf), "<t %d %d %d 1>\n", 1+i%8, 1000+i, i%127);
+      s+=buf;
+      snprintf(buf, sizeof(buf), "<f %d %d>\n", 1000+i, 128+i%32);
+      s+=buf;
+      snprintf(buf, sizeof(buf), "<T %d %d>", 10+i%20, i&1);
+      s+=buf;
+      if(i%25==0)
+        s+="<s>\r\n<Z 5 1>\r\n<a SOME TRACK NAME>";
+    }
+    return s;
+  }
+
+  struct Result{
+    double mbPerSecond;
+    long commands;
+    uint32_t sum;
+    size_t firstAllocations;               // in the first pass
+    size_t laterAllocations;               // in all other passes
+    size_t heap;
+  };
+
+  template<class Way> Result run(const std::string &stream, double seconds){
+    Result r;
+    allocations=0;
+    heapBytes=0;
+    Way way;
+    way.feed(stream.data(), stream.size());
+    r.firstAllocations=allocations;
+    auto start=std::chrono::steady_clock::now();
+    long passes=0;
+    double t;
+    do{
+      way.feed(stream.data(), stream.size());
+      passes++;
+      t=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    } while(t<seconds);
+    r.laterAllocations=allocations-r.firstAllocations;
+    r.mbPerSecond=passes*stream.size()/t/1e6;
+    r.commands=way.commands;
+    r.sum=way.sum;
+    r.heap=heapBytes;
+    sink+=way.sum;
+    return r;
+  }
+
+  void show(const char *name, const Result &r, size_t streamCommands){
+    long passes=r.commands/streamCommands;
+    printf("%-22s %10.1f %14zu %14.3f %10zu\n", name, r.mbPerSecond, r.firstAllocations,
+      passes>1 ? (double)r.laterAllocations*1000/(r.commands-streamCommands) : 0.0, r.heap);
+  }
+}
+
+void *operator new(size_t size){
+  allocations++;
+  void *p=malloc(size);
+  if(p==NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept{
+  free(p);
+}
+
+int main(int argc, char **argv){
+  double seconds=argc>1 ? atof(argv[1]) : 0.5;
+  std::string stream=makeStream();
+  Assembled count;
+  count.feed(stream.data(), stream.size());
+  printf("%zu bytes, %ld commands per pass\n", stream.size(), count.commands);
+  printf("%-22s %10s %14s %14s %10s\n", "", "MB/s", "first pass", "per 1000 later", "heap bytes");
+  Result legacy=run<Legacy>(stream, seconds);
+  Result assembled=run<Assembled>(stream, seconds);
+  show("String += ch", legacy, count.commands);
+  show("FrameAssembler", assembled, count.commands);
+  printf("allocations in the first pass and per 1000 commands after; FrameAssembler %.1fx the characters per second\n",
+    assembled.mbPerSecond/legacy.mbPerSecond);
+  Legacy once;
+  once.feed(stream.data(), stream.size());
+  bool same=once.sum==count.sum && once.commands==count.commands;
+  printf("%-64s %s\n", "both hand over the same commands", same ? "ok" : "FAILED");
+  return same ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/**********************************************************************
+
+HostMain.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Driver for the host build: replays a script of main and programming track commands against the
+// packet registers and writes what the virtual track generator puts on the rails (see GenerateDCC_host.cpp).
+//
+//   dccpp_host [SECONDS] < script > track.bin
+//
+// Each script line is a time in milliseconds followed by a command in the same form as the text
+// protocol, without the brackets, e.g. "1500 t 1 3 20 1".  Supported commands are t, f, a, w, b, M, P, and [ and ]
+// to batch commands (see CommandBatch.h).
+// Lines must be in time order.  After the last line the track keeps running until SECONDS (default 60)
+// of simulated time have been generated.
+
+#include "DCCpp.h"
+#include "PacketRegister.h"
+#include "CommInterface.h"
+#include "GenerateDCC.h"
+#include "SerialCommand.h"
+#include "CommandBatch.h"
+#include <stdarg.h>
+
+volatile RegisterList mainRegs(MAX_MAIN_REGISTERS);
+volatile RegisterList progRegs(2);
+
+volatile RegisterList *SerialCommand::mRegs=&mainRegs;
+volatile RegisterList *SerialCommand::pRegs=&progRegs;
+CommInterface *CommManager::source=NULL;
+uint16_t CommManager::errors=0;
+
+HostSerial Serial;
+
+int HostSerial::printf(const char *fmt, ...){
+  va_list args;
+  va_start(args, fmt);
+  int n=vfprintf(stderr, fmt, args);
+  va_end(args);
+  return n;
+}
+
+unsigned long millis(){
+  return GenerateDCC::now()/1000;
+}
+
+unsigned long micros(){
+  return GenerateDCC::now();
+}
+
+void delay(unsigned long ms){
+  GenerateDCC::run(ms*1000);
+}
+
+void delayMicroseconds(unsigned int us){
+  GenerateDCC::run(us);
+}
+
+void CommManager::printf(const char *fmt, ...){
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+void CommManager::respond(const char *fmt, ...){
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+void CommManager::send(const Reply &r){
+  fprintf(stderr, "%s\n", r.buf);
+}
+
+void CommManager::respond(const Reply &r){
+  send(r);
+}
+
+void CommManager::reject(){
+  fail();
+  respond("<X>");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void runUntil(uint64_t us){
+  for(uint64_t t=GenerateDCC::now();t<us;t=GenerateDCC::now()){   // polls batches as often as a main loop would
+    GenerateDCC::run(us-t<1000 ? us-t : 1000);
+    CommandBatch::poll();
+  }
+}
+
+static void command(const char *com){
+  switch(com[0]){
+    case 't': mainRegs.setThrottle(com+1); break;
+    case 'f': mainRegs.setFunction(com+1); break;
+    case 'a': mainRegs.setAccessory(com+1); break;
+    case 'w': mainRegs.writeCVByteMain(com+1); break;
+    case 'b': mainRegs.writeCVBitMain(com+1); break;
+    case 'M': mainRegs.writeTextPacket(com+1); break;
+    case 'P': progRegs.writeTextPacket(com+1); break;
+    case '[': CommandBatch::begin(); break;
+    case ']': CommandBatch::commit(); break;
+    default: fprintf(stderr, "unsupported command: %s\n", com);
+  }
+}
+
+int main(int argc, char **argv){
+  double seconds=argc>1 ? atof(argv[1]) : 60;
+  GenerateDCC::setup();
+  char line[128];
+  while(fgets(line, sizeof(line), stdin)){
+    char *com;
+    unsigned long ms=strtoul(line, &com, 10);
+    while(*com==' ' || *com=='\t')
+      com++;
+    com[strcspn(com, "\r\n")]='\0';
+    if(*com=='\0' || *com=='#')
+      continue;
+    runUntil((uint64_t)ms*1000);
+    command(com);
+  }
+  runUntil((uint64_t)(seconds*1e6));
+  GenerateDCC::finish();
+  return 0;
+}
@@ -0,0 +1,124 @@
+/**********************************************************************
+
+I2sBench.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Samples per second of the I2S generator's encoder (see I2sEncoder.h) against one that works out each sample
+// on its own, filling 64 word refills as the refill task does, for bit streams of all ones, all zeros and random
+// bits.  Before timing, the two encoders are checked to give the same words.
+//
+//   i2s_bench [seconds per case]
+//
+// One output needs 1000000/I2S_SAMPLE_US samples a second, the last column is how many outputs' worth the
+// encoder keeps up with on this machine.
+
+#include "I2sEncoder.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define  BENCH_REFILL_WORDS        64      // REFILL_WORDS in GenerateDCC_ESP32_I2S.cpp
+
+using GenerateDCC::I2sEncoder;
+using GenerateDCC::I2S_ONE_SAMPLES;
+using GenerateDCC::I2S_ZERO_SAMPLES;
+using GenerateDCC::I2S_SAMPLE_US;
+
+namespace {
+  volatile uint32_t sink;                  // keeps the results alive
+
+  // The straightforward encoder: one sample at a time, shifting each into the word.
+  struct SampleEncoder{
+    uint8_t remaining=0;
+    uint8_t halves=0;
+    uint8_t halfLength=0;
+
+    template<class NextBit>
+    void encode(uint32_t *words, size_t nWords, NextBit &&nextBit){
+      for(size_t i=0;i<nWords;i++){
+        uint32_t word=0;
+        for(int s=0;s<32;s++){
+          if(remaining==0){
+            if(halves==0){
+              halfLength=nextBit() ? I2S_ONE_SAMPLES : I2S_ZERO_SAMPLES;
+              halves=2;
+            }
+            remaining=halfLength;
+            halves--;
+          }
+          remaining--;
+          word=word<<1 | (halves==1);
+        }
+        words[i]=word;
+      }
+    }
+  }; // SampleEncoder
+
+  struct Bits{
+    const char *name;
+    bool (*next)();
+  };
+
+  uint32_t state=0x2545F491;
+
+  const Bits streams[]={
+    {"ones",[]{ return true; }},
+    {"zeros",[]{ return false; }},
+    {"random",[]{ state^=state<<13; state^=state>>17; state^=state<<5; return (bool)(state&1); }},
+  };
+
+  template<class Encoder>
+  double perSecond(bool (*next)(), double seconds){
+    Encoder e;
+    uint32_t words[BENCH_REFILL_WORDS];
+    auto start=std::chrono::steady_clock::now();
+    long n=0;
+    double t;
+    do{
+      for(int i=0;i<1000;i++){
+        e.encode(words,BENCH_REFILL_WORDS,next);
+        sink+=words[i%BENCH_REFILL_WORDS];
+      }
+      n+=1000;
+      t=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    } while(t<seconds);
+    return n*BENCH_REFILL_WORDS*32.0/t;
+  }
+
+  bool same(bool (*next)()){
+    I2sEncoder run;
+    SampleEncoder sample;
+    uint32_t a[BENCH_REFILL_WORDS], b[BENCH_REFILL_WORDS];
+    for(int i=0;i<1000;i++){
+      uint32_t saved=state;
+      run.encode(a,BENCH_REFILL_WORDS,next);
+      state=saved;                         // the random stream again, for the other encoder
+      sample.encode(b,BENCH_REFILL_WORDS,next);
+      for(int w=0;w<BENCH_REFILL_WORDS;w++)
+        if(a[w]!=b[w])
+          return false;
+    }
+    return true;
+  }
+}
+
+int main(int argc, char **argv){
+  double seconds=argc>1 ? atof(argv[1]) : 0.5;
+  double needed=1000000.0/I2S_SAMPLE_US;
+  int failed=0;
+  printf("%-8s %18s %18s %8s %10s\n","bits","per sample/s","I2sEncoder/s","speedup","outputs");
+  for(const Bits &b : streams){
+    if(!same(b.next)){
+      printf("%-8s encoders disagree\n",b.name);
+      failed=1;
+      continue;
+    }
+    double s=perSecond<SampleEncoder>(b.next,seconds);
+    double r=perSecond<I2sEncoder>(b.next,seconds);
+    printf("%-8s %18.0f %18.0f %7.1fx %10.0f\n",b.name,s,r,r/s,r/needed);
+  }
+  return failed;
+}
@@ -0,0 +1,86 @@
+/**********************************************************************
+
+JournalCheck.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Checks of the change journal behind <V EPOCH N> (see Journal.h): the delta a client gets, replacement of older
+// entries about the same thing, reuse of the room they leave, and loss of entries when the journal is full.
+//
+//   journal_check
+//
+// Prints each check and the bytes of the replies a delta takes; exits 1 on a failure.
+
+#include "Journal.h"
+#include "Arduino.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+unsigned long micros(){
+  return 0x12345678;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+  bool check(bool ok, const char *what){
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    return ok;
+  }
+
+  // The replies <V EPOCH N> sends for the changes after n, one per line.
+  std::string delta(uint32_t n){
+    std::string s;
+    Journal::since(n, [&](const JournalEntry &e){
+      char buf[48];
+      Journal::format(e, buf, sizeof(buf));
+      s+=buf;
+      s+='\n';
+    });
+    return s;
+  }
+
+  bool ordered(){
+    for(uint8_t i=1;i<Journal::count;i++)
+      if(Journal::entries[i].seq<=Journal::entries[i-1].seq)
+        return false;
+    return true;
+  }
+}
+
+int main(){
+  bool ok=true;
+  ok&=check(Journal::epoch()!=0 && Journal::epoch()==Journal::epoch(), "the epoch is not 0 and stays the same");
+
+  Journal::record('T', 3, 50, 1);
+  Journal::record('H', 10, 1);
+  Journal::record('Y', 5, 1);
+  Journal::record('Q', 7, 1);
+  Journal::record('p', 0, 1);
+  std::string d=delta(0);
+  printf("delta after five changes: %zu bytes\n", d.size());
+  ok&=check(d=="<T 3 50 1>\n<H 10 1>\n<Y 5 1>\n<Q 7>\n<p1>\n", "five changes come back in order");
+  ok&=check(delta(3)=="<Q 7>\n<p1>\n", "a client at 3 gets only the later two");
+
+  Journal::record('T', 3, 0, 1);
+  ok&=check(Journal::count==5 && delta(0)=="<H 10 1>\n<Y 5 1>\n<Q 7>\n<p1>\n<T 3 0 1>\n",
+    "a newer speed for cab 3 replaces the older entry");
+  ok&=check(delta(5)=="<T 3 0 1>\n", "a client at 5 gets the new speed only");
+
+  for(int i=0;i<10*JOURNAL_ENTRIES;i++)  // ten cabs changing over and over
+    Journal::record('T', 100+i%10, i%127, 1);
+  ok&=check(Journal::count==15 && ordered(), "replaced entries leave no gaps");
+  ok&=check(Journal::lost==0 && Journal::covers(1) && delta(1).find("<H 10 1>")!=std::string::npos,
+    "the turnout changed once long ago is still held");
+
+  uint32_t before=Journal::seq;
+  for(int i=0;i<JOURNAL_ENTRIES;i++)     // more different things than the journal holds
+    Journal::record('Q', 200+i, 1);
+  ok&=check(Journal::count==JOURNAL_ENTRIES && ordered(), "a full journal stays in order");
+  ok&=check(!Journal::covers(1) && Journal::lost==before, "the entries pushed out make older clients take a snapshot");
+  ok&=check(Journal::covers(before), "a client that saw them is still covered");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+/**********************************************************************
+
+LinkLoopback.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Two SerialLinks (see SerialLink.h), the base station's and the ESP's, joined by two simulated 115200 baud wires
+// that corrupt bytes and, for 4s of every 9s, lose everything the ESP sends, its acks included.
+//
+//   link_loopback [SECONDS per case]
+//
+// Both ends write numbered commands as fast as their link takes them, then stop writing and the wires are left
+// whole for LOOPBACK_SETTLE_MICROS.  By then every byte must have arrived exactly once and in order, through
+// corruption of 0, 0.1% and 1% of the bytes and every outage.  In the last case the ESP end restarts half way: what
+// it had not sent yet is gone, but everything after must still arrive once and in order, and the base station's
+// bytes must carry on where the old ESP left them.  Prints the bytes each way, how often the link came up and the
+// frames sent again or rejected; exits 1 on a failure.
+
+#include "Arduino.h"
+#include "SerialLink.h"
+#include <deque>
+#include <random>
+#include <string>
+
+#define  LOOPBACK_BYTE_MICROS      87      // one byte, 10 bits at 115200 baud
+#define  LOOPBACK_STEP_MICROS      100     // of simulated time between two polls of each end
+#define  LOOPBACK_OUTAGE_EVERY     9000000
+#define  LOOPBACK_OUTAGE_FOR       4000000
+#define  LOOPBACK_SETTLE_MICROS    5000000 // after the last write, longer than LINK_DEAD_MICROS
+
+namespace {
+  unsigned long simulated=1000;            // micros()
+  std::mt19937 rng(7);
+}
+
+unsigned long micros(){
+  return simulated;
+}
+
+unsigned long millis(){
+  return simulated/1000;
+}
+
+void delay(unsigned long ms){
+  simulated+=ms*1000;
+}
+
+void delayMicroseconds(unsigned int us){
+  simulated+=us;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+  // One direction of the serial line: bytes take their turn at the baud rate, and may be corrupted or lost.
+  struct Wire{
+    struct Byte{ unsigned long at; uint8_t b; };
+    std::deque<Byte> bytes;
+    unsigned long freeAt=0;                // when the line has sent the bytes before
+    double corrupt=0;                      // share of the bytes with a bit flipped
+    bool cut=false;                        // everything written is lost
+    void put(uint8_t b){
+      if(cut)
+        return;
+      if(std::uniform_real_distribution<double>()(rng)<corrupt)
+        b^=1<<(rng()%8);
+      freeAt=(freeAt>simulated ? freeAt : simulated)+LOOPBACK_BYTE_MICROS;
+      bytes.push_back({freeAt,b});
+    }
+    bool ready() const { return !bytes.empty() && bytes.front().at<=simulated; }
+  };
+
+  // What one end's serial port sees: it writes to one wire and reads from the other.
+  struct Port : Stream{
+    Wire &in, &out;
+    Port(Wire &in, Wire &out) : in(in), out(out) {}
+    int available(){
+      int n=0;
+      for(const Wire::Byte &b : in.bytes)
+        if(b.at>simulated || ++n>=64)
+          break;
+      return n;
+    }
+    int read(){
+      if(!in.ready())
+        return -1;
+      uint8_t b=in.bytes.front().b;
+      in.bytes.pop_front();
+      return b;
+    }
+    int peek(){ return in.ready() ? in.bytes.front().b : -1; }
+    size_t write(uint8_t b){ out.put(b); return 1; }
+  };
+
+  // One end's application: writes numbered commands and keeps what it read.
+  struct End{
+    char open, close;                      // of its commands, so that the two directions cannot be mixed up
+    long next=0;
+    std::string sent, got;
+    void run(SerialLink &link, bool writing){
+      char s[16];
+      int n=snprintf(s, sizeof(s), "%c%ld%c", open, next, close);
+      if(writing && link.up() && link.space()>=n && rng()%4==0){
+        link.write((const uint8_t *)s, n);
+        sent+=s;
+        next++;
+      }
+      while(link.available())
+        got+=(char)link.read();
+    }
+  };
+
+  bool check(bool ok, const char *what){
+    printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+    return ok;
+  }
+
+  bool run(double corrupt, bool restart, double seconds){
+    Wire toEsp, toBase;
+    toEsp.corrupt=corrupt;
+    toBase.corrupt=corrupt;
+    Port basePort(toBase, toEsp), espPort(toEsp, toBase);
+    SerialLink *base=new SerialLink(basePort), *esp=new SerialLink(espPort);
+    End baseEnd{'<','>'}, espEnd{'[',']'};
+    std::string espBefore;                 // what the ESP read before it restarted
+    std::string baseBefore;                // what the base station had read from the ESP by then
+    unsigned long start=simulated, end=start+(unsigned long)(seconds*1e6);
+    int outages=0;
+    while(simulated<end+LOOPBACK_SETTLE_MICROS){
+      unsigned long t=simulated-start;
+      bool cut=simulated<end && t%LOOPBACK_OUTAGE_EVERY>=LOOPBACK_OUTAGE_EVERY-LOOPBACK_OUTAGE_FOR;
+      outages+=cut && !toBase.cut;
+      toBase.cut=cut;
+      if(restart && t>=(unsigned long)(seconds*5e5) && espBefore.empty()){
+        delete esp;                        // its buffers and numbers are gone with it
+        esp=new SerialLink(espPort);
+        espBefore=espEnd.got;
+        baseBefore=baseEnd.got;
+        espEnd=End{'[',']'};
+        espEnd.next=1000000;               // its commands after the restart are told apart from the ones before
+      }
+      base->poll();
+      esp->poll();
+      baseEnd.run(*base, simulated<end);
+      espEnd.run(*esp, simulated<end);
+      simulated+=LOOPBACK_STEP_MICROS;
+    }
+    bool ok=true;
+    printf("%.1f%% of bytes corrupted, %d outages%s: %zu bytes to the ESP, %zu back, up %u/%u times, resent %u/%u, "
+      "rejected %u/%u\n", corrupt*100, outages, restart ? ", ESP restarted" : "", baseEnd.sent.size(), espEnd.sent.size(),
+      base->counters.ups, esp->counters.ups, base->counters.resent, esp->counters.resent, base->counters.rejected,
+      esp->counters.rejected);
+    if(!restart){
+      ok&=check(espEnd.got==baseEnd.sent, "the ESP read every byte sent to it once and in order");
+      ok&=check(baseEnd.got==espEnd.sent, "the base station read every byte sent to it once and in order");
+    } else{
+      ok&=check(espBefore+espEnd.got==baseEnd.sent, "across the restart the ESP read every byte once and in order");
+      std::string after=baseEnd.got.substr(baseBefore.size());
+      size_t at=after.find("[1000000]");
+      ok&=check(at!=std::string::npos && after.compare(at, std::string::npos, espEnd.sent)==0,
+        "the restarted ESP's bytes arrived once and in order");
+      bool ordered=true;                   // the old ESP's commands up to its restart, a prefix of what it sent
+      long last=-1;
+      for(size_t i=0;i<baseBefore.size()+at;i++)
+        if(baseEnd.got[i]=='['){
+          char *e;
+          long n=strtol(baseEnd.got.c_str()+i+1, &e, 10);
+          if(*e!=']')
+            continue;                      // the last one may be cut short by the restart
+          ordered&=n==last+1;
+          last=n;
+        }
+      ok&=check(ordered, "the old ESP's bytes before that were in order with none twice");
+    }
+    ok&=check(base->up() && esp->up(), "the link is up at the end");
+    delete base;
+    delete esp;
+    return ok;
+  }
+}
+
+int main(int argc, char **argv){
+  double seconds=argc>1 ? atof(argv[1]) : 60;
+  bool ok=true;
+  ok&=run(0, false, seconds);
+  ok&=run(0.001, false, seconds);
+  ok&=run(0.01, false, seconds);
+  ok&=run(0.001, true, seconds);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+/**********************************************************************
+
+LocalWebBench.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Host time of the hand-offs between the web server and the base station in the LocalWeb build (COMM_INTERFACE 5,
+// see CommInterfaceLocalWeb.h), the way they were and the way they are.
+//
+//   localweb_bench [seconds per case]
+//
+// Commands: a queued throttle command rendered as text and fed to CommInterface::receive() a character at a time,
+// against the same command run from its numbers with CommInterface::command(letter, args).  Both take it through
+// to the register being loaded.  Replies: a <T> reply read back from its text with parseReply, against the
+// ReplyEvent made from the numbers the Reply was built from.  On the ESP32 the <JW> histogram of <J> gives the
+// time from the queue to the command running, and <JR> the time from there to the rails.
+
+#include "DCCpp.h"
+#include "PacketRegister.h"
+#include "CommInterface.h"
+#include "SerialCommand.h"
+#include "CurrentMonitor.h"
+#include "Tracks.h"
+#include "EEPROM.h"
+#include "../../DCCpp_ESP/src/ReplyEvent.h"
+#include <chrono>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+volatile RegisterList mainRegs(MAX_MAIN_REGISTERS);
+volatile RegisterList progRegs(2);
+
+HostSerial Serial;
+EEPROMClass EEPROM;
+
+int HostSerial::printf(const char *fmt, ...){
+  return 0;
+}
+
+unsigned long micros(){
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned long millis(){
+  return micros()/1000;
+}
+
+void delay(unsigned long ms){
+}
+
+void delayMicroseconds(unsigned int us){
+}
+
+void MotorBoardManager::parse(const char *command){
+}
+
+void MotorBoardManager::showStatus(bool toSource){
+}
+
+Track *TrackManager::find(const char *name, size_t length){
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+using DCCpp::Server::ReplyEvent;
+using DCCpp::Server::parseReply;
+
+namespace {
+  volatile int32_t sink;                   // keeps the results alive
+
+  // Stands in for LocalWebInterface: takes its replies the way it does, without queuing them.
+  struct BenchInterface : CommInterface{
+    BenchInterface(){ pacing=PACE_NONE; }
+    void process(){}
+    void showConfiguration(){}
+    void showInitInfo(){}
+    void send(const char *buf){}
+    void write(const uint8_t *buf, size_t len){}
+    void reply(const char *buf, uint16_t n, uint32_t key){ sink=n; }
+    void reply(const Reply &r){ sink=r.nArgs; }
+    void text(const char *command){
+      while(*command)
+        receive(*command++);
+    }
+    void numbers(char letter, const CommandArgs &a){ command(letter,a); }
+  };
+
+  BenchInterface bench;
+
+  // Nanoseconds per call of f(i), run over and over for seconds.
+  template<class F> double perCall(double seconds, F &&f){
+    auto start=std::chrono::steady_clock::now();
+    long done=0;
+    double t;
+    do{
+      for(int i=0;i<1000;i++)
+        f(done+i);
+      done+=1000;
+      t=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    } while(t<seconds);
+    return t*1e9/done;
+  }
+
+  // The throttle command queued for i, as the web server's cab handler makes it.
+  void throttle(long i, CommandArgs &a){
+    a.n=4;
+    a.v[0]=1+i%8;
+    a.v[1]=1+i%1000;
+    a.v[2]=i%127;
+    a.v[3]=1;
+  }
+
+  void show(const char *what, double before, double now){
+    printf("%-44s %10.0f %10.0f %8.1fx\n", what, before, now, before/now);
+  }
+}
+
+int main(int argc, char **argv){
+  double seconds=argc>1 ? atof(argv[1]) : 0.5;
+  SerialCommand::init(&mainRegs, &progRegs);
+  CommManager::registerInterface(&bench);
+
+  printf("%-44s %10s %10s %9s\n","ns per","text","numbers","");
+  double text=perCall(seconds, [](long i){
+    CommandArgs a;
+    throttle(i,a);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "<t %ld %ld %ld %ld>", (long)a.v[0], (long)a.v[1], (long)a.v[2], (long)a.v[3]);
+    bench.text(buf);
+  });
+  double numbers=perCall(seconds, [](long i){
+    CommandArgs a;
+    throttle(i,a);
+    bench.numbers('t',a);
+  });
+  show("throttle command, queue to register loaded", text, numbers);
+
+  static std::vector<Reply> replies;       // built beforehand, so that only reading them is timed
+  for(int i=0;i<1000;i++)
+    replies.push_back(Reply::throttle(1+i, i%127, 1));
+  text=perCall(seconds, [](long i){
+    ReplyEvent e;
+    parseReply(replies[i%1000].buf, e);
+    sink=e.args[1];
+  });
+  numbers=perCall(seconds, [](long i){
+    const Reply &r=replies[i%1000];
+    ReplyEvent e;
+    e.letter=r.buf[1];
+    e.n=r.nArgs;
+    for(uint8_t j=0;j<r.nArgs;j++)
+      e.args[j]=r.args[j];
+    e.key=r.key;
+    sink=e.args[1];
+  });
+  show("<T> reply, read by the server", text, numbers);
+  return 0;
+}
@@ -0,0 +1,77 @@
+/**********************************************************************
+
+LogBench.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Host time of the diagnostic log (see Log.h): of LOG() on the command path, against the Serial.printf of the same
+// line it stands in for, and of drain() formatting records into lines later.
+//
+//   log_bench [seconds per case]
+//
+// printf here writes to a buffer in memory, so it shows the cost of formatting alone; a real UART adds waiting for
+// it.  Then a burst of LOG_ENTRIES * 4 records with nothing drained must leave the newest LOG_ENTRIES held and count
+// the rest as dropped.  Prints the times; exits 1 on a failure.
+
+#include "Log.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+unsigned long micros(){
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+namespace {
+  volatile int sink;                       // keeps the results alive
+
+  // Nanoseconds per call of f(i), run over and over for seconds.
+  template<class F> double perCall(double seconds, F &&f){
+    auto start=std::chrono::steady_clock::now();
+    long done=0;
+    double t;
+    do{
+      for(int i=0;i<1000;i++)
+        f(done+i);
+      done+=1000;
+      t=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    } while(t<seconds);
+    return t*1e9/done;
+  }
+
+  bool check(bool ok, const char *what){
+    printf("%-64s %s\n", what, ok ? "ok" : "FAILED");
+    return ok;
+  }
+}
+
+int main(int argc, char **argv){
+  double seconds=argc>1 ? atof(argv[1]) : 0.5;
+  double logged=perCall(seconds, [](long i){
+    LOG(LOG_THROTTLES, LOG_DEBUG, LOG_THROTTLE, 1+i%8, 1000+i%1000, i%127, 1);
+  });
+  double printed=perCall(seconds, [](long i){
+    char line[LOG_LINE_MAX];
+    sink+=snprintf(line, sizeof(line), "%10lu throttle register %ld cab %ld speed %ld direction %ld\n", micros(),
+      1+i%8, 1000+i%1000, i%127, 1L);
+  });
+  double drained=perCall(seconds, [](long i){
+    LOG(LOG_THROTTLES, LOG_DEBUG, LOG_THROTTLE, 1+i%8, 1000+i%1000, i%127, 1);
+    Log::drain(LOG_LINE_MAX, [](const char *line, int n){ sink+=n; });
+  });
+  printf("ns per record: LOG() %.0f, printf of the line %.0f, LOG() and drain() of the line %.0f\n", logged, printed,
+    drained);
+
+  bool ok=true;
+  Log::drain(1<<20, [](const char *line, int n){ sink+=n; });
+  uint32_t dropped=Log::dropped;
+  for(int i=0;i<LOG_ENTRIES*4;i++)
+    LOG(LOG_COMMANDS, LOG_DEBUG, LOG_COMMAND, 't', i);
+  LogEntry e;
+  ok&=check(Log::get(0, e) && e.args[1]==LOG_ENTRIES*3 && !Log::get(LOG_ENTRIES, e),
+    "a burst leaves the newest records held");
+  ok&=check(Log::dropped-dropped==LOG_ENTRIES*3, "the records overwritten before they were drained are dropped");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/**********************************************************************
+
+ParseBench.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Commands per second through SerialCommand::parse, for a corpus of the text commands a throttle session sends,
+// some malformed ones among them, and for the whole corpus taken in turn.
+//
+//   parse_bench [seconds per case]
+//
+// Replies are counted but not queued anywhere, so this is the cost of parsing a command and acting on it
+// (loading packets, switching turnouts and outputs), not of answering it.  Programming track commands wait
+// for an ACK and are left out.  As a baseline, the arguments of each command are also split alone, per second,
+// both with the sscanf format its handler used before CommandArgs and with CommandArgs as it is called now.
+
+#include "DCCpp.h"
+#include "PacketRegister.h"
+#include "CommInterface.h"
+#include "SerialCommand.h"
+#include "CurrentMonitor.h"
+#include "Tracks.h"
+#include "EEPROM.h"
+#include "CommandArgs.h"
+#include <chrono>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+volatile RegisterList mainRegs(MAX_MAIN_REGISTERS);
+volatile RegisterList progRegs(2);
+
+CommInterface *CommManager::source=NULL;
+uint16_t CommManager::errors=0;
+
+HostSerial Serial;
+EEPROMClass EEPROM;
+
+namespace {
+  long replies;
+  long replyBytes;
+}
+
+int HostSerial::printf(const char *fmt, ...){
+  return 0;
+}
+
+unsigned long micros(){
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned long millis(){
+  return micros()/1000;
+}
+
+void delay(unsigned long ms){
+}
+
+void delayMicroseconds(unsigned int us){
+}
+
+void CommManager::printf(const char *fmt, ...){
+  char buf[PRINTF_MAX];
+  va_list args;
+  va_start(args, fmt);
+  replyBytes+=vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  replies++;
+}
+
+void CommManager::respond(const char *fmt, ...){
+  char buf[PRINTF_MAX];
+  va_list args;
+  va_start(args, fmt);
+  replyBytes+=vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  replies++;
+}
+
+void CommManager::send(const Reply &r){
+  replyBytes+=r.n;
+  replies++;
+}
+
+void CommManager::respond(const Reply &r){
+  send(r);
+}
+
+void CommManager::reject(){
+  fail();
+  respond("<X>");
+}
+
+void CommManager::option(const char *s){
+}
+
+void CommManager::showCounters(){
+}
+
+void CommManager::showInitInfo(){
+}
+
+void MotorBoardManager::parse(const char *command){
+}
+
+void MotorBoardManager::showStatus(bool toSource){
+}
+
+Track *TrackManager::find(const char *name, size_t length){
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+  const char *const corpus[]={
+    "t 1 3 50 1",
+    "t 2 1234 126 0",
+    "t 3 3 -1 1",
+    "f 3 144",
+    "f 1234 222 5",
+    "a 10 2 1",
+    "T 1 1",
+    "Z 1 1",
+    "w 3 1 5",
+    "b 3 29 5 1",
+    "M 0 A3 3F 9F",
+    "M 0 0xA3 0x3F",
+    "#12 t 1 3 50 1",
+    "t\t1 3 50 1\r",
+    "t 1 3 x 1",
+    "t 1 3 50 1 7",
+  };
+  const size_t corpusSize=sizeof(corpus)/sizeof(corpus[0]);
+
+  // Setup commands, run once: the turnout and output the corpus switches.
+  const char *const setup[]={
+    "T 1 10 2",
+    "Z 1 5 0",
+  };
+
+  // How the handler of each letter splits its arguments: the sscanf it had, and its CommandArgs::parse now.
+  struct Split{
+    char letter;
+    const char *format;
+    uint8_t minArgs, maxArgs, hexMask;
+  };
+  const Split splits[]={
+    {'t', "%d %d %d %d", 4, 4, 0},
+    {'f', "%d %d %d", 2, 3, 0},
+    {'a', "%d %d %d", 3, 3, 0},
+    {'T', "%d %d %d", 0, 3, 0},
+    {'Z', "%d %d %d", 0, 3, 0},
+    {'w', "%d %d %d", 3, 3, 0},
+    {'b', "%d %d %d %d", 4, 4, 0},
+    {'M', "%d %x %x %x %x %x", 3, 6, 0x3E},
+  };
+
+  const Split *splitOf(const char *command){
+    for(const Split &s : splits)
+      if(s.letter==command[0])
+        return &s;
+    return NULL;                           // <#ID COMMAND> had no sscanf
+  }
+
+  volatile int32_t sink;
+
+  template<class F> double perSecond(double seconds, F &&f){
+    auto start=std::chrono::steady_clock::now();
+    long done=0;
+    double t;
+    do{
+      for(int i=0;i<10000;i++)
+        f();
+      done+=10000;
+      t=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    } while(t<seconds);
+    return done/t;
+  }
+
+  double sscanfPerSecond(const Split &s, const char *args, double seconds){
+    return perSecond(seconds, [&s, args]{
+      int v[6];
+      sink+=sscanf(args, s.format, v, v+1, v+2, v+3, v+4, v+5)+v[0];
+    });
+  }
+
+  double argsPerSecond(const Split &s, const char *args, double seconds){
+    return perSecond(seconds, [&s, args]{
+      CommandArgs a;
+      sink+=a.parse(args, s.minArgs, s.maxArgs, s.hexMask)+a.v[0];
+    });
+  }
+
+  double perSecond(const char *const *commands, size_t n, double seconds){
+    auto start=std::chrono::steady_clock::now();
+    long done=0;
+    double t;
+    do{
+      for(int i=0;i<10000;i++)
+        SerialCommand::parse(commands[(done+i)%n]);
+      done+=10000;
+      t=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    } while(t<seconds);
+    return done/t;
+  }
+}
+
+int main(int argc, char **argv){
+  double seconds=argc>1 ? atof(argv[1]) : 0.5;
+  SerialCommand::init(&mainRegs, &progRegs);
+  for(const char *s : setup)
+    SerialCommand::parse(s);
+
+  printf("%-18s %14s %8s %8s %6s %14s %14s\n","command","commands/s","replies","bytes","<X>","sscanf/s","CommandArgs/s");
+  for(size_t i=0;i<corpusSize;i++){
+    replies=0;
+    replyBytes=0;
+    uint16_t errors=CommManager::errorCount();
+    SerialCommand::parse(corpus[i]);
+    long once=replies, bytes=replyBytes;
+    int failed=CommManager::errorCount()-errors;
+    char name[32];
+    snprintf(name,sizeof(name),"<%s>",corpus[i]);
+    for(char *c=name;*c;c++)
+      if(*c=='\t' || *c=='\r')
+        *c='~';                            // keep the table on one line
+    printf("%-18s %14.0f %8ld %8ld %6d",name,perSecond(&corpus[i],1,seconds),once,bytes,failed);
+    const Split *split=splitOf(corpus[i]);
+    if(split!=NULL)
+      printf(" %14.0f %14.0f\n",sscanfPerSecond(*split,corpus[i]+1,seconds),argsPerSecond(*split,corpus[i]+1,seconds));
+    else
+      printf(" %14s %14s\n","-","-");
+  }
+  printf("%-18s %14.0f\n","(whole corpus)",perSecond(corpus,corpusSize,seconds));
+  return 0;
+}
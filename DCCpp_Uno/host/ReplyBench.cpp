@@ -0,0 +1,128 @@
+/**********************************************************************
+
+ReplyBench.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Messages per second and peak stack use of building the frequent replies, with Reply (see Reply.h) and the way
+// CommManager::printf builds them: vsnprintf into its buffer, then CommandArgs to find the status key again.
+//
+//   reply_bench [seconds per case]
+//
+// Only the building is measured, queuing the reply on the interfaces costs the same either way.
+
+#include "Reply.h"
+#include "CommandArgs.h"
+#include <chrono>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define  BENCH_PRINTF_BUFFER       256     // the buffer CommManager::printf had before PRINTF_MAX
+#define  BENCH_STACK_PROBE         16384
+
+namespace {
+  volatile uint32_t sink;                  // keeps the results alive
+
+  __attribute__((noinline)) uint32_t printfKey(const char *buf){
+    char args[24];
+    size_t n=strlen(buf);
+    if(n<5 || n>sizeof(args)+2 || buf[2]!=' ')
+      return 0;
+    memcpy(args,buf+2,n-3);
+    args[n-3]='\0';
+    CommandArgs a;
+    if(!a.parse(args,1,3))
+      return 0;
+    return (uint32_t)buf[1]<<16 | (uint16_t)a[0];
+  }
+
+  __attribute__((noinline)) void printfReply(const char *fmt, ...){
+    char buf[BENCH_PRINTF_BUFFER]={0};
+    va_list args;
+    va_start(args,fmt);
+    vsnprintf(buf,sizeof(buf),fmt,args);
+    va_end(args);
+    sink+=printfKey(buf)+buf[3];
+  }
+
+  __attribute__((noinline)) void sendReply(const Reply &r){
+    sink+=r.key+r.buf[3];
+  }
+
+  struct Case{
+    const char *name;
+    void (*printfPath)(int i);
+    void (*replyPath)(int i);
+  };
+
+  const Case cases[]={
+    {"<T>",[](int i){ printfReply("<T %d %d %d>",i&0x3FFF,i&0x7F,i&1); },
+           [](int i){ sendReply(Reply::throttle(i&0x3FFF,i&0x7F,i&1)); }},
+    {"<H>",[](int i){ printfReply("<H %d %d>",i&0x3FF,i&1); },
+           [](int i){ sendReply(Reply::turnout(i&0x3FF,i&1)); }},
+    {"<Y>",[](int i){ printfReply("<Y %d %d>",i&0x3FF,i&1); },
+           [](int i){ sendReply(Reply::output(i&0x3FF,i&1)); }},
+    {"<Q>",[](int i){ printfReply("<%c %d>",(i&1) ? 'Q' : 'q',i&0x3FF); },
+           [](int i){ sendReply(Reply::sensor(i&0x3FF,i&1)); }},
+    {"<a>",[](int i){ printfReply("<a %d>",i&0x3FF); },
+           [](int i){ sendReply(Reply::current(i&0x3FF)); }},
+    {"<r>",[](int i){ printfReply("<r%d|%d|%d %d>",i&0xFF,i&0x7,1+(i&0x3FF),i&0xFF); },
+           [](int i){ sendReply(Reply::cv(i&0xFF,i&0x7,1+(i&0x3FF),i&0xFF)); }},
+  };
+
+  double perSecond(void (*f)(int), double seconds){
+    auto start=std::chrono::steady_clock::now();
+    long n=0;
+    double t;
+    do{
+      for(int i=0;i<10000;i++)
+        f(n+i);
+      n+=10000;
+      t=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    } while(t<seconds);
+    return n/t;
+  }
+
+  // The stack a call uses, found by filling the stack below this frame with a pattern and looking how much of it
+  // the call overwrote.
+  __attribute__((noinline)) void paint(){
+    volatile uint8_t probe[BENCH_STACK_PROBE];
+    for(size_t i=0;i<sizeof(probe);i++)
+      probe[i]=0xA5;
+  }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"   // reading what paint() left is the point
+  __attribute__((noinline)) size_t painted(){
+    volatile uint8_t probe[BENCH_STACK_PROBE];
+    size_t i=0;
+    while(i<sizeof(probe) && probe[i]==0xA5)
+      i++;
+    return sizeof(probe)-i;
+  }
+#pragma GCC diagnostic pop
+
+  size_t stackUse(void (*f)(int)){
+    paint();
+    size_t base=painted();                 // what painted() itself leaves
+    paint();
+    f(12345);
+    size_t used=painted();
+    return used>base ? used-base : 0;
+  }
+}
+
+int main(int argc, char **argv){
+  double seconds=argc>1 ? atof(argv[1]) : 0.5;
+  printf("%-6s %16s %16s %8s %14s %14s\n","reply","printf msg/s","Reply msg/s","speedup","printf stack","Reply stack");
+  for(const Case &c : cases){
+    double p=perSecond(c.printfPath,seconds);
+    double r=perSecond(c.replyPath,seconds);
+    printf("%-6s %16.0f %16.0f %7.1fx %13zuB %13zuB\n",c.name,p,r,r/p,stackUse(c.printfPath),stackUse(c.replyPath));
+  }
+  return 0;
+}
@@ -0,0 +1,150 @@
+/**********************************************************************
+
+RmtCheck.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Checks of the RMT refill logic (see RmtStream.h) against a model of the channel: memory of two halves sent
+// over and over with wrap around, a read address that counts from the start of rmt memory, and a threshold event
+// each time the hardware is done with a half.  The refill interrupt is taken a few items after the event, now and
+// then so late that the hardware has resent a stale half, and now and then two events late so that they are taken
+// as one.
+//
+//   rmt_check [ITEMS sent per case]
+//
+// For one and two memory blocks per channel, every half the hardware sends must come from one refill, never torn
+// by a refill of the half being sent, and the bits sent, less the stale halves sent again, must be the generator's
+// bits in order with none lost.  The same events with refills at nextHalf, as the generator did before it read the
+// address, are run too to show that they tear halves.  Prints the events, late refills and stale halves of each
+// case; exits 1 on a failure.
+
+#include "RmtStream.h"
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#define  RMT_CHECK_ITEMS           2000000
+#define  RMT_BLOCK_ITEMS           64      // block_items in GenerateDCC_ESP32.cpp
+
+using GenerateDCC::RmtStream;
+using GenerateDCC::rmtBitItem;
+
+namespace {
+  // The generator's bits: each item in the model is tagged with the number of the bit it was filled with.
+  bool bitAt(long n){
+    uint32_t x=(uint32_t)n*2654435761u;
+    return (x>>15)&1;
+  }
+
+  struct Counts{
+    long events=0;                         // threshold events
+    long merged=0;                         // events that came while one was still pending
+    long late=0;                           // refills that found the hardware sending the half they were for again
+    long stale=0;                          // halves the hardware sent again
+    long torn=0;                           // halves sent with items from two refills
+    long wrong=0;                          // items that do not hold their bit
+    long gaps=0;                           // bits lost or out of order
+  };
+
+  // One channel: ring of 2 * halfItems items at item base of rmt memory.
+  Counts run(uint16_t blocks, uint8_t channel, bool atNextHalf, long items, uint32_t seed){
+    std::mt19937 rng(seed);
+    RmtStream stream{rmtBitItem(58), rmtBitItem(100), (uint16_t)(blocks*RMT_BLOCK_ITEMS/2)};
+    const uint16_t half=stream.halfItems, ring=2*half, base=channel*RMT_BLOCK_ITEMS;
+    std::vector<uint32_t> mem(ring);
+    std::vector<long> bitOf(ring), fillOf(ring);
+    long nextBit=0, fills=0;
+    uint16_t filling=0;                    // the item fillHalf writes next
+    auto generator=[&]{
+      bool bit=bitAt(nextBit);
+      bitOf[filling]=nextBit++;
+      fillOf[filling++]=fills;
+      return bit;
+    };
+    auto fill=[&](uint8_t h){
+      filling=h*half;
+      fills++;
+      stream.fillHalf(mem.data(), h, generator);
+    };
+    stream.nextHalf=0;                     // as setup() does
+    fill(0);
+    fill(1);
+
+    Counts c;
+    uint16_t at=0;                         // the item the hardware reads
+    bool pending=false;
+    long takenAt=0;                        // item count at which the pending event is taken
+    std::vector<long> lastFill(2, -1);     // of each half, the refill last sent
+    long passFill=0, expected=0;
+    bool stale=false, torn=false;
+    for(long sent=0;sent<items;sent++){
+      if(pending && sent>=takenAt){        // the interrupt: refill() less the timing
+        pending=false;
+        uint8_t h=atNextHalf ? stream.nextHalf : stream.idleHalf(base+at);
+        c.late+=at/half==stream.nextHalf;
+        fill(h);
+      }
+      if(at%half==0){                      // the hardware starts a half
+        passFill=fillOf[at];
+        stale=passFill==lastFill[at/half];
+        c.stale+=stale;
+        lastFill[at/half]=passFill;
+        torn=false;
+      }
+      if(fillOf[at]!=passFill && !torn){
+        c.torn++;
+        torn=true;
+      }
+      c.wrong+=mem[at]!=(bitAt(bitOf[at]) ? stream.oneItem : stream.zeroItem);
+      if(!stale){
+        c.gaps+=bitOf[at]!=expected;
+        expected=bitOf[at]+1;
+      }
+      at=(at+1)%ring;
+      if(at%half==0){                      // done with a half: the threshold event
+        c.events++;
+        if(pending){
+          c.merged++;
+          continue;
+        }
+        pending=true;
+        uint32_t r=rng()%1000;
+        long latency=r<980 ? rng()%4 : r<995 ? half+1+rng()%(half-2) : 2*half+rng()%(half-1);
+        takenAt=sent+1+latency;
+      }
+    }
+    return c;
+  }
+
+  bool check(bool ok, const char *what){
+    printf("  %-64s %s\n", what, ok ? "ok" : "FAILED");
+    return ok;
+  }
+
+  void show(const char *name, const Counts &c){
+    printf("  %-12s %8ld events, %6ld taken as one, %6ld late refills, %6ld stale halves, %6ld torn halves\n", name,
+      c.events, c.merged, c.late, c.stale, c.torn);
+  }
+}
+
+int main(int argc, char **argv){
+  long items=argc>1 ? atol(argv[1]) : RMT_CHECK_ITEMS;
+  bool ok=true;
+  for(uint16_t blocks : {1, 2}){
+    uint8_t channel=blocks==2 ? 6 : 3;     // memory that does not start at address 0
+    printf("%u memory block%s per channel, channel %u, %ld items:\n", blocks, blocks==1 ? "" : "s", channel, items);
+    Counts idle=run(blocks, channel, false, items, 1);
+    Counts next=run(blocks, channel, true, items, 1);
+    show("idle half", idle);
+    show("nextHalf", next);
+    ok&=check(idle.late>0 && idle.merged>0, "some refills came late and some events were taken as one");
+    ok&=check(idle.torn==0, "no half was torn by a refill while it was sent");
+    ok&=check(idle.wrong==0, "every item sent holds the item for its bit");
+    ok&=check(idle.gaps==0, "the bits sent, less stale halves, are the generator's in order");
+    ok&=check(next.torn>0, "refills at nextHalf would have torn halves");
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+/**********************************************************************
+
+SamplerCheck.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Checks of the background ADC sampler (see AnalogSampler.h) with synthetic samples, and of the baseline the ACK
+// detection takes before each verify (AckPoller in PacketRegister.cpp) against the sampler's running baseline.
+//
+//   sampler_check
+//
+// The ring: sample(n) must give back sample n while it is held, clamped to the oldest held or the newest taken
+// otherwise, across the wrap of the 8 bit count.  The pipeline: with the free running ADC converting the channel
+// selected two results before, as on the AVR, each ring must only ever get its own pin's samples, also when a pin
+// is registered while conversions run.  The baseline: at 9600 samples per second, as the programming track gets
+// on the AVR, the mean of ACK_BASE_COUNT samples must follow the idle current after a decoder's previous ACK pulse
+// and after a step in its idle current, where the running baseline still lags by a good part of
+// ACK_SAMPLE_THRESHOLD.  Prints each check and the figures of the last two; exits 1 on a failure.
+
+#include "AnalogSampler.h"
+#include "PacketRegister.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define  SAMPLES_PER_MS            9.6     // the programming track's share of the AVR's 19.2 kHz
+
+namespace {
+  bool check(bool ok, const char *what){
+    printf("%-72s %s\n", what, ok ? "ok" : "FAILED");
+    return ok;
+  }
+
+  // A pin's sample number i, tagged with the pin so that a sample in the wrong ring shows.
+  uint16_t tagged(uint8_t pin, long i){
+    return pin*1000+i%1000;
+  }
+
+  bool ring(){
+    bool ok=true;
+    SampleRing r;
+    r.reset();
+    ok&=check(r.baselineValue()==0 && r.sampleCount()==0, "an empty ring has no baseline and no samples");
+    bool held=true, clamped=true;
+    for(long i=0;i<1000;i++){
+      r.push(i);
+      uint8_t c=r.sampleCount();
+      held&=r.latest()==(uint16_t)i;
+      for(uint8_t age=1;age<ADC_RING_SIZE && age<=i+1;age++)
+        held&=r.at(c-age)==(uint16_t)(i+1-age);
+      if(i>=ADC_RING_SIZE){
+        clamped&=r.at(c)==(uint16_t)i;                         // not converted yet: the newest
+        clamped&=r.at(c-ADC_RING_SIZE)==(uint16_t)(i+2-ADC_RING_SIZE);   // about to be overwritten: the oldest safe
+      }
+    }
+    ok&=check(held, "sample(n) gives back the last 31 samples across the wrap of the count");
+    ok&=check(clamped, "a sample not taken yet or about to be overwritten is clamped");
+    return ok;
+  }
+
+  bool pipeline(){
+    AnalogSampler::nChannels=0;
+    AnalogSampler::registerPin(54);
+    AnalogSampler::registerPin(55);
+    // as begin() does: the first two conversions both use channel 0
+    uint8_t mux[2]={0, 0};
+    long taken[ADC_MAX_CHANNELS]={};
+    bool own=true;
+    for(long k=0;k<20000;k++){
+      if(k==10000)
+        AnalogSampler::registerPin(56);   // while conversions run
+      uint8_t ch=mux[0];
+      uint8_t before=AnalogSampler::sampleCount(ch);
+      uint8_t select=AnalogSampler::conversionDone(tagged(AnalogSampler::pins[ch]-54, taken[ch]));
+      own&=AnalogSampler::sampleCount(ch)==(uint8_t)(before+1)
+        && AnalogSampler::latest(ch)==tagged(AnalogSampler::pins[ch]-54, taken[ch]);
+      taken[ch]++;
+      mux[0]=mux[1];
+      mux[1]=select;
+    }
+    bool ok=true;
+    ok&=check(own, "each conversion lands in the ring of the pin it converted");
+    ok&=check(taken[2]>3000 && abs(taken[0]-taken[1])<=1,
+      "the channels take turns, and a pin registered while running gets its turn");
+    return ok;
+  }
+
+  // The baseline AckPoller takes: the mean of the next ACK_BASE_COUNT samples.
+  int meanBaseline(int8_t ch){
+    uint8_t next=AnalogSampler::sampleCount(ch);
+    for(int j=0;j<ACK_BASE_COUNT;j++)
+      AnalogSampler::feed(ch, AnalogSampler::latest(ch));   // the level holds while the baseline is taken
+    int32_t sum=0;
+    for(int j=0;j<ACK_BASE_COUNT;j++)
+      sum+=AnalogSampler::sample(ch, next++);
+    return sum/ACK_BASE_COUNT;
+  }
+
+  void level(int8_t ch, int value, double ms){
+    for(long i=0;i<ms*SAMPLES_PER_MS;i++)
+      AnalogSampler::feed(ch, value);
+  }
+
+  bool baseline(){
+    bool ok=true;
+    AnalogSampler::nChannels=0;
+    int8_t ch=AnalogSampler::registerPin(55);
+    level(ch, 100, 200);
+    ok&=check(AnalogSampler::baseline(ch)==100 && meanBaseline(ch)==100, "both baselines settle on a steady idle current");
+
+    // an ACK pulse of 60 counts for 6 ms, then the reset packets until the next verify takes its baseline
+    level(ch, 160, 6);
+    level(ch, 100, 16);
+    int running=AnalogSampler::baseline(ch)-100, mean=meanBaseline(ch)-100;
+    printf("  16 ms after a 6 ms ACK pulse of 60: running baseline %+d, mean of %d samples %+d\n", running, ACK_BASE_COUNT,
+      mean);
+    ok&=check(mean==0 && running>=ACK_SAMPLE_THRESHOLD/8, "after an ACK pulse the mean is at idle, the running baseline 1/8 up");
+
+    // the decoder's idle current steps up by 40, as when its lights come on
+    level(ch, 140, 20);
+    running=AnalogSampler::baseline(ch)-140;
+    mean=meanBaseline(ch)-140;
+    printf("  20 ms after the idle current steps up by 40: running baseline %+d, mean %+d\n", running, mean);
+    ok&=check(mean==0 && -running>=ACK_SAMPLE_THRESHOLD/4, "after a step the mean is at the new idle, the running baseline 1/4 off");
+    return ok;
+  }
+}
+
+int main(){
+  bool ok=true;
+  ok&=ring();
+  ok&=pipeline();
+  ok&=baseline();
+  return ok ? 0 : 1;
+}
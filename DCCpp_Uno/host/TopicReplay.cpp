@@ -0,0 +1,177 @@
+/**********************************************************************
+
+TopicReplay.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Replays one busy minute of the replies nobody asked for to interfaces subscribed to different topics (see
+// Topics.h and <U SUB>), and reports the bytes each gets and is spared.
+//
+//   topic_replay
+//
+// The minute: four cabs changing speed twice a second, twelve sensors flipping every five seconds, ten turnouts
+// thrown, the current of two boards every second and the power switched off and on once.  Every interface must
+// get exactly the replies of its topics, and what it was spared must be counted in FILTERED.  Prints the bytes
+// per interface; exits 1 on a failure.
+
+#include "DCCpp.h"
+#include "PacketRegister.h"
+#include "CommInterface.h"
+#include "SerialCommand.h"
+#include "Accessories.h"
+#include "Outputs.h"
+#include <stdarg.h>
+#include <string>
+
+volatile RegisterList mainRegs(MAX_MAIN_REGISTERS);
+volatile RegisterList progRegs(2);
+
+volatile RegisterList *SerialCommand::mRegs=&mainRegs;
+volatile RegisterList *SerialCommand::pRegs=&progRegs;
+
+HostSerial Serial;
+
+namespace {
+  unsigned long simulated;
+}
+
+int HostSerial::printf(const char *fmt, ...){
+  return 0;
+}
+
+unsigned long micros(){
+  return simulated+=10;
+}
+
+unsigned long millis(){
+  return simulated/1000;
+}
+
+void delay(unsigned long ms){
+  simulated+=ms*1000;
+}
+
+void delayMicroseconds(unsigned int us){
+  simulated+=us;
+}
+
+// <U SUB TOPIC ...>, as SerialCommand::parse passes it on.
+void SerialCommand::parse(const char *com){
+  if(com[0]=='U')
+    CommManager::option(com+1);
+}
+
+void SerialCommand::acknowledge(uint16_t id, uint16_t errors, unsigned long start){
+}
+
+void Turnout::parse(const CommandArgs &a){
+}
+
+void Output::parse(const CommandArgs &a){
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+  // Keeps what it is sent, taking all of it each time it is flushed.
+  struct ReplayInterface : CommInterface{
+    const char *name;
+    int takes=0;
+    std::string wire;
+    ReplayInterface(const char *name, const char *subscribe) : name(name){
+      pacing=PACE_NONE;
+      std::string command=std::string("<U SUB ")+subscribe+">";
+      for(char c : command)
+        receive(c);
+      drain();
+      wire.clear();
+    }
+    void process(){}
+    void showConfiguration(){}
+    void showInitInfo(){}
+    int txSpace(){ return takes; }
+    void send(const char *buf){ wire+=buf; }
+    void write(const uint8_t *buf, size_t len){ wire.append((const char *)buf, len); takes-=len; }
+    void drain(){
+      takes=1<<15;
+      flush();
+      takes=0;
+    }
+  };
+
+  bool check(bool ok, const char *what){
+    printf("%-64s %s\n", what, ok ? "ok" : "FAILED");
+    return ok;
+  }
+
+  // Bytes of each topic in the minute.
+  long bytesOf[8];
+
+  int bitOf(uint8_t topic){
+    int b=0;
+    while(topic>1){
+      topic>>=1;
+      b++;
+    }
+    return b;
+  }
+
+  void sent(const Reply &r){
+    CommManager::send(r);
+    bytesOf[bitOf(r.topic())]+=r.n;
+  }
+
+  void sent(const char *text){
+    CommManager::printf("%s", text);
+    bytesOf[bitOf(topicOf(text[1]))]+=strlen(text);
+  }
+}
+
+int main(){
+  bool ok=true;
+  ReplayInterface all("all", "ALL"), handset("handset", "THROTTLE"), panel("panel", "SENSORS TURNOUTS");
+  ReplayInterface *interfaces[]={&all, &handset, &panel};
+  for(ReplayInterface *i : interfaces)
+    CommManager::registerInterface(i);
+
+  for(int tenth=0;tenth<600;tenth++){     // tenths of a second
+    if(tenth%5==0)
+      for(int cab=1;cab<=4;cab++)
+        sent(Reply::throttle(cab*100+cab, (tenth/5*7+cab*13)%127, 1));
+    if(tenth%10==0){
+      sent(Reply::current(40+tenth%17, "MAIN"));
+      sent(Reply::current(3+tenth%5, "PROG"));
+    }
+    if(tenth%50<12)
+      sent(Reply::sensor(100+tenth%50, tenth/50%2==0));
+    if(tenth%60==30)
+      sent(Reply::turnout(10+tenth/60, tenth/60%2));
+    if(tenth==300)
+      sent("<p0>");
+    if(tenth==310)
+      sent("<p1>");
+    for(ReplayInterface *i : interfaces)
+      i->drain();
+  }
+
+  long total=0;
+  for(long b : bytesOf)
+    total+=b;
+  printf("%ld bytes of replies in the minute\n", total);
+  printf("%-10s %-20s %10s %10s %8s\n", "interface", "topics", "sent", "filtered", "saved");
+  for(ReplayInterface *i : interfaces){
+    long expected=0;
+    for(int b=0;b<8;b++)
+      if((1<<b)&(i->subscribed()|TOPIC_NONE))
+        expected+=bytesOf[b];
+    uint32_t filtered=i->counters().filtered;
+    printf("%-10s %-20u %10zu %10lu %7.0f%%\n", i->name, i->subscribed(), i->wire.size(), (unsigned long)filtered,
+      100.0*filtered/total);
+    char what[64];
+    snprintf(what, sizeof(what), "%s gets its topics, the rest is counted as filtered", i->name);
+    ok&=check((long)i->wire.size()==expected && (long)filtered==total-expected, what);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,214 @@
+/**********************************************************************
+
+TxRingCheck.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+// Checks that a reply reaches an interface whole or not at all (see TxRing.h and CommInterface::reply), against
+// interfaces whose transmit queue is full and that take bytes only when told to.
+//
+//   txring_check
+//
+// A reply printed in pieces, with the queue too full for all of it, must not leave its first pieces queued; with
+// room it must arrive as one reply.  An answer sent as binary frames to an interface that stops taking bytes must
+// take back the frames it queued when the last one times out.  A reply longer than the queue is dropped whole, a
+// newer status reply still replaces an older one, and the <X> of a failed command and the long lines of <J> go
+// only to the interface they answer, whole.  Prints each check; exits 1 on a failure.
+
+#include "DCCpp.h"
+#include "PacketRegister.h"
+#include "CommInterface.h"
+#include "SerialCommand.h"
+#include "Accessories.h"
+#include "Outputs.h"
+#include "GeneratorStats.h"
+#include <stdarg.h>
+#include <string>
+
+volatile RegisterList mainRegs(MAX_MAIN_REGISTERS);
+volatile RegisterList progRegs(2);
+
+volatile RegisterList *SerialCommand::mRegs=&mainRegs;
+volatile RegisterList *SerialCommand::pRegs=&progRegs;
+
+HostSerial Serial;
+
+namespace {
+  unsigned long simulated;                 // micros(), moved on by every call while nothing is taken
+}
+
+int HostSerial::printf(const char *fmt, ...){
+  return 0;
+}
+
+unsigned long micros(){
+  return simulated+=100;
+}
+
+unsigned long millis(){
+  return simulated/1000;
+}
+
+void delay(unsigned long ms){
+  simulated+=ms*1000;
+}
+
+void delayMicroseconds(unsigned int us){
+  simulated+=us;
+}
+
+// <J>: a histogram line printed in pieces, as GeneratorStats::show() did.  <w>: a command that fails.  <j>: the
+// counters of GeneratorStats, with every count as long as it gets.
+void SerialCommand::parse(const char *com){
+  if(com[0]=='w')
+    CommManager::reject();
+  if(com[0]=='j'){
+    GeneratorStats stats;
+    stats.reset();
+    for(uint32_t &b : stats.refillLateness.bins)
+      b=4000000000u;
+    stats.refillLateness.count=stats.refillLateness.max=stats.underruns=4000000000u;
+    stats.show("PROG");
+  }
+  if(com[0]!='J')
+    return;
+  CommManager::respond("<JL MAIN 100 20 0");
+  for(int i=0;i<16;i++)
+    CommManager::respond(" %d", 1000+i);
+  CommManager::respond(">");
+}
+
+void SerialCommand::acknowledge(uint16_t id, uint16_t errors, unsigned long start){
+}
+
+void Turnout::parse(const CommandArgs &a){
+}
+
+void Output::parse(const CommandArgs &a){
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+  // Takes up to takes bytes each time it is flushed, and keeps what it took.
+  struct CheckInterface : CommInterface{
+    int takes=0;
+    bool binary=false;
+    std::string wire;
+    CheckInterface(){ pacing=PACE_NONE; }
+    void process(){}
+    void showConfiguration(){}
+    void showInitInfo(){}
+    int txSpace(){ return takes; }
+    void send(const char *buf){ wire+=buf; }
+    void write(const uint8_t *buf, size_t len){ wire.append((const char *)buf, len); takes-=len; }
+    bool canSendBinary() const { return binary; }
+    void feed(const char *text){
+      while(*text)
+        receive(*text++);
+    }
+    void drain(){
+      takes=1<<15;
+      flush();
+      takes=0;
+    }
+  };
+
+  bool check(bool ok, const char *what){
+    printf("%-64s %s\n", what, ok ? "ok" : "FAILED");
+    return ok;
+  }
+
+  // Fills the empty queue of to with filler records until room bytes are left.
+  void fill(CheckInterface &to, uint16_t room){
+    char filler[TX_RECORD_MAX+1];
+    memset(filler, 'f', sizeof(filler)-1);
+    filler[sizeof(filler)-1]='\0';
+    for(uint16_t left=TX_RING_SIZE-room;left>0;){
+      uint16_t n=left>TX_RECORD_MAX+1 ? TX_RECORD_MAX : left-1;
+      to.reply(filler, n, 0);
+      left-=TxRing::recordBytes(n, false);
+    }
+  }
+
+  size_t count(const std::string &s, const char *what){
+    size_t n=0;
+    for(size_t at=s.find(what);at!=std::string::npos;at=s.find(what, at+1))
+      n++;
+    return n;
+  }
+}
+
+int main(){
+  bool ok=true;
+  CheckInterface a, b;
+  CommManager::registerInterface(&a);
+  CommManager::registerInterface(&b);
+
+  // A reply printed in pieces to both: a has room for its start only, b for all of it.
+  fill(a, 40);
+  CommManager::printf("<JP MAIN 100 20");
+  for(int i=0;i<16;i++)
+    CommManager::printf(" %d", 1000+i);
+  CommManager::printf(">");
+  a.drain();
+  b.drain();
+  ok&=check(a.wire.find("<JP")==std::string::npos, "pieces of a reply the queue has no room for are not queued");
+  ok&=check(count(b.wire, "<JP MAIN 100 20 1000 ")==1 && b.wire.back()=='>', "with room the pieces arrive as one reply");
+
+  // An answer in binary frames to an interface that stops taking bytes after its first frames are queued.
+  a.binary=true;
+  a.wire.clear();
+  a.feed("<U BIN 1>");
+  a.drain();
+  a.wire.clear();
+  fill(a, 60);
+  uint32_t dropped=a.counters().dropped;
+  a.binary=true;
+  a.feed("<J>");                           // waits TX_WAIT_MICROS, then times out
+  a.drain();
+  ok&=check(a.wire.find("JL")==std::string::npos && a.counters().dropped>dropped,
+    "frames of a timed out binary answer are taken back");
+  a.feed("<J>");                           // now the queue is empty
+  a.drain();
+  ok&=check(count(a.wire, "JL MAIN")==1, "the same answer with room arrives");
+  a.feed("<U BIN 0>");
+  a.drain();
+
+  // A reply longer than the queue holds.
+  std::string longer(TX_RING_SIZE+10, 'x');
+  longer[0]='<';
+  longer.back()='>';
+  a.wire.clear();
+  dropped=a.counters().dropped;
+  a.reply(longer.c_str(), longer.size(), 0);
+  a.drain();
+  ok&=check(a.wire.empty() && a.counters().dropped==dropped+longer.size(), "a reply longer than the queue is dropped whole");
+
+  // Status replies about the same cab.
+  a.wire.clear();
+  a.reply("<T 1 10 1>");
+  a.reply("<T 1 20 1>");
+  a.drain();
+  ok&=check(a.wire=="<T 1 20 1>", "a newer status reply replaces an older one");
+
+  // A command of b that fails.
+  a.wire.clear();
+  b.wire.clear();
+  b.feed("<w>");
+  a.drain();
+  b.drain();
+  ok&=check(b.wire=="<X>" && a.wire.empty(), "<X> goes only to the interface whose command failed");
+
+  // Generator counters of b, each line longer than the 128 bytes of PRINTF_MAX on the AVR.
+  b.wire.clear();
+  b.feed("<j>");
+  a.drain();
+  b.drain();
+  size_t jl=b.wire.find("<JL PROG ");
+  ok&=check(a.wire.empty() && jl==0 && b.wire.find('>')==b.wire.find("<JP")-1 && b.wire.back()=='>'
+    && count(b.wire, " 4000000000")==19, "the lines of <J> go whole to the interface that asked");
+  return ok ? 0 : 1;
+}
@@ -64,6 +64,7 @@ the directions of any Turnouts being monitored or controlled by a separate inter
 #include "SerialCommand.h"
 #include "DCCpp.h"
 #include "EEStore.h"
+#include "Journal.h"
 #include <EEPROM.h>
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -75,7 +76,8 @@ void Turnout::activate(int s){
   SerialCommand::parse(c);
   if(num>0)
     EEPROM.put(num,data.tStatus);
-  CommManager::printf("<H %d %d>", data.id, data.tStatus);
+  CommManager::send(Reply::turnout(data.id, data.tStatus));
+  Journal::record('H',data.id,data.tStatus);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -93,7 +95,7 @@ void Turnout::remove(int n){
   for(tt=firstTurnout;tt!=NULL && tt->data.id!=n;pp=tt,tt=tt->nextTurnout);
 
   if(tt==NULL){
-    CommManager::printf("<X>");
+    CommManager::reject();
     return;
   }
 
@@ -109,17 +111,19 @@ void Turnout::remove(int n){
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void Turnout::show(int n){
+void Turnout::show(int n, bool toSource){
   Turnout *tt;
 
   if(firstTurnout==NULL){
-    CommManager::printf("<X>");
+    CommManager::reject();
     return;
   }
 
   for(tt=firstTurnout;tt!=NULL;tt=tt->nextTurnout){
     if(n==1) {
       CommManager::printf("<H %d %d %d %d>", tt->data.id, tt->data.address, tt->data.subAddress, tt->data.tStatus);
+    } else if(toSource) {
+      CommManager::respond(Reply::turnout(tt->data.id, tt->data.tStatus));
     } else {
       CommManager::printf("<H %d %d>", tt->data.id, tt->data.tStatus);
     }
@@ -129,17 +133,34 @@ void Turnout::show(int n){
 ///////////////////////////////////////////////////////////////////////////////
 
 void Turnout::parse(const char *c){
-  int n,s,m;
+  CommandArgs a;
+
+  if(!a.parse(c,0,3)){
+    CommManager::reject();
+    return;
+  }
+  parse(a);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void Turnout::parse(const CommandArgs &a){
   Turnout *t;
 
-  switch(sscanf(c,"%d %d %d",&n,&s,&m)){
+  if((a.n>=1 && !a.inRange(0,0,32767)) || (a.n==2 && !a.inRange(1,0,1)) || (a.n==3 && (!a.inRange(1,0,511) || !a.inRange(2,0,3)))){
+    CommManager::reject();
+    return;
+  }
+  int n=a[0],s=a[1],m=a[2];
+
+  switch(a.n){
 
     case 2:                     // argument is string with id number of turnout followed by zero (not thrown) or one (thrown)
       t=get(n);
       if(t!=NULL)
         t->activate(s);
       else
-        CommManager::printf("<X>");
+        CommManager::reject();
       break;
 
     case 3:                     // argument is string with id number of turnout followed by an address and subAddress
@@ -150,7 +171,7 @@ void Turnout::parse(const char *c){
       remove(n);
     break;
 
-    case -1:                    // no arguments
+    case 0:                     // no arguments
       show(1);                  // verbose show
     break;
   }
@@ -206,7 +227,7 @@ Turnout *Turnout::create(int id, int add, int subAdd, int v){
 
   if(tt==NULL){       // problem allocating memory
     if(v==1)
-      CommManager::printf("<X>");
+      CommManager::reject();
     return(tt);
   }
 
@@ -8,6 +8,7 @@ Part of DCC++ BASE STATION for the Arduino
 **********************************************************************/
 
 #include "Arduino.h"
+#include "CommandArgs.h"
 
 #ifndef Accessories_h
 #define Accessories_h
@@ -26,12 +27,13 @@ struct Turnout{
   Turnout *nextTurnout;
   void activate(int s);
   static void parse(const char *c);
+  static void parse(const CommandArgs &a);
   static Turnout* get(int);
   static void remove(int);
   static void load();
   static void store();
   static Turnout *create(int, int, int, int=0);
-  static void show(int=0);
+  static void show(int=0, bool toSource=false);   // toSource: to the interface whose command runs only
 }; // Turnout
   
 #endif
@@ -0,0 +1,181 @@
+/**********************************************************************
+
+AnalogSampler.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "AnalogSampler.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SampleRing::reset(){
+  for(int i=0;i<ADC_RING_SIZE;i++)
+    samples[i]=0;
+  baseline=-1;                           // negative marks the baseline as unset; it is seeded from the first sample
+  count=0;
+} // SampleRing::reset
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SampleRing::push(uint16_t sample){
+  uint8_t c=count;
+  samples[c&(ADC_RING_SIZE-1)]=sample;
+  int32_t b=baseline;
+  if(b<0)
+    b=(int32_t)sample<<ADC_BASELINE_SHIFT;
+  else
+    b+=(int32_t)sample-(b>>ADC_BASELINE_SHIFT);
+  baseline=b;
+  count=c+1;                             // publish last, readers compare count before and after reading
+} // SampleRing::push
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint16_t SampleRing::latest() const{
+  return samples[(uint8_t)(count-1)&(ADC_RING_SIZE-1)];
+} // SampleRing::latest
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint16_t SampleRing::at(uint8_t n) const{
+  uint8_t c=count;
+  uint8_t age=c-n;
+  if(age==0 || age>ADC_RING_SIZE-1)      // not converted yet, or about to be overwritten by the sampler
+    n=(age==0) ? c-1 : c-(ADC_RING_SIZE-1);
+  return samples[n&(ADC_RING_SIZE-1)];
+} // SampleRing::at
+
+///////////////////////////////////////////////////////////////////////////////
+
+int SampleRing::baselineValue() const{
+  uint8_t c;
+  int32_t b;
+  do{                                    // retry if a sample was pushed while reading the (multi-byte) baseline
+    c=count;
+    b=baseline;
+  } while(c!=count);
+  return b<0 ? 0 : (int)(b>>ADC_BASELINE_SHIFT);
+} // SampleRing::baselineValue
+
+///////////////////////////////////////////////////////////////////////////////
+
+int8_t AnalogSampler::channelFor(int pin){
+  for(uint8_t i=0;i<nChannels;i++)
+    if(pins[i]==pin)
+      return i;
+  return -1;
+} // AnalogSampler::channelFor
+
+///////////////////////////////////////////////////////////////////////////////
+
+int8_t AnalogSampler::registerPin(int pin){
+  int8_t ch=channelFor(pin);
+  if(ch>=0 || nChannels>=ADC_MAX_CHANNELS)
+    return ch;
+  ch=nChannels;
+  pins[ch]=pin;
+  rings[ch].reset();
+  nChannels=ch+1;                        // the sampler picks up the new channel on its next pass
+  return ch;
+} // AnalogSampler::registerPin
+
+///////////////////////////////////////////////////////////////////////////////
+
+// In free-running mode the next conversion has already started (using the previously selected channel)
+// by the time a result is reported, so a newly selected channel only applies to the conversion after that one.
+// inFlight[] tracks which channel each of the two outstanding conversions belongs to.
+
+uint8_t AnalogSampler::conversionDone(uint16_t value){
+  uint8_t n=nChannels;
+  if(n==0)
+    return 0;
+  feed(inFlight[0],value);
+  inFlight[0]=inFlight[1];
+  uint8_t next=inFlight[1]+1;
+  if(next>=n)
+    next=0;
+  inFlight[1]=next;
+  return next;
+} // AnalogSampler::conversionDone
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(ARDUINO_ARCH_AVR)
+
+#include <Arduino.h>
+
+// Results arrive at 16 MHz / 64 prescale / 13 ADC clocks per conversion = 19.2 kHz, shared round-robin between the
+// registered pins.  With MAIN and PROG registered each gets ~9600 samples per second, about the rate the blocking
+// analogRead() loops in the ACK detection used to achieve.
+
+namespace {
+  inline void selectChannel(uint8_t ch){
+    uint8_t mux=AnalogSampler::pins[ch];
+    if(mux>=A0)
+      mux-=A0;
+    ADMUX=(1<<REFS0)|(mux&0x07);         // AVcc reference, same as analogRead() with the DEFAULT reference
+  #ifdef MUX5
+    ADCSRB=(mux&0x08) ? (1<<MUX5) : 0;   // Mega: A8-A15.  Also keeps ADTS=0 (free running)
+  #else
+    ADCSRB=0;
+  #endif
+  }
+}
+
+void AnalogSampler::begin(){
+  if(nChannels==0)
+    return;
+  inFlight[0]=0;
+  inFlight[1]=0;
+  selectChannel(0);
+  ADCSRA=(1<<ADEN)|(1<<ADSC)|(1<<ADATE)|(1<<ADIE)|(1<<ADPS2)|(1<<ADPS1);    // enable, start, free running, interrupt, prescale=64
+} // AnalogSampler::begin
+
+ISR(ADC_vect){
+  selectChannel(AnalogSampler::conversionDone(ADC));
+}
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#include <Arduino.h>
+
+// The ESP32 core only offers DMA sampling (through I2S0) for a single ADC1 channel, so instead a small task
+// keeps converting round-robin and hands the results to the same rings.  It sleeps one tick every
+// ADC_TASK_BURST passes to let the idle task and the lower priority work on this core run.
+
+#define ADC_TASK_BURST  16
+
+namespace {
+  void samplerTask(void*){
+    while(1){
+      for(int r=0;r<ADC_TASK_BURST;r++){
+        uint8_t n=AnalogSampler::nChannels;
+        for(uint8_t ch=0;ch<n;ch++)
+          AnalogSampler::feed(ch,analogRead(AnalogSampler::pins[ch]));
+      }
+      vTaskDelay(1);
+    }
+  }
+}
+
+void AnalogSampler::begin(){
+  auto err=xTaskCreate(&samplerTask, "ADCSAMPLE", 2048, nullptr, 1, nullptr);
+  if(err!=pdPASS) Serial.printf("Failed to start adc sampler: %d\n", err);
+} // AnalogSampler::begin
+
+#else
+
+void AnalogSampler::begin(){
+  // host builds push samples with feed() or conversionDone()
+} // AnalogSampler::begin
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+SampleRing AnalogSampler::rings[ADC_MAX_CHANNELS];
+int AnalogSampler::pins[ADC_MAX_CHANNELS];
+volatile uint8_t AnalogSampler::nChannels=0;
+uint8_t AnalogSampler::inFlight[2]={0,0};
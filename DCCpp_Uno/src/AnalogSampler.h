@@ -0,0 +1,55 @@
+/**********************************************************************
+
+AnalogSampler.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef AnalogSampler_h
+#define AnalogSampler_h
+
+#include <stdint.h>
+
+// The background sampler keeps the ADC converting all the time and stores the results in a small ring
+// buffer per registered analog pin.  Current monitoring and ACK detection then read samples from memory
+// instead of waiting ~100 microseconds for a blocking analogRead().  Nothing in this header depends on
+// the Arduino core, so the ring and channel sequencing can be driven with synthetic samples in a host build.
+
+#ifdef ARDUINO_ARCH_ESP32
+  #define  ADC_MAX_CHANNELS        8       // maximum number of analog pins the sampler cycles through, one per track output
+#else
+  #define  ADC_MAX_CHANNELS        4       // maximum number of analog pins the sampler cycles through
+#endif
+#define  ADC_RING_SIZE             32      // samples kept per channel (must be a power of two, at most 128)
+#define  ADC_BASELINE_SHIFT        8       // the running baseline moves 1/2^ADC_BASELINE_SHIFT of the way towards each new sample
+
+struct SampleRing{
+  volatile uint16_t samples[ADC_RING_SIZE];
+  volatile int32_t baseline;               // running baseline, scaled by 2^ADC_BASELINE_SHIFT
+  volatile uint8_t count;                  // number of samples pushed so far (wraps), written last so readers can detect a concurrent push
+  void reset();
+  void push(uint16_t sample);
+  uint8_t sampleCount() const { return count; }
+  uint16_t latest() const;
+  uint16_t at(uint8_t n) const;            // sample number n as counted by sampleCount(), clamped to the oldest sample still held
+  int baselineValue() const;
+}; // SampleRing
+
+struct AnalogSampler{
+  static SampleRing rings[ADC_MAX_CHANNELS];
+  static int pins[ADC_MAX_CHANNELS];
+  static volatile uint8_t nChannels;
+  static uint8_t inFlight[2];              // channels of the conversion completing now and of the one already started
+  static int8_t registerPin(int pin);      // returns the channel used for pin (registering it if needed), or -1 if all channels are taken
+  static int8_t channelFor(int pin);
+  static void begin();                     // starts background conversions on the registered pins
+  static uint8_t conversionDone(uint16_t value);  // stores one result and returns the channel to select for the conversion after the one in flight
+  static void feed(uint8_t channel, uint16_t value) { rings[channel].push(value); }
+  static uint16_t latest(int8_t channel) { return channel < 0 ? 0 : rings[channel].latest(); }
+  static int baseline(int8_t channel) { return channel < 0 ? 0 : rings[channel].baselineValue(); }
+  static uint8_t sampleCount(int8_t channel) { return channel < 0 ? 0 : rings[channel].sampleCount(); }
+  static uint16_t sample(int8_t channel, uint8_t n) { return channel < 0 ? 0 : rings[channel].at(n); }
+}; // AnalogSampler
+
+#endif
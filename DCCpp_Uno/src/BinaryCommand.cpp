@@ -0,0 +1,231 @@
+/**********************************************************************
+
+BinaryCommand.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include <string.h>
+#include "BinaryCommand.h"
+#include "SerialCommand.h"
+#include "Accessories.h"
+#include "Outputs.h"
+#include "CommInterface.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint16_t BinaryCommand::crc16(uint16_t crc, uint8_t b){
+  crc^=(uint16_t)b<<8;
+  for(uint8_t i=0;i<8;i++)
+    crc=(crc&0x8000) ? (crc<<1)^0x1021 : crc<<1;
+  return crc;
+} // BinaryCommand::crc16
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint8_t BinaryCommand::frame(uint8_t *out, uint8_t op, const uint8_t *payload, uint8_t n){
+  uint8_t len=n+1;
+  out[0]=BIN_SYNC;
+  out[1]=len;
+  out[2]=op;
+  memcpy(out+3,payload,n);
+  uint16_t crc=0xFFFF;
+  for(uint8_t i=1;i<len+2;i++)
+    crc=crc16(crc,out[i]);
+  out[len+2]=(uint8_t)crc;
+  out[len+3]=(uint8_t)(crc>>8);
+  return len+4;
+} // BinaryCommand::frame
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Field layouts of numeric frames: b = 8 bits, c = 8 bits signed, w = 16 bits, s = 16 bits signed, upper case = optional.
+// Replies without a layout are sent as all s fields.
+
+namespace {
+  struct Layout{
+    char letter;
+    const char *fields;
+  };
+
+  const Layout commandLayouts[]={
+    {'t', "bwcb"},              // REGISTER CAB SPEED DIRECTION
+    {'f', "wbB"},               // CAB BYTE1 [BYTE2]
+    {'a', "wbb"},               // ADDRESS SUBADDRESS ACTIVATE
+    {'T', "wb"},                // ID THROW
+    {'Z', "wb"},                // ID ACTIVATE
+    {'w', "wwb"},               // CAB CV VALUE
+  };
+
+  const Layout replyLayouts[]={
+    {'T', "wcb"},               // CAB SPEED DIRECTION
+    {'H', "wb"},                // ID THROW
+    {'Y', "wb"},                // ID ACTIVATE
+    {'Q', "w"},                 // ID
+    {'q', "w"},                 // ID
+    {'p', "b"},                 // POWER
+    {'#', "wbw"},               // ID OK MICROS, commands that took longer than 65535us are acknowledged as text
+  };
+
+  template<size_t n> const char *layoutFor(const Layout (&layouts)[n], uint8_t letter){
+    for(size_t i=0;i<n;i++)
+      if(layouts[i].letter==letter)
+        return layouts[i].fields;
+    return NULL;
+  }
+
+  inline uint8_t width(char f){ return (f|0x20)=='w' || (f|0x20)=='s' ? 2 : 1; }
+  inline bool isSigned(char f){ return (f|0x20)=='c' || (f|0x20)=='s'; }
+  inline bool isOptional(char f){ return f>='A' && f<='Z'; }
+}
+
+bool BinaryCommand::decode(const char *f, const uint8_t *payload, uint8_t n, CommandArgs &a){
+  a.n=0;
+  for(;*f && a.n<COMMAND_MAX_ARGS;f++){
+    if(n==0 && isOptional(*f))
+      break;                              // optional fields left out
+    if(n<width(*f))
+      return false;
+    if(width(*f)==2)
+      a.v[a.n++]=isSigned(*f) ? (int16_t)(payload[0] | payload[1]<<8) : (int32_t)(payload[0] | (uint16_t)payload[1]<<8);
+    else
+      a.v[a.n++]=isSigned(*f) ? (int8_t)payload[0] : payload[0];
+    payload+=width(*f);
+    n-=width(*f);
+  }
+  return n==0;
+} // BinaryCommand::decode
+
+///////////////////////////////////////////////////////////////////////////////
+
+int BinaryCommand::encode(const char *f, const CommandArgs &a, uint8_t *payload){
+  uint8_t n=0;
+  for(uint8_t i=0;i<a.n;i++){
+    char t=f ? f[i] : 's';
+    if(t=='\0')
+      return -1;                          // more numbers than fields
+    bool fits=width(t)==2 ? (isSigned(t) ? a.inRange(i,-32768,32767) : a.inRange(i,0,65535))
+                          : (isSigned(t) ? a.inRange(i,-128,127) : a.inRange(i,0,255));
+    if(!fits)
+      return -1;
+    payload[n++]=(uint8_t)a.v[i];
+    if(width(t)==2)
+      payload[n++]=(uint8_t)(a.v[i]>>8);
+  }
+  if(f && f[a.n]!='\0' && !isOptional(f[a.n]))
+    return -1;                            // fewer numbers than fields
+  return n;
+} // BinaryCommand::encode
+
+///////////////////////////////////////////////////////////////////////////////
+
+void BinaryCommand::execute(const uint8_t *body, uint8_t len){
+  uint8_t op=body[0];
+
+  if(op==BIN_TEXT){
+    char com[BIN_MAX_PAYLOAD+1];
+    memcpy(com,body+1,len-1);
+    com[len-1]='\0';
+    SerialCommand::parse(com);
+    return;
+  }
+
+  if(op==('#'|BIN_NUMERIC) && len>=4){   // ID(16) then a complete OP and PAYLOAD
+    uint16_t errors=CommManager::errorCount();
+    unsigned long start=micros();
+    execute(body+3,len-3);
+    SerialCommand::acknowledge(body[1] | body[2]<<8,errors,start);
+    return;
+  }
+
+  CommandArgs a;
+  const char *f=layoutFor(commandLayouts,op&~BIN_NUMERIC);
+  if(!(op&BIN_NUMERIC) || f==NULL || !decode(f,body+1,len-1,a)){
+    CommManager::reject();
+    return;
+  }
+  run(op&~BIN_NUMERIC,a);
+} // BinaryCommand::execute
+
+///////////////////////////////////////////////////////////////////////////////
+
+void BinaryCommand::run(char letter, const CommandArgs &a){
+  switch(letter){
+    case 't':
+      SerialCommand::mRegs->setThrottle(a);
+      break;
+    case 'f':
+      SerialCommand::mRegs->setFunction(a);
+      break;
+    case 'a':
+      SerialCommand::mRegs->setAccessory(a);
+      break;
+    case 'T':
+      Turnout::parse(a);
+      break;
+    case 'Z':
+      Output::parse(a);
+      break;
+    case 'w':
+      SerialCommand::mRegs->writeCVByteMain(a);
+      break;
+    default:
+      CommManager::reject();
+  }
+} // BinaryCommand::run
+
+///////////////////////////////////////////////////////////////////////////////
+
+BinaryFrameReader::Result BinaryFrameReader::feed(uint8_t ch){
+  switch(state){
+    case IDLE:
+      if(ch!=BIN_SYNC)
+        return NONE;
+      state=LENGTH;
+      return BUSY;
+    case LENGTH:
+      if(ch==0 || ch>BIN_MAX_PAYLOAD+1){
+        state=IDLE;                       // not a frame after all, drop it
+        return BUSY;
+      }
+      len=ch;
+      got=0;
+      crc=BinaryCommand::crc16(0xFFFF,ch);
+      state=BODY;
+      return BUSY;
+    case BODY:
+      body[got++]=ch;
+      crc=BinaryCommand::crc16(crc,ch);
+      if(got==len)
+        state=CRC_LOW;
+      return BUSY;
+    case CRC_LOW:
+      crc^=ch;                            // the low byte cancels out if it matches
+      state=CRC_HIGH;
+      return BUSY;
+    default:
+      state=IDLE;
+      return crc==((uint16_t)ch<<8) ? FRAME : BUSY;
+  }
+} // BinaryFrameReader::feed
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint8_t BinaryReplyEncoder::flush(uint8_t *frame, bool done){
+  uint8_t count=n;
+  n=0;
+  if(done && !split && count>=3){         // try to send <L N1 N2 ...> as numbers
+    char args[BIN_MAX_PAYLOAD];
+    memcpy(args,text+2,count-3);
+    args[count-3]='\0';
+    CommandArgs a;
+    uint8_t payload[BIN_MAX_PAYLOAD];
+    int size=-1;
+    if(text[1]!=' ' && a.parse(args,0,BIN_MAX_PAYLOAD/2))
+      size=BinaryCommand::encode(layoutFor(replyLayouts,text[1]),a,payload);
+    if(size>=0)
+      return BinaryCommand::frame(frame,text[1]|BIN_NUMERIC,payload,size);
+  }
+  return BinaryCommand::frame(frame,BIN_TEXT,(const uint8_t *)text,count);
+} // BinaryReplyEncoder::flush
@@ -0,0 +1,119 @@
+/**********************************************************************
+
+BinaryCommand.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef BinaryCommand_h
+#define BinaryCommand_h
+
+#include <stdint.h>
+#include "CommandArgs.h"
+
+// A compact binary framing of the text protocol, for links that are short of bandwidth (the 115200 baud
+// serial link to an ESP8266, or a busy WiFi throttle).  Every interface accepts binary frames at any time,
+// mixed freely with text commands.  Replies stay text until a client asks for binary replies on its
+// interface with <U BIN 1> (see SerialCommand.cpp).
+//
+// A frame is
+//
+//    SYNC  LEN  OP  PAYLOAD  CRC
+//
+//    SYNC:    0xA5, which never occurs in the text protocol; bytes outside a frame that are not text commands are ignored
+//    LEN:     number of bytes in OP and PAYLOAD, 1 through BIN_MAX_PAYLOAD+1
+//    OP:      0 for a text frame, otherwise a command (or reply) letter plus 0x80 for a frame of numeric fields
+//    PAYLOAD: LEN-1 bytes
+//    CRC:     CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF) of LEN, OP and PAYLOAD, low byte first
+//
+// Commands:
+//
+//    OP 0:         PAYLOAD is a text command without the < and >, for example "s" or "U BIN 0"
+//    OP 't'+0x80:  REGISTER(8) CAB(16) SPEED(8, signed) DIRECTION(8)
+//    OP 'f'+0x80:  CAB(16) BYTE1(8) [BYTE2(8)]
+//    OP 'a'+0x80:  ADDRESS(16) SUBADDRESS(8) ACTIVATE(8)
+//    OP 'T'+0x80:  ID(16) THROW(8)
+//    OP 'Z'+0x80:  ID(16) ACTIVATE(8)
+//    OP 'w'+0x80:  CAB(16) CV(16) VALUE(8)
+//    OP '#'+0x80:  ID(16) followed by the OP and PAYLOAD of another command frame, the binary form of <#ID COMMAND>
+//
+// with 16 bit fields sent low byte first.  These run exactly as the text command with the same letter would.
+//
+// Replies:
+//
+//    OP 0:         PAYLOAD is text of the reply, including the < and >.  Replies longer than BIN_MAX_PAYLOAD are split
+//                  over several text frames
+//    OP letter+0x80: the reply <letter N1 N2 ...> with every Ni a number.  These replies have fixed fields
+//
+//                  <T CAB(16) SPEED(8, signed) DIRECTION(8)>  <H ID(16) THROW(8)>  <Y ID(16) ACTIVATE(8)>
+//                  <Q ID(16)>  <q ID(16)>  <p POWER(8)>  <# ID(16) OK(8) MICROS(16)>
+//
+//                  so that <T 1234 126 1> is sent as A5 05 D4 D2 04 7E 01 CRC CRC.  Any other reply whose numbers all lie
+//                  from -32768 to 32767 is sent as one signed 16 bit field per number, everything else as text.
+//
+// Anything a reply prints outside of < and > (line breaks) is dropped in binary mode.
+
+#define  BIN_SYNC                  0xA5
+#define  BIN_MAX_PAYLOAD           24
+#define  BIN_TEXT                  0x00
+#define  BIN_NUMERIC               0x80
+#define  BIN_MAX_FRAME             (BIN_MAX_PAYLOAD+5)     // SYNC LEN OP PAYLOAD CRC
+
+struct BinaryFrameReader{
+  enum Result{ NONE, BUSY, FRAME };       // ch was not part of a frame, ch was taken by a frame, ch completed a valid frame
+  enum State{ IDLE, LENGTH, BODY, CRC_LOW, CRC_HIGH };
+  uint8_t body[BIN_MAX_PAYLOAD+1];        // OP then PAYLOAD of the frame being read, or of the last frame once feed() returns FRAME
+  uint8_t len;                            // LEN of that frame
+  uint8_t got;                            // bytes of body received so far
+  uint8_t state;
+  uint16_t crc;
+  BinaryFrameReader() : len(0), got(0), state(IDLE), crc(0) {}
+  Result feed(uint8_t ch);
+}; // BinaryFrameReader
+
+struct BinaryReplyEncoder{
+  char text[BIN_MAX_PAYLOAD];             // the reply being collected, from its <
+  uint8_t n;                              // characters in text
+  bool inReply;                           // inside < >
+  bool split;                             // part of this reply has already been sent as a text frame
+  BinaryReplyEncoder() : n(0), inReply(false), split(false) {}
+  template<class Write> void put(const char *s, Write &&write);   // write(const uint8_t *frame, uint8_t len) is called once per frame
+private:
+  uint8_t flush(uint8_t *frame, bool done);   // builds the frame for the collected text, returns its length
+}; // BinaryReplyEncoder
+
+struct BinaryCommand{
+  static uint16_t crc16(uint16_t crc, uint8_t b);
+  static uint8_t frame(uint8_t *out, uint8_t op, const uint8_t *payload, uint8_t n);   // returns the frame length
+  static bool decode(const char *fields, const uint8_t *payload, uint8_t n, CommandArgs &a);
+  static int encode(const char *fields, const CommandArgs &a, uint8_t *payload);  // returns the payload length, or -1 if a does not fit fields
+  static void execute(const uint8_t *body, uint8_t len);  // runs a frame received by BinaryFrameReader
+  static void run(char letter, const CommandArgs &a);     // runs numeric command t, f, a, T, Z or w with its arguments already read
+}; // BinaryCommand
+
+///////////////////////////////////////////////////////////////////////////////
+
+template<class Write> void BinaryReplyEncoder::put(const char *s, Write &&write){
+  uint8_t frame[BIN_MAX_FRAME];
+  for(;*s;s++){
+    if(!inReply){
+      if(*s!='<')
+        continue;
+      inReply=true;
+      split=false;
+      n=0;
+    }
+    if(n==sizeof(text)){
+      write(frame,flush(frame,false));
+      split=true;
+    }
+    text[n++]=*s;
+    if(*s=='>'){
+      write(frame,flush(frame,true));
+      inReply=false;
+    }
+  }
+} // BinaryReplyEncoder::put
+
+#endif
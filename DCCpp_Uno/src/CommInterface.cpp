@@ -7,20 +7,231 @@
 
 #include <Arduino.h>
 #include "CommInterface.h"
+#include "SerialCommand.h"
+#include "CommandArgs.h"
 
 CommInterface *CommManager::interfaces[10] = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
 int CommManager::nextInterface = 0;
+int CommManager::first = 0;
+unsigned long CommManager::passStart = 0;
+uint32_t CommManager::overruns = 0;
+CommInterface *CommManager::source = NULL;
+uint16_t CommManager::errors = 0;
 
 CommInterface::~CommInterface() {
 
 }
 
+namespace {
+	// A reply that a newer one about the same thing makes up for, <T CAB SPEED DIRECTION>, <H ID THROW>, <Y ID STATE>,
+	// <Q ID>, <q ID> or <a CURRENT>, gets a key from its letter and first number.  Everything else gets 0.
+	uint32_t statusKey(const char *buf) {
+		char args[24];
+		size_t n = strlen(buf);
+		if(n < 5 || n > sizeof(args) + 2 || buf[0] != '<' || buf[2] != ' ' || buf[n - 1] != '>') {
+			return 0;
+		}
+		memcpy(args, buf + 2, n - 3);
+		args[n - 3] = '\0';
+		CommandArgs a;
+		if(!a.parse(args, 1, 3)) {
+			return 0;
+		}
+		switch(buf[1]) {
+		case 'T':
+			return a.n == 3 ? (uint32_t)'T' << 16 | (uint16_t)a[0] : 0;
+		case 'H':
+		case 'Y':
+			return a.n == 2 ? (uint32_t)buf[1] << 16 | (uint16_t)a[0] : 0;
+		case 'Q':
+		case 'q':
+			return a.n == 1 ? (uint32_t)'Q' << 16 | (uint16_t)a[0] : 0;
+		case 'a':
+			return a.n == 1 ? (uint32_t)'a' << 16 : 0;
+		}
+		return 0;
+	}
+}
+
+// Queues a reply, re-framed as binary if the client asked for binary replies on this interface.  Status replies
+// replace older ones about the same thing that are still queued.  An answer to a command that came in on this
+// interface waits for space while the interface takes what is queued, and is dropped only if the interface takes
+// nothing for TX_WAIT_MICROS (see queue()).  A reply nobody here asked for does not wait: if there is no space for
+// it even after handing the interface what it takes now, it is dropped.  While the interface is not up (see txUp())
+// every reply is dropped at once.  Either way a reply goes whole or not at all: one longer than the queue holds is
+// dropped, and the frames of a binary reply already queued are taken back when a later one is dropped.
+void CommInterface::reply(const char *buf) {
+	reply(buf, strlen(buf), statusKey(buf));
+}
+
+void CommInterface::reply(const char *buf, uint16_t n, uint32_t key) {
+	uint16_t need = binaryReplies ? n + 5 * (n / BIN_MAX_PAYLOAD + 1) : n;    // framing adds at most 5 bytes per frame
+	uint16_t bytes = TxRing::recordBytes(need, key != 0);
+	bool room = txUp() && bytes <= TX_RING_SIZE;
+	if(room && CommManager::source != this) {
+		if(txRing.space() < bytes) {
+			flush();
+		}
+		room = txRing.space() >= bytes;
+	}
+	if(!room) {
+		txRing.counters.dropped += n;
+		if(binaryReplies) {
+			replyEncoder.put(buf, [](const uint8_t *, uint8_t) {});
+		}
+		return;
+	}
+	TxMark start = txRing.mark();
+	bool queued = true;
+	if(binaryReplies) {
+		replyEncoder.put(buf, [&](const uint8_t *frame, uint8_t len) { queued = queued && queue(frame, len, key); });
+	} else {
+		queued = queue((const uint8_t *)buf, n, key);
+	}
+	if(!queued) {
+		txRing.unpush(start);          // cannot fail: the interface took nothing while the last frame waited
+		txRing.counters.dropped += n;
+	}
+}
+
+// Sends a reply nobody on this interface asked for, if the interface subscribed to its topic.
+void CommInterface::publish(const char *buf, uint8_t topic) {
+	if(topic != TOPIC_NONE && !(topics & topic)) {
+		txRing.counters.filtered += strlen(buf);
+		return;
+	}
+	reply(buf);
+}
+
+void CommInterface::publish(const Reply &r) {
+	if(!(topics & r.topic())) {
+		txRing.counters.filtered += r.n;
+		return;
+	}
+	reply(r);
+}
+
+// Pushes n bytes, handing the interface queued bytes while there is no space for them.  False if the interface
+// took nothing for TX_WAIT_MICROS.
+bool CommInterface::queue(const uint8_t *data, uint16_t n, uint32_t key) {
+	unsigned long start = micros();
+	while(!txRing.push(data, n, key)) {
+		if(micros() - start > TX_WAIT_MICROS) {
+			return false;
+		}
+		uint32_t sent = txRing.counters.sent;
+		flush();
+		if(txRing.counters.sent != sent) {
+			start = micros();                // waits again only if the interface stops taking bytes
+		}
+	}
+	return true;
+}
+
+// Hands queued bytes to the interface, as many as it takes without blocking.
+void CommInterface::flush() {
+	int budget = txSpace();
+	if(budget > 0) {
+		txRing.drain(budget, [this](const uint8_t *data, uint16_t n) { write(data, n); });
+	}
+}
+
+void CommInterface::setBinaryReplies(bool on) {
+	binaryReplies = on && canSendBinary();
+}
+
+// Offers a received character to the binary frame reader, then to the text frame assembler, and runs the command
+// it completes.  Returns true if ch completed a command.
+bool CommInterface::receive(char ch, CommandReader &from) {
+	BinaryFrameReader::Result r = from.binary.feed(ch);
+	if(r == BinaryFrameReader::FRAME) {
+		charge(from);
+		CommManager::source = this;
+		BinaryCommand::execute(from.binary.body, from.binary.len);
+		answered();
+		CommManager::source = NULL;
+		return true;
+	}
+	if(r != BinaryFrameReader::NONE) {
+		return false;
+	}
+	switch(from.text.feed(ch)) {
+	case FrameAssembler::COMMAND:
+		charge(from);
+		command(from.text.text);
+		CommManager::source = this;
+		answered();
+		CommManager::source = NULL;
+		return true;
+	case FrameAssembler::TOO_LONG:
+		CommManager::source = this;
+		CommManager::fail();
+		CommManager::respond("<X>");
+		answered();
+		CommManager::source = NULL;
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool CommInterface::mayReceive(CommandReader &from) {
+	if(pacing == PACE_NONE) {
+		return true;
+	}
+	if(!CommManager::inBudget()) {
+		return false;
+	}
+	unsigned long now = micros();
+	if(limit.ready(now) && (pacing == PACE_INTERFACE || from.limit.ready(now))) {
+		return true;
+	}
+	deferred++;
+	return false;
+}
+
+void CommInterface::command(const char *com) {
+	CommManager::source = this;
+	SerialCommand::parse(com);
+	CommManager::source = NULL;
+}
+
+// Runs a numeric command whose arguments are already known (see BinaryCommand::run), for interfaces that get
+// commands as calls rather than as characters.
+void CommInterface::command(char letter, const CommandArgs &a) {
+	charge(reader);
+	CommManager::source = this;
+	BinaryCommand::run(letter, a);
+	CommManager::source = NULL;
+}
+
+void CommInterface::charge(CommandReader &from) {
+	limit.take();
+	from.limit.take();
+	commands++;
+}
+
+// Lets each interface read and run commands, starting with a different one each pass so that when the pass runs
+// out of time (COMM_UPDATE_MICROS) the same interface is not always the one left waiting.
 void CommManager::update() {
-	for(int i = 0; i < nextInterface; i++) {
-		if(interfaces[i] != NULL) {
-			interfaces[i]->process();
+	passStart = micros();
+	for(int n = 0; n < nextInterface; n++) {
+		CommInterface *interface = interfaces[(first + n) % nextInterface];
+		if(interface != NULL) {
+			interface->process();
+			interface->flush();
 		}
 	}
+	if(!inBudget()) {
+		overruns++;
+	}
+	if(nextInterface > 0) {
+		first = (first + 1) % nextInterface;
+	}
+}
+
+bool CommManager::inBudget() {
+	return micros() - passStart < COMM_UPDATE_MICROS;
 }
 
 void CommManager::registerInterface(CommInterface *interface) {
@@ -46,14 +257,138 @@ void CommManager::showInitInfo() {
 }
 
 void CommManager::printf(const char *fmt, ...) {
-	char buf[256] = {0};
 	va_list args;
 	va_start(args, fmt);
-	vsnprintf(buf, sizeof(buf), fmt, args);
+	vsend(NULL, fmt, args);
 	va_end(args);
+}
+
+// Like printf, but only to the interface whose command is running (to all of them if the command did not come from one).
+void CommManager::respond(const char *fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	vsend(source, fmt, args);
+	va_end(args);
+}
+
+void CommManager::reject() {
+	fail();
+	respond("<X>");
+}
+
+// Sends a reply built with Reply (see Reply.h): to the interface whose command is running, and to the others that
+// subscribed to its topic.
+void CommManager::send(const Reply &r) {
+	for(int i = 0; i < nextInterface; i++) {
+		if(interfaces[i] == NULL) {
+			continue;
+		}
+		if(interfaces[i] == source) {
+			interfaces[i]->reply(r);
+		} else {
+			interfaces[i]->publish(r);
+		}
+	}
+}
+
+// Sends a reply built with Reply only to the interface whose command is running (like send() if there is none).
+void CommManager::respond(const Reply &r) {
+	if(source != NULL) {
+		source->reply(r);
+	} else {
+		send(r);
+	}
+}
+
+// A reply printed in pieces, such as <*REG: BYTES / REPEAT> (see RegisterList::printPacket), is gathered until the
+// piece that ends it with '>' and then sent whole, so that each interface gets all of it or none.  Like a reply
+// printed at once, it is cut at PRINTF_MAX.
+void CommManager::vsend(CommInterface *to, const char *fmt, va_list args) {
+	static char buf[PRINTF_MAX];
+	static uint16_t length = 0;              // of a reply whose pieces are being gathered
+	static CommInterface *gatheredFor;
+	if(length > 0 && to != gatheredFor) {    // left open, send what there is of it
+		dispatch(gatheredFor, buf);
+		length = 0;
+	}
+	va_list again;
+	va_copy(again, args);
+	int n = vsnprintf(buf + length, sizeof(buf) - length, fmt, args);
+	if(length > 0 && n > 0 && buf[length] == '<') {   // the next reply starts before the last one ended
+		buf[length] = '\0';
+		dispatch(gatheredFor, buf);
+		length = 0;
+		n = vsnprintf(buf, sizeof(buf), fmt, again);
+	}
+	va_end(again);
+	if(n < 0) {
+		buf[length] = '\0';
+		return;
+	}
+	bool cut = length + n >= (int)sizeof(buf);
+	size_t end = cut ? sizeof(buf) - 1 : length + n;
+	if(buf[0] == '<' && !(cut ? fmt[strlen(fmt) - 1] == '>' : buf[end - 1] == '>')) {
+		length = end;                      // not ended yet
+		gatheredFor = to;
+		return;
+	}
+	length = 0;
+	dispatch(to, buf);
+}
+
+// Sends a reply to the interface to, or to every interface if to is NULL: to the interface whose command is running
+// as an answer, to the others if they subscribed to its topic.
+void CommManager::dispatch(CommInterface *to, const char *buf) {
+	uint8_t topic = buf[0] == '<' ? topicOf(buf[1]) : TOPIC_NONE;
+	for(int i = 0; i < nextInterface; i++) {
+		if(interfaces[i] == NULL || (to != NULL && interfaces[i] != to)) {
+			continue;
+		}
+		if(to != NULL || interfaces[i] == source) {
+			interfaces[i]->reply(buf);
+		} else {
+			interfaces[i]->publish(buf, topic);
+		}
+	}
+}
+
+void CommManager::showCounters() {
 	for(int i = 0; i < nextInterface; i++) {
 		if(interfaces[i] != NULL) {
-			interfaces[i]->send(buf);
+			const TxCounters &c = interfaces[i]->counters();
+			printf("<C %d %lu %lu %lu %lu %lu %lu %lu>", i, (unsigned long)c.queued, (unsigned long)c.sent, (unsigned long)c.dropped, (unsigned long)c.merged, (unsigned long)c.filtered,
+				(unsigned long)interfaces[i]->commandCount(), (unsigned long)interfaces[i]->deferredCount());
 		}
 	}
+	printf("<C OVERRUNS %lu>", (unsigned long)overruns);
+}
+
+// <U BIN ON>: selects text (0) or binary (1) replies for the interface the command came in on.
+// <U SUB TOPIC ...>: selects the topics (see Topics.h) that interface gets replies about.
+void CommManager::option(const char *s) {
+	CommandArgs a;
+	while(*s == ' ') {
+		s++;
+	}
+	if(source != NULL && strncmp(s, "SUB", 3) == 0 && (s[3] == ' ' || s[3] == '\0')) {
+		int mask = parseTopics(s + 3, source->subscribed());
+		if(mask < 0) {
+			reject();
+			return;
+		}
+		source->subscribe(mask);
+		respond("<U SUB %d>", mask);
+		return;
+	}
+	if(source == NULL || strncmp(s, "BIN", 3) != 0 || !a.parse(s + 3, 1, 1) || !a.inRange(0, 0, 1)) {
+		reject();
+		return;
+	}
+	CommInterface *from = source;
+	if(from->canSendBinary()) {
+		respond("<U BIN %d>", a[0]);         // confirmed in the old format
+		from->setBinaryReplies(a[0]);
+	} else {
+		reject();
+	}
 }
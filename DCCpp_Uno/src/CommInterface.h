@@ -8,13 +8,86 @@
 #ifndef COMMINTERFACE_H_
 #define COMMINTERFACE_H_
 
+#include <stddef.h>
+#include <stdarg.h>
+#include "BinaryCommand.h"
+#include "FrameAssembler.h"
+#include "TxRing.h"
+#include "Topics.h"
+#include "RateLimit.h"
+#include "Reply.h"
+
+#define TX_WAIT_MICROS 20000   // how long an answer to a command waits for a full transmit queue to move before it is dropped
+#define COMM_UPDATE_MICROS 5000  // time CommManager::update() may spend reading commands in one pass of the main loop
+// longest reply CommManager::printf sends, in one piece or several; the frequent ones use Reply
+#ifdef ARDUINO_ARCH_AVR
+#define PRINTF_MAX 128
+#else
+#define PRINTF_MAX 256           // also holds a whole <J> histogram line (see GeneratorStats.h)
+#endif
+
+// Framing state and command rate of one incoming byte stream.  Interfaces with several clients keep one per client.
+struct CommandReader {
+	BinaryFrameReader binary;
+	FrameAssembler text;
+	RateLimit limit{CLIENT_COMMAND_RATE, CLIENT_COMMAND_BURST};
+};
+
 class CommInterface {
 public:
 	virtual void process() = 0;
 	virtual void showConfiguration() = 0;
 	virtual void showInitInfo() = 0;
 	virtual void send(const char *buf) = 0;
+	virtual void write(const uint8_t *buf, size_t len) = 0;
+	// Number of bytes write() takes right now without blocking.
+	virtual int txSpace() { return TX_RING_SIZE; }
+	// False while the interface has nowhere to send, such as the ESP link while it is down; replies are dropped then.
+	virtual bool txUp() { return true; }
+	// Interfaces that can carry binary frames (see BinaryCommand.h) return true.
+	virtual bool canSendBinary() const { return false; }
+	void reply(const char *buf);
+	// Interfaces that can take a reply's numbers as they are (see Reply.h) override this one as well.
+	virtual void reply(const Reply &r) { reply(r.buf, r.n, r.key); }
+	// Queues n bytes of buf, whose key (see TxRing.h) is 0 if no newer reply replaces it.  buf ends with a NUL.
+	virtual void reply(const char *buf, uint16_t n, uint32_t key);
+	void publish(const char *buf, uint8_t topic);
+	void publish(const Reply &r);
+	void subscribe(uint8_t mask) { topics = mask; }
+	uint8_t subscribed() const { return topics; }
+	void flush();
+	void setBinaryReplies(bool on);
+	const TxCounters &counters() const { return txRing.counters; }
+	uint32_t commandCount() const { return commands; }
+	uint32_t deferredCount() const { return deferred; }
 	virtual ~CommInterface();
+protected:
+	bool receive(char ch) { return receive(ch, reader); }
+	bool receive(char ch, CommandReader &from);
+	// process() reads while this is true, it turns false when the client or the interface is out of commands per
+	// second, or the pass of CommManager::update() is out of time (see pacing).
+	bool mayReceive() { return mayReceive(reader); }
+	bool mayReceive(CommandReader &from);
+	// How mayReceive() paces the interface.  PACE_CLIENT limits each client and the interface.  PACE_INTERFACE is
+	// for interfaces whose one reader carries many clients, such as the ESP: only the interface limit applies.
+	// PACE_NONE is for a UART, which has no flow control, so bytes left unread are lost; its baud rate limits it.
+	enum Pacing : uint8_t { PACE_CLIENT, PACE_INTERFACE, PACE_NONE };
+	Pacing pacing = PACE_CLIENT;
+	virtual void command(const char *com);
+	void command(char letter, const CommandArgs &a);
+	// Called by receive() once the answers to the command it ran are queued, with this interface still the source.
+	virtual void answered() {}
+private:
+	void charge(CommandReader &from);
+	bool queue(const uint8_t *data, uint16_t n, uint32_t key);
+	CommandReader reader;
+	BinaryReplyEncoder replyEncoder;
+	TxRing txRing;
+	bool binaryReplies = false;
+	uint8_t topics = TOPIC_ALL;
+	RateLimit limit{INTERFACE_COMMAND_RATE, INTERFACE_COMMAND_BURST};
+	uint32_t commands = 0;         // commands run
+	uint32_t deferred = 0;         // times reading stopped with data waiting because a client or the interface had no credit
 };
 
 class CommManager {
@@ -24,9 +97,28 @@ public:
 	static void showConfiguration();
 	static void showInitInfo();
 	static void printf(const char *fmt, ...);
+	static void respond(const char *fmt, ...);
+	static void respond(const Reply &r);
+	static void send(const Reply &r);
+	// A command that fails calls fail(), or reject() to answer <X> as well, so that <#ID COMMAND> can report it.
+	static void fail() { errors++; }
+	static void reject();
+	static uint16_t errorCount() { return errors; }
+	static void option(const char *s);
+	static void showCounters();
+	static CommInterface *commandSource() { return source; }
+	static bool inBudget();
 private:
 	static CommInterface *interfaces[10];
 	static int nextInterface;
+	static int first;                 // interface update() starts with, taken in turn
+	static unsigned long passStart;   // micros() at the start of update()
+	static uint32_t overruns;         // passes of update() that ran out of time
+	static CommInterface *source;     // the interface whose command is being run, NULL when a command comes from elsewhere
+	static uint16_t errors;          // commands failed so far
+	static void vsend(CommInterface *to, const char *fmt, va_list args);
+	static void dispatch(CommInterface *to, const char *buf);
+	friend class CommInterface;
 };
 
 #endif /* COMMINTERFACE_H_ */
@@ -12,89 +12,100 @@
 
 #if COMM_INTERFACE == 4
 
-ESPInterface::ESPInterface(Stream &serialStream, IPAddress *ip) : _serialStream(serialStream), _buffer(""), _inCommandPayload(false) {
-	init(ip);
-}
-
-void ESPInterface::init(IPAddress *ip) {
-	int attempts = 10;
-	bool responseFound = false;
-	// set timeout to 500ms for reads
-	_serialStream.setTimeout(500L);
-	while(attempts-- > 0 && !responseFound) {
-		_serialStream.println("<iESP-reset>");
-		// give ESP some time to restart and stabilize
-		delay(250);
-		String resetStatus = _serialStream.readStringUntil('>');
-		if(resetStatus.indexOf("iESP-DCC++ init") >= 0) {
-			responseFound = true;
-		}
-	}
-	_serialStream.println("<iESP-status>");
-	String espStatus = _serialStream.readStringUntil('>');
+ESPInterface::ESPInterface(Stream &serialStream, IPAddress *ip) : _link(serialStream), _step(ESP_LINK), _stepTime(0), _fromESP(false) {
+	pacing = PACE_INTERFACE;
 	if(ip != NULL) {
 		// TODO: Start networking using STATIC IP Address
 	}
-	_serialStream.print("<iESP-connect ");
-	_serialStream.print(strlen(WIFI_SSID));
-	_serialStream.print(" ");
-	_serialStream.print(WIFI_SSID);
-	_serialStream.print(" ");
-	_serialStream.print(WIFI_PASSWORD);
-	_serialStream.println(">");
-	// discard the connecting response
-	espStatus = _serialStream.readStringUntil('>');
-	bool connecting = true;
-	while (connecting) {
-		// wait for the connected/failed message
-		espStatus = _serialStream.readStringUntil('>');
-		if (espStatus.indexOf("connected") > 0) {
-			connecting = false;
-			// connected to AP, parse the IP address out
-			String ipString = espStatus.substring(
-					espStatus.lastIndexOf(' ') + 1, espStatus.length());
-			//Serial.println("IP: " + ipString);
-			_localAddress.fromString(ipString);
-		} else if (espStatus.indexOf("connect failed") > 0
-				|| espStatus.indexOf("not found") > 0
-				|| espStatus.indexOf("timeout") > 0) {
-			// connection failed.  Abort.
-			Serial.println("<iDCC++ Unable to connect to WiFi, Halting>");
-			Serial.println(espStatus);
-			// don't continue
-			while (true)
-				;
-		}
+}
+
+void ESPInterface::process() {
+	_link.poll();
+	unsigned long now = micros();
+	if(_link.up() && _step == ESP_LINK) {
+		step(ESP_STATUS, "<iESP-status>");
+	} else if((_step != ESP_LINK && _step != ESP_READY && now - _stepTime >= ESP_STEP_MICROS)
+			|| (_step == ESP_RETRY && now - _stepTime >= ESP_RETRY_MICROS)) {
+		step(ESP_STATUS, "<iESP-status>");     // the answer was lost, or it is time to try WiFi again
 	}
-	_serialStream.println("<iESP-status>");
-	_serialStream.readStringUntil('>');
-	_serialStream.println("<iESP-start>");
-	_serialStream.readStringUntil('>');
-#ifdef ENABLE_LCD
-	if(lcdEnabled) {
-		lcdDisplay.setCursor(0, 1);
-		lcdDisplay.print(_localAddress);
+	while(_link.available() && mayReceive()) {
+		receive(_link.read());
 	}
-#endif
+}
 
+void ESPInterface::step(Step next, const char *com) {
+	_step = next;
+	_stepTime = micros();
+	if(next == ESP_CONNECT) {
+		char buf[16];
+		snprintf(buf, sizeof(buf), "<iESP-connect %d ", (int)strlen(WIFI_SSID));
+		_link.print(buf);
+		_link.print(WIFI_SSID);
+		_link.print(" ");
+		_link.print(WIFI_PASSWORD);
+		_link.print(">");
+	} else if(com != NULL) {
+		_link.print(com);
+	}
 }
 
-void ESPInterface::process() {
-	while(_serialStream.available()) {
-		char ch = _serialStream.read();
-		if (ch == '<') {
-			_inCommandPayload = true;
-			_buffer = "";
-		} else if (ch == '>') {
-			SerialCommand::parse(_buffer.c_str());
-			_buffer = "";
-			_inCommandPayload = false;
-		} else if(_inCommandPayload) {
-			_buffer += ch;
+// Answers of the ESP to the bring-up steps arrive as commands, the rest are passed on.
+void ESPInterface::command(const char *com) {
+	if(strncmp(com, "iESP", 4) != 0) {
+		CommInterface::command(com);
+		return;
+	}
+	_fromESP = true;
+	char ip[16];
+	int wifi, server;
+	if(strcmp(com, "iESP-DCC++ init") == 0) {
+		step(ESP_STATUS, "<iESP-status>");       // the ESP started again
+	} else if(sscanf(com, "iESP-status %d %15s %d", &wifi, ip, &server) == 3) {
+		if(_step != ESP_STATUS) {
+			return;
+		}
+		if(wifi != 3) {                          // WL_CONNECTED
+			step(ESP_CONNECT, NULL);
+		} else {
+			_localAddress.fromString(ip);
+			if(server) {
+				step(ESP_READY, NULL);
+				showInitInfo();
+			} else {
+				step(ESP_START, "<iESP-start>");
+			}
 		}
+	} else if(sscanf(com, "iESP connected %15s", ip) == 1) {
+		_localAddress.fromString(ip);
+		step(ESP_START, "<iESP-start>");
+	} else if(strcmp(com, "iESP ready") == 0) {
+		step(ESP_READY, NULL);
+		showInitInfo();
+#ifdef ENABLE_LCD
+		if(lcdEnabled) {
+			lcdDisplay.setCursor(0, 1);
+			lcdDisplay.print(_localAddress);
+		}
+#endif
+	} else if(strcmp(com, "iESP connect failed") == 0 || strcmp(com, "iESP AP not found") == 0
+			|| strcmp(com, "iESP connect timeout") == 0) {
+		Serial.print("<iDCC++ Unable to connect to WiFi, retrying: ");
+		Serial.print(com);
+		Serial.println(">");
+		step(ESP_RETRY, NULL);
 	}
 }
 
+// Ends the answers to a command of a client of the ESP, so that the ESP knows which of the replies before are
+// that client's (see AnswerRouting in DCCpp_ESP.cpp).  The bring-up answers of the ESP itself need no end.
+void ESPInterface::answered() {
+	if(_fromESP) {
+		_fromESP = false;
+		return;
+	}
+	reply("<iESP-ran>");
+}
+
 void ESPInterface::showConfiguration() {
 	Serial.print(" - IP: ");
 	Serial.print(_localAddress);
@@ -106,7 +117,11 @@ void ESPInterface::showInitInfo() {
 }
 
 void ESPInterface::send(const char *buf) {
-	_serialStream.print(buf);
+	_link.print(buf);
+}
+
+void ESPInterface::write(const uint8_t *buf, size_t len) {
+	_link.write(buf, len);
 }
 
 ESPHardwareSerialInterface::ESPHardwareSerialInterface(HardwareSerial &serial, long baud, IPAddress *ip) : ESPInterface(initSerialStream(serial, baud), ip), _baud(baud), _serial(serial) {
@@ -15,8 +15,13 @@
 #include <HardwareSerial.h>
 #include <SoftwareSerial.h>
 #include <IPAddress.h>
+#include "SerialLink.h"
 
+#define  ESP_STEP_MICROS           45000000  // longest wait for the ESP to answer a step of the bring-up
+#define  ESP_RETRY_MICROS          10000000  // wait before trying WiFi again after it failed
 
+// Talks to the ESP over a SerialLink, so nothing here waits for it: the ESP is brought up step by step from
+// process() while the base station already drives the track, and brought up again when it restarts.
 class ESPInterface : public CommInterface {
 public:
 	ESPInterface(Stream &serialStream, IPAddress *ip=NULL);
@@ -24,12 +29,28 @@ public:
 	void showConfiguration();
 	void showInitInfo();
 	void send(const char *buf);
+	void write(const uint8_t *buf, size_t len);
+	int txSpace() { return _link.space(); }
+	bool txUp() { return _link.up(); }
+	bool canSendBinary() const { return true; }
+protected:
+	void command(const char *com);
+	void answered();
 private:
-	void init(IPAddress *ip = NULL);
-	Stream &_serialStream;
+	enum Step : uint8_t {
+		ESP_LINK,       // waiting for the link to come up
+		ESP_STATUS,     // sent <iESP-status>
+		ESP_CONNECT,    // sent <iESP-connect ...>
+		ESP_START,      // sent <iESP-start>
+		ESP_RETRY,      // WiFi failed, waiting ESP_RETRY_MICROS
+		ESP_READY
+	};
+	void step(Step next, const char *com);
+	SerialLink _link;
 	IPAddress _localAddress;
-	String _buffer;
-	bool _inCommandPayload;
+	Step _step;
+	unsigned long _stepTime;
+	bool _fromESP;      // the command just run was the ESP's own, see answered()
 };
 
 class ESPHardwareSerialInterface : public ESPInterface {
@@ -12,7 +12,10 @@
 #include "SerialCommand.h"
 
 #if COMM_INTERFACE >= 1 && COMM_INTERFACE <= 3
-EthernetInterface::EthernetInterface() : server(ETHERNET_PORT), buffer(""), inCommandPayload(false) {
+EthernetInterface::EthernetInterface() : server(ETHERNET_PORT), next(0) {
+	for(int i = 0; i < ETHERNET_MAX_CLIENTS; i++) {
+		clients[i].active = false;
+	}
 	pinMode(SDCARD_CS, OUTPUT);
 	digitalWrite(SDCARD_CS, HIGH);     // Deselect the SD card
 	byte localMac[] = MAC_ADDRESS;
@@ -33,21 +36,59 @@ EthernetInterface::EthernetInterface() : server(ETHERNET_PORT), buffer(""), inCo
 #endif
 }
 
+// Takes new connections as soon as they are made, so that a client that only listens gets replies too, drops
+// closed ones and reads everything the clients have sent, each into its own CommandReader, until
+// ETHERNET_READ_MICROS is used up.  Replies still go to every client.
 void EthernetInterface::process() {
-	EthernetClient client = server.available();
-	if(client && client.connected()) {
-		char ch = client.read();
-		if (ch == '<') {
-			inCommandPayload = true;
-			buffer = "";
-		} else if (ch == '>') {
-			SerialCommand::parse(buffer.c_str());
-			buffer = "";
-			inCommandPayload = false;
-		} else if(inCommandPayload) {
-			buffer += ch;
+	unsigned long start = micros();
+	server.available();                            // keeps a socket listening for new connections
+	for(int sock = 0; sock < MAX_SOCK_NUM; sock++) {
+		EthernetClient client(sock);               // server.available() only ever returns the first socket with data
+		if(client.connected()) {
+			accept(client);
+		}
+	}
+	for(int n = 0; n < ETHERNET_MAX_CLIENTS; n++) {
+		Client &c = clients[(next + n) % ETHERNET_MAX_CLIENTS];
+		if(!c.active) {
+			continue;
+		}
+		if(!c.client.connected()) {
+			c.client.stop();
+			c.active = false;
+			continue;
+		}
+		while(c.client.available() > 0) {
+			if(micros() - start > ETHERNET_READ_MICROS) {
+				next = (next + n) % ETHERNET_MAX_CLIENTS;    // carry on with this client next time
+				return;
+			}
+			if(!mayReceive(c.reader)) {
+				break;                 // out of credit, the rest waits in the socket
+			}
+			receive(c.client.read(), c.reader);
 		}
 	}
+	next = (next + 1) % ETHERNET_MAX_CLIENTS;
+}
+
+void EthernetInterface::accept(EthernetClient &client) {
+	int free = -1;
+	for(int i = 0; i < ETHERNET_MAX_CLIENTS; i++) {
+		if(clients[i].active && clients[i].client == client) {
+			return;
+		}
+		if(!clients[i].active && free < 0) {
+			free = i;
+		}
+	}
+	if(free < 0) {
+		client.stop();                 // no room, the client sees the connection close
+		return;
+	}
+	clients[free].client = client;
+	clients[free].reader = CommandReader();
+	clients[free].active = true;
 }
 
 void EthernetInterface::showConfiguration() {
@@ -70,7 +111,15 @@ void EthernetInterface::showInitInfo() {
 }
 
 void EthernetInterface::send(const char *buf) {
-	server.print(buf);
+	write((const uint8_t *)buf, strlen(buf));
+}
+
+void EthernetInterface::write(const uint8_t *buf, size_t len) {
+	for(int i = 0; i < ETHERNET_MAX_CLIENTS; i++) {
+		if(clients[i].active) {
+			clients[i].client.write(buf, len);
+		}
+	}
 }
 
 #endif
@@ -12,6 +12,8 @@
 #include "CommInterface.h"
 
 #define SDCARD_CS 4
+#define ETHERNET_MAX_CLIENTS 3         // the W5100 has 4 sockets, one stays listening for new connections
+#define ETHERNET_READ_MICROS 2000      // time process() may spend reading in one pass of the main loop
 
 #if COMM_INTERFACE == 1
   #include <Ethernet.h>         // built-in Arduino.cc library
@@ -29,11 +31,20 @@ public:
 	void showConfiguration();
 	void showInitInfo();
 	void send(const char *buf);
+	void write(const uint8_t *buf, size_t len);
+	int txSpace() { return 64; }   // EthernetClient cannot tell, keep each write to one small packet
+	bool canSendBinary() const { return true; }
 protected:
+	struct Client {
+		EthernetClient client;
+		CommandReader reader;
+		bool active;
+	};
+	void accept(EthernetClient &client);
 	EthernetServer server;
-	byte mac[];
-	String buffer;
-	bool inCommandPayload;
+	Client clients[ETHERNET_MAX_CLIENTS];
+	byte next;                     // client to read from first in the next pass, so that a busy client can not starve the others
+	byte mac[6];
 };
 #endif
 
@@ -25,9 +25,13 @@
 namespace {
 	StreamString write_to_server, read_from_server;
 }
+Histogram<10> LocalWebInterface::latency;
+
 LocalWebInterface::LocalWebInterface()
 {
+	pacing = PACE_INTERFACE;
 	DCCpp::Server::setup(write_to_server, read_from_server);
+	DCCpp::Server::setDispatcher(this);
 	send("<iESP-connect 21 TN_private_W9V7VU_Ext W49K4XWN4344J>\n");
 //		"<iESP-start>\n");*/
 	send("<iESP-softAP trains>\n");
@@ -35,26 +39,38 @@ LocalWebInterface::LocalWebInterface()
 void LocalWebInterface::process()
 {
 	DCCpp::Server::loop();
-	while(read_from_server.available()) {
+	while(read_from_server.available() && mayReceive()) {
 		auto ch = read_from_server.read();
 		if(ch == -1)
 			break;
-		if (ch == '<') {
-			inCommandPayload = true;
-			buffer = "";
-		} else if (ch == '>') {
-			if(buffer.startsWith("iESP AP connected")) {
-				Serial.printf("YAy have connection, starting!\n");
-				send("<iESP-start>\n");
-			} else
-				SerialCommand::parse(buffer.c_str());
-			buffer = "";
-			inCommandPayload = false;
-      break;
-		} else if(inCommandPayload) {
-			buffer += (char)ch;
-		}
+		receive(ch);
+	}
+}
+bool LocalWebInterface::ready()
+{
+	return mayReceive();
+}
+void LocalWebInterface::run(const DCCpp::Server::Command &c)
+{
+	latency.add(micros() - c.queued);
+	if(c.op == 0) {
+		for(const char *p = c.text; *p; p++)
+			receive(*p);
+		return;
 	}
+	CommandArgs a;
+	a.n = c.n;
+	for(uint8_t i = 0; i < c.n; i++)
+		a.v[i] = c.args[i];
+	CommInterface::command(c.op, a);   // our command(const char *) hides this overload
+}
+void LocalWebInterface::command(const char *com)
+{
+	if(strncmp(com, "iESP AP connected", 17) == 0) {
+		Serial.printf("YAy have connection, starting!\n");
+		send("<iESP-start>\n");
+	} else
+		CommInterface::command(com);
 }
 void LocalWebInterface::showConfiguration()
 {
@@ -69,5 +85,28 @@ void LocalWebInterface::send(const char *buf)
 {
 	write_to_server.print(buf);
 }
+void LocalWebInterface::write(const uint8_t *buf, size_t len)
+{
+	write_to_server.write(buf, len);
+}
+void LocalWebInterface::reply(const char *buf, uint16_t n, uint32_t key)
+{
+	DCCpp::Server::onReply(buf);
+}
+static_assert(REPLY_EVENT_ARGS >= REPLY_ARGS, "a ReplyEvent takes every number of a Reply");
+void LocalWebInterface::reply(const Reply &r)
+{
+	DCCpp::Server::ReplyEvent e;
+	e.letter = r.buf[1];
+	e.n = r.nArgs;
+	for(uint8_t i = 0; i < r.nArgs; i++)
+		e.args[i] = r.args[i];
+	e.key = r.key;
+	if(r.textAt) {
+		e.name = r.buf + r.textAt;
+		e.nameLength = r.n - 1 - r.textAt;   // up to the >
+	}
+	DCCpp::Server::onReply(e, r.buf);
+}
 
 #endif
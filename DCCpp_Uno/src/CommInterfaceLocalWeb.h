@@ -11,18 +11,33 @@
 
 #if COMM_INTERFACE == 5
 #include "CommInterface.h"
+#include "GeneratorStats.h"
 #include <Arduino.h>
+#include "../../DCCpp_ESP/src/DCCpp_ESP.h"
 
-class LocalWebInterface : public CommInterface {
+// The web server runs in the same binary: commands it queues are run directly (as DCCpp::Server::Dispatcher), and
+// replies are handed back to it as calls.  The frequent ones, built with Reply, go as a ReplyEvent of their letter,
+// numbers and key, which the server acts on without reading the text; the text goes along only to be passed on to
+// its clients.  Replies printed with CommManager::printf go as text, which the server reads once (parseReply).
+class LocalWebInterface : public CommInterface, public DCCpp::Server::Dispatcher {
 public:
 	LocalWebInterface();
 	virtual void process() override;
 	virtual void showConfiguration() override;
 	virtual void showInitInfo() override;
+	virtual void command(const char *com) override;
 	virtual void send(const char *buf);
+	virtual void write(const uint8_t *buf, size_t len) override;
+	virtual void reply(const char *buf, uint16_t n, uint32_t key) override;
+	virtual void reply(const Reply &r) override;
+	virtual bool ready() override;
+	virtual void run(const DCCpp::Server::Command &c) override;
+	// <JW> of the <J> command: us from the web server queuing a command to it running here, 1024us bins.  Added to
+	// the <JR> of a track it gives the latency from the web to the rails.
+	static void showLatency() { latency.show("JW"); }
+	static void resetLatency() { latency.reset(); }
 private:
-	bool inCommandPayload = false;
-	String buffer;
+	static Histogram<10> latency;
 };
 
 #endif
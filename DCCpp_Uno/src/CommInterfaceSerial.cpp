@@ -7,26 +7,16 @@
 
 #include <Arduino.h>
 #include "CommInterfaceSerial.h"
-#include "SerialCommand.h"
 
-HardwareSerialInterface::HardwareSerialInterface(HardwareSerial &serial, long baud) : serialStream(serial), baud(baud), buffer(""), inCommandPayload(false) {
+HardwareSerialInterface::HardwareSerialInterface(HardwareSerial &serial, long baud) : serialStream(serial), baud(baud) {
+	pacing = PACE_NONE;
 	serial.begin(baud);
 	serial.flush();
 }
 
 void HardwareSerialInterface::process() {
-	while(Serial.available()) {
-		char ch = Serial.read();
-		if (ch == '<') {
-			inCommandPayload = true;
-			buffer = "";
-		} else if (ch == '>') {
-			SerialCommand::parse(buffer.c_str());
-			buffer = "";
-			inCommandPayload = false;
-		} else if(inCommandPayload) {
-			buffer += ch;
-		}
+	while(Serial.available() && mayReceive()) {
+		receive(Serial.read());
 	}
 }
 
@@ -42,3 +32,11 @@ void HardwareSerialInterface::showInitInfo() {
 void HardwareSerialInterface::send(const char *buf) {
 	Serial.print(buf);
 }
+
+void HardwareSerialInterface::write(const uint8_t *buf, size_t len) {
+	Serial.write(buf, len);
+}
+
+int HardwareSerialInterface::txSpace() {
+	return Serial.availableForWrite();
+}
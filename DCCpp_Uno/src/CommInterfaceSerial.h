@@ -18,11 +18,12 @@ public:
 	void showConfiguration();
 	void showInitInfo();
 	void send(const char *buf);
+	void write(const uint8_t *buf, size_t len);
+	int txSpace();
+	bool canSendBinary() const { return true; }
 protected:
 	Stream &serialStream;
 	long baud;
-	String buffer;
-	bool inCommandPayload;
 };
 
 #endif /* COMMINTERFACESERIAL_H_ */
@@ -0,0 +1,58 @@
+/**********************************************************************
+
+CommandArgs.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "CommandArgs.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static bool blank(char c){
+  return c==' ' || c=='\t' || c=='\r' || c=='\n';
+}
+
+bool CommandArgs::parse(const char *s, uint8_t minArgs, uint8_t maxArgs, uint8_t hexMask){
+  n=0;
+  while(true){
+    while(blank(*s))
+      s++;
+    if(*s=='\0')
+      break;
+    if(n>=maxArgs || n>=COMMAND_MAX_ARGS)
+      return false;                       // too many arguments
+    bool hex=(hexMask>>n)&1;
+    bool negative=false;
+    if(*s=='-' && !hex){
+      negative=true;
+      s++;
+    } else if(*s=='+')
+      s++;
+    if(hex && s[0]=='0' && (s[1]=='x' || s[1]=='X'))
+      s+=2;                               // sscanf's %x took the prefix too
+    int32_t value=0;
+    uint8_t digits=0;
+    while(true){
+      char c=*s;
+      uint8_t d;
+      if(c>='0' && c<='9')
+        d=c-'0';
+      else if(hex && c>='a' && c<='f')
+        d=c-'a'+10;
+      else if(hex && c>='A' && c<='F')
+        d=c-'A'+10;
+      else
+        break;
+      if(++digits>(hex ? 8 : 9))
+        return false;                     // would overflow
+      value=hex ? (value<<4)|d : value*10+d;
+      s++;
+    }
+    if(digits==0 || (!blank(*s) && *s!='\0'))
+      return false;                       // not a number, or a number followed by something else
+    v[n++]=negative ? -value : value;
+  }
+  return n>=minArgs;
+} // CommandArgs::parse
@@ -0,0 +1,31 @@
+/**********************************************************************
+
+CommandArgs.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef CommandArgs_h
+#define CommandArgs_h
+
+#include <stdint.h>
+
+// Splits the space separated numeric arguments of a text command, reading the command string in place
+// (no copies, no allocation, no sscanf).  parse() fails unless every argument is a well formed decimal
+// (or, where marked in hexMask, hexadecimal) number and the number of arguments is within [minArgs, maxArgs].
+// As with the sscanf it replaced, tabs, CR and LF separate arguments too, a number may carry a leading '+'
+// and a hexadecimal one a 0x prefix.  Unlike sscanf, trailing garbage after a number is an error, not ignored.
+// Callers then check each value with inRange() and answer <X> if anything is wrong.
+
+#define  COMMAND_MAX_ARGS          6
+
+struct CommandArgs{
+  int32_t v[COMMAND_MAX_ARGS];
+  uint8_t n;
+  bool parse(const char *s, uint8_t minArgs, uint8_t maxArgs, uint8_t hexMask = 0);   // bit i of hexMask set: argument i is hexadecimal
+  bool inRange(uint8_t i, int32_t lo, int32_t hi) const { return i < n && v[i] >= lo && v[i] <= hi; }
+  int operator[](uint8_t i) const { return (int)v[i]; }
+}; // CommandArgs
+
+#endif
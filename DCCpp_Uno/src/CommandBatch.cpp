@@ -0,0 +1,143 @@
+/**********************************************************************
+
+CommandBatch.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "CommandBatch.h"
+#include "SerialCommand.h"
+#include "CommInterface.h"
+
+#define  BATCH_TIMEOUT             1000000 // microseconds to wait for the generator to start the last member
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CommandBatch::begin(){
+  if(due){                                 // the batch before is not started yet and still needs members[]
+    CommManager::reject();
+    return;
+  }
+  nMembers=0;                              // an open batch that was never committed is dropped
+  owner=CommManager::commandSource();
+  track=SerialCommand::mRegs;
+  open=true;
+} // CommandBatch::begin
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool CommandBatch::capture(volatile RegisterList *regs, int nReg, const byte *b, int nBytes, int nRepeat){
+  if(!open || regs!=track || CommManager::commandSource()!=owner || nMembers>=BATCH_MAX_MEMBERS || nBytes>5)
+    return false;
+  BatchMember &m=members[nMembers++];
+  m.nReg=nReg;
+  m.nBytes=nBytes;
+  m.nRepeat=nRepeat;
+  memcpy(m.b,b,nBytes);
+  return true;
+} // CommandBatch::capture
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CommandBatch::supersede(volatile RegisterList *regs, int nReg){
+  if(nReg==0)
+    return;
+  if(regs==sendTrack){                     // started: drop it from the registers finish() reloads
+    byte n=0;
+    for(byte i=0;i<nRefresh;i++)
+      if(refresh[i].nReg!=nReg)
+        refresh[n++]=refresh[i];
+    nRefresh=n;
+  }
+  if(regs==track)                          // not started yet: its packet is still sent once, but not refreshed
+    for(byte i=0;i<nMembers;i++)
+      if(members[i].nReg==nReg)
+        members[i].nReg=0;
+} // CommandBatch::supersede
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CommandBatch::commit(){
+  if(!open){
+    CommManager::reject();
+    return;
+  }
+  open=false;
+  due=true;
+  poll();
+} // CommandBatch::commit
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CommandBatch::poll(){
+  if(sending){                             // the generator moves sequence on as it takes each packet
+    Packet *s=sendTrack->sequence;
+    long t=micros()-started;
+    if(first<0 && s!=sequence)
+      first=t;
+    if(s==nullptr || s>sequence+nSent-1)
+      finish(t);
+    else if(t>BATCH_TIMEOUT){              // the generator is not taking packets, let later batches start
+      const_cast<RegisterList*>(sendTrack)->killSequence();
+      finish(-1);
+    }
+  }
+  if(due && !sending && (sendTrack==NULL || sendTrack->sequence==nullptr))   // repeats of the batch before may still be in sequence[]
+    start();
+} // CommandBatch::poll
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CommandBatch::start(){
+  due=false;
+  byte n=0;
+  for(byte i=0;i<nMembers;i++)             // one copy of every member back to back
+    sequence[n++].setup(members[i].b,members[i].nBytes,1);
+  for(byte i=0;i<nMembers;i++)             // then the remaining repeats of the register 0 packets
+    if(members[i].nReg==0 && members[i].nRepeat>0)
+      sequence[n++].setup(members[i].b,members[i].nBytes,members[i].nRepeat);
+  nRefresh=0;
+  for(byte i=0;i<nMembers;i++)
+    if(members[i].nReg>0)
+      refresh[nRefresh++]=members[i];
+  nSent=nMembers;
+  nMembers=0;
+  sendTrack=track;
+  first=-1;
+  if(n==0){
+    finish(-1);
+    return;
+  }
+  started=micros();
+  sending=true;
+  sendTrack->scheduleSequence(sequence,n);
+} // CommandBatch::start
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CommandBatch::finish(long last){
+  sending=false;
+  byte n=nRefresh;
+  nRefresh=0;                              // so that these loads do not supersede themselves
+  for(byte i=0;i<n;i++)                    // keep refreshing the throttles from their registers
+    sendTrack->loadPacket(refresh[i].nReg,refresh[i].b,refresh[i].nBytes,0,1);
+  CommManager::printf("<] %d %ld %ld>",nSent,first,last);
+} // CommandBatch::finish
+
+///////////////////////////////////////////////////////////////////////////////
+
+BatchMember CommandBatch::members[BATCH_MAX_MEMBERS];
+BatchMember CommandBatch::refresh[BATCH_MAX_MEMBERS];
+Packet CommandBatch::sequence[2*BATCH_MAX_MEMBERS];
+byte CommandBatch::nMembers=0;
+byte CommandBatch::nRefresh=0;
+byte CommandBatch::nSent=0;
+bool CommandBatch::open=false;
+bool CommandBatch::due=false;
+bool CommandBatch::sending=false;
+volatile RegisterList *CommandBatch::track=NULL;
+volatile RegisterList *CommandBatch::sendTrack=NULL;
+CommInterface *CommandBatch::owner=NULL;
+unsigned long CommandBatch::started=0;
+long CommandBatch::first=-1;
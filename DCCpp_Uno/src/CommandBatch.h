@@ -0,0 +1,60 @@
+/**********************************************************************
+
+CommandBatch.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef CommandBatch_h
+#define CommandBatch_h
+
+#include "PacketRegister.h"
+
+// Groups main track commands so that their packets reach the rails together.  Between <[> and <]> the packets
+// that throttle, function, accessory and turnout commands from the same interface would load into the track <[>
+// was sent for (SerialCommand::mRegs at that time) are collected instead; packets for another track, as with
+// <@NAME ...>, are loaded at once as usual.  <]> then schedules the first packet of every member back to back as
+// one Packet sequence (which the generator sends ahead of the register cycle), followed by the repeats of the
+// function and accessory packets.  Nothing waits for the generator: poll(), called from the main loop, starts a
+// committed batch once the previous one is out of sequence, and once the last member has started updates the
+// throttle registers for refresh and reports the timing.  A register loaded directly in the meantime, such as
+// by a stop sent right after <]>, is newer than the batch and keeps its packet.
+
+#define  BATCH_MAX_MEMBERS         12      // packets a batch can hold, later packets are loaded at once as usual
+
+class CommInterface;
+
+struct BatchMember{
+  byte nReg;                               // register to refresh the packet from after the batch, 0 for none
+  byte nBytes;
+  byte nRepeat;                            // repeats of a register 0 packet
+  byte b[6];                               // packet bytes, with room for the checksum
+}; // BatchMember
+
+struct CommandBatch{
+  static BatchMember members[BATCH_MAX_MEMBERS];   // of the batch being collected or waiting to start
+  static BatchMember refresh[BATCH_MAX_MEMBERS];   // throttle members of the batch being sent
+  static Packet sequence[2*BATCH_MAX_MEMBERS];   // first packets of all members, then the repeats
+  static byte nMembers;
+  static byte nRefresh;
+  static byte nSent;                       // members of the batch being sent
+  static bool open;
+  static bool due;                         // committed, waiting for sequence to be free
+  static bool sending;                     // started, waiting for its last member to reach the generator
+  static volatile RegisterList *track;     // of the batch being collected or waiting to start
+  static volatile RegisterList *sendTrack; // of the batch being sent, until its sequence is done
+  static CommInterface *owner;             // the interface that sent <[>
+  static unsigned long started;            // micros() when the batch being sent was scheduled
+  static long first;                       // micros from then until its first member started, -1 not yet
+  static void begin();
+  static void commit();
+  static void poll();
+  static bool capture(volatile RegisterList *regs, int nReg, const byte *b, int nBytes, int nRepeat);   // returns true if the packet was taken into the batch
+  static void supersede(volatile RegisterList *regs, int nReg);   // a register loaded outside the batch is not refreshed from it
+private:
+  static void start();
+  static void finish(long last);
+}; // CommandBatch
+
+#endif
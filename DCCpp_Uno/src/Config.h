@@ -88,6 +88,31 @@ Part of DCC++ BASE STATION for the Arduino
 
 /////////////////////////////////////////////////////////////////////////////////////
 
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// DEFINE DCC SIGNAL GENERATOR USED ON THE ESP32
+//
+//  0 = RMT peripheral, refilled from its tx threshold interrupt
+//  1 = I2S peripherals, sample stream refilled in batches through DMA
+//
+// Note: This is not used with the Uno or Mega.
+
+#define ESP32_DCC_GENERATOR 0
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// DEFINE ADDITIONAL POWER DISTRICTS (ESP32 WITH ESP32_DCC_GENERATOR 0 ONLY)
+//
+// Each district gets its own register list, DCC signal pin and motor board, and is
+// sent on its own RMT channel (at most 8 tracks including MAIN and PROG).
+// Main track commands are sent to a district by prefixing them with @NAME, e.g. <@NORTH t 1 3 20 1>
+//
+// { NAME, DCC SIGNAL PIN, SIGNAL ENABLE PIN, CURRENT MONITOR PIN, MOTOR_BOARD_TYPE, NUMBER OF REGISTERS }
+//
+// #define EXTRA_DISTRICTS { "NORTH", 14, 12, A4, BTS7960B_5A, 12 }, { "SOUTH", 15, 13, A7, BTS7960B_5A, 12 }
+
+/////////////////////////////////////////////////////////////////////////////////////
+
 /////////////////////////////////////////////////////////////////////////////////////
 //
 // DEFINE LCD SCREEN USAGE BY THE BASE STATION
@@ -10,6 +10,8 @@ Part of DCC++ BASE STATION for the Arduino
 #include "DCCpp.h"
 #include "CurrentMonitor.h"
 #include "CommInterface.h"
+#include "AnalogSampler.h"
+#include "Journal.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -22,7 +24,7 @@ Part of DCC++ BASE STATION for the Arduino
 #endif
 
 MotorBoard::MotorBoard(int sensePin, int enablePin, MOTOR_BOARD_TYPE type, const char *name)
-: sensePin(sensePin), enablePin(enablePin), name(name), current(0), triggered(false), lastCheckTime(0) {
+: sensePin(sensePin), adcChannel(AnalogSampler::registerPin(sensePin)), enablePin(enablePin), name(name), current(0), triggered(false), lastCheckTime(0) {
 	pinMode(enablePin, OUTPUT);
 	#ifdef ARDUINO_ARCH_ESP32
 	analogReadResolution(12);
@@ -58,7 +60,7 @@ void MotorBoard::check() {
 	/*	static int c = 0;
 			if((++c % 2000) == 0)
 				Serial.printf("current sense pin %d = %d\n", sensePin, analogRead(sensePin));*/
-		current = analogRead(sensePin) * CURRENT_SAMPLE_SMOOTHING + current * (1.0 - CURRENT_SAMPLE_SMOOTHING);
+		current = AnalogSampler::latest(adcChannel) * CURRENT_SAMPLE_SMOOTHING + current * (1.0 - CURRENT_SAMPLE_SMOOTHING);
 		if(current > triggerValue && digitalRead(enablePin)) {
 			powerOff(false, true);
 			triggered=true;
@@ -73,6 +75,7 @@ void MotorBoard::powerOn(bool announce) {
 	digitalWrite(enablePin, HIGH);
 	if(announce) {
 		CommManager::printf("<p1 %s>", name);
+		Journal::record('p', 0, 1, 0, name);
 	}
 }
 
@@ -84,6 +87,7 @@ void MotorBoard::powerOff(bool announce, bool overCurrent) {
 		} else {
 			CommManager::printf("<p0 %s>", name);
 		}
+		Journal::record('p', 0, overCurrent ? 2 : 0, 0, name);
 	}
 }
 
@@ -91,23 +95,25 @@ int MotorBoard::getLastRead() {
 	return current;
 }
 
-void MotorBoard::showStatus() {
-	if(digitalRead(enablePin) == LOW) {
-		CommManager::printf("<p0 %s>", name);
+void MotorBoard::showStatus(bool toSource) {
+	int on = digitalRead(enablePin) == LOW ? 0 : 1;
+	if(toSource) {
+		CommManager::respond("<p%d %s>", on, name);
 	} else {
-		CommManager::printf("<p1 %s>", name);
+		CommManager::printf("<p%d %s>", on, name);
 	}
 }
 
 MotorBoard *MotorBoardManager::boards[MAX_MOTOR_BOARDS] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
 
-void MotorBoardManager::registerBoard(int sensePin, int enablePin, MOTOR_BOARD_TYPE type, const char *name) {
+MotorBoard *MotorBoardManager::registerBoard(int sensePin, int enablePin, MOTOR_BOARD_TYPE type, const char *name) {
 	for(int i = 0; i < MAX_MOTOR_BOARDS; i++) {
 		if(boards[i] == NULL) {
 			boards[i] = new MotorBoard(sensePin, enablePin, type, name);
-			return;
+			return boards[i];
 		}
 	}
+	return NULL;
 }
 
 void MotorBoardManager::check() {
@@ -125,6 +131,7 @@ void MotorBoardManager::powerOnAll() {
 		}
 	}
 	CommManager::printf("<p1>");
+	Journal::record('p', 0, 1);
 #if defined(LCD_ENABLED) && LCD_LINES > 2
 	if(lcdEnabled) {
 		lcdDisplay.setCursor(12, 3);
@@ -140,6 +147,7 @@ void MotorBoardManager::powerOffAll() {
 		}
 	}
 	CommManager::printf("<p0>");
+	Journal::record('p', 0, 0);
 #if defined(LCD_ENABLED) && LCD_LINES > 2
 	if(lcdEnabled) {
 		lcdDisplay.setCursor(12, 3);
@@ -160,7 +168,7 @@ void MotorBoardManager::parse(const char *com) {
 						return;
 					}
 				}
-				CommManager::printf("<X>");
+				CommManager::reject();
 			}
 			break;
 		case '1':
@@ -173,29 +181,29 @@ void MotorBoardManager::parse(const char *com) {
 						return;
 					}
 				}
-				CommManager::printf("<X>");
+				CommManager::reject();
 			}
 			break;
 		case 'c':
 			if(strlen(com) == 1) {
-				CommManager::printf("<a %d>", boards[0]->getLastRead());
+				CommManager::send(Reply::current(boards[0]->getLastRead()));
 			} else {
 				for(int i = 0; i < MAX_MOTOR_BOARDS; i++) {
 					if(boards[i] != NULL && strcasecmp(boards[i]->getName(), com+2) == 0) {
-						CommManager::printf("<a %d %s>", boards[i]->getLastRead(), boards[i]->getName());
+						CommManager::send(Reply::current(boards[i]->getLastRead(), boards[i]->getName()));
 						return;
 					}
 				}
-				CommManager::printf("<X>");
+				CommManager::reject();
 			}
 			break;
 	}
 }
 
-void MotorBoardManager::showStatus() {
+void MotorBoardManager::showStatus(bool toSource) {
 	for(int i = 0; i < MAX_MOTOR_BOARDS; i++) {
 		if(boards[i] != NULL) {
-			boards[i]->showStatus();
+			boards[i]->showStatus(toSource);
 		}
 	}
 }
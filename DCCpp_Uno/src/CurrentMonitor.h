@@ -24,12 +24,13 @@ public:
 	void powerOn(bool announce=true);
 	void powerOff(bool announce=true, bool overCurrent=false);
 	int getLastRead();
-	void showStatus();
+	void showStatus(bool toSource = false);   // toSource: to the interface whose command runs only
 	const char *getName() {
 		return name;
 	}
 private:
 	int sensePin;
+	int8_t adcChannel;
 	int enablePin;
 	const char *name;
 	float current;
@@ -40,12 +41,12 @@ private:
 
 class MotorBoardManager {
 public:
-	static void registerBoard(int sensePin, int enablePin, MOTOR_BOARD_TYPE type, const char *name);
+	static MotorBoard *registerBoard(int sensePin, int enablePin, MOTOR_BOARD_TYPE type, const char *name);
 	static void check();
 	static void powerOnAll();
 	static void powerOffAll();
 	static void parse(const char *command);
-	static void showStatus();
+	static void showStatus(bool toSource = false);
 private:
 	static MotorBoard *boards[MAX_MOTOR_BOARDS];
 };
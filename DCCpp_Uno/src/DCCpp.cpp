@@ -151,6 +151,12 @@ DCC++ BASE STATION in split into multiple modules, each with its own header file
                     CHANNEL B of the Arduino Motor Shield's, and shut down power if a short-circuit overload
                     is detected
 
+  Tracks:           keeps the table of track outputs (MAIN, PROG and any additional power districts), each with
+                    its own Packet RegisterList, DCC signal pin and motor board
+
+  AnalogSampler:    keeps the ADC converting in the background and stores recent samples and a running
+                    baseline for each current sense pin, used by CurrentMonitor and by CV read/verify
+
   Accessories:      contains methods to operate and store the status of any optionally-defined turnouts controlled
                     by a DCC stationary accessory decoder.
 
@@ -171,6 +177,7 @@ DCC++ BASE STATION is configured through the Config.h file that contains all use
 #include "DCCpp.h"
 #include "PacketRegister.h"
 #include "CurrentMonitor.h"
+#include "AnalogSampler.h"
 #include "Sensor.h"
 #include "SerialCommand.h"
 #include "Accessories.h"
@@ -182,6 +189,9 @@ DCC++ BASE STATION is configured through the Config.h file that contains all use
 #include "CommInterfaceEthernet.h"
 #include "CommInterfaceLocalWeb.h"
 #include "GenerateDCC.h"
+#include "Tracks.h"
+#include "CommandBatch.h"
+#include "Log.h"
 
 #ifdef ENABLE_LCD
 bool lcdEnabled = false;
@@ -210,6 +220,7 @@ void loop(){
 		last = millis();
 	}
 	CommManager::update();      // check for and process any new commands
+	CommandBatch::poll();       // start committed batches and report those the generator has taken
 	if(log) Serial.printf("motorboardmanager elapsed=%d\n", micros() - start);
 	MotorBoardManager::check();
 	if(log) Serial.printf("sensor elapsed=%d\n", micros() - start);
@@ -217,6 +228,12 @@ void loop(){
 	if(log) Serial.printf("generatedccelapsed=%d\n", micros() - start);
 	GenerateDCC::loop();
 	if(log) Serial.printf("doneelapsed=%d\n", micros() - start);
+#if COMM_INTERFACE == 5
+	// print what the log recorded, as much as fits the UART buffer.  Only the local web interface leaves Serial free;
+	// with any other, Serial carries replies or the ESP link, which log lines would split, so there the log is only
+	// read with <G>
+	Log::drain(Serial.availableForWrite(), [](const char *line, int n) { Serial.write((const uint8_t *)line, n); });
+#endif
 
 } // loop
 
@@ -254,15 +271,17 @@ void setup(){
 #endif
 
 #if MOTOR_SHIELD_TYPE == 0
-  MotorBoardManager::registerBoard(CURRENT_MONITOR_PIN_MAIN, SIGNAL_ENABLE_PIN_MAIN, MOTOR_BOARD_TYPE::ARDUINO_SHIELD, "MAIN");
-  MotorBoardManager::registerBoard(CURRENT_MONITOR_PIN_PROG, SIGNAL_ENABLE_PIN_PROG, MOTOR_BOARD_TYPE::ARDUINO_SHIELD, "PROG");
+  TrackManager::registerTrack("MAIN", &mainRegs, DCC_SIGNAL_PIN_MAIN, MotorBoardManager::registerBoard(CURRENT_MONITOR_PIN_MAIN, SIGNAL_ENABLE_PIN_MAIN, MOTOR_BOARD_TYPE::ARDUINO_SHIELD, "MAIN"));
+  TrackManager::registerTrack("PROG", &progRegs, DCC_SIGNAL_PIN_PROG, MotorBoardManager::registerBoard(CURRENT_MONITOR_PIN_PROG, SIGNAL_ENABLE_PIN_PROG, MOTOR_BOARD_TYPE::ARDUINO_SHIELD, "PROG"));
 #elif MOTOR_SHIELD_TYPE == 1
-  MotorBoardManager::registerBoard(CURRENT_MONITOR_PIN_MAIN, SIGNAL_ENABLE_PIN_MAIN, MOTOR_BOARD_TYPE::POLOLU, "MAIN");
-  MotorBoardManager::registerBoard(CURRENT_MONITOR_PIN_PROG, SIGNAL_ENABLE_PIN_PROG, MOTOR_BOARD_TYPE::POLOLU, "PROG");
+  TrackManager::registerTrack("MAIN", &mainRegs, DCC_SIGNAL_PIN_MAIN, MotorBoardManager::registerBoard(CURRENT_MONITOR_PIN_MAIN, SIGNAL_ENABLE_PIN_MAIN, MOTOR_BOARD_TYPE::POLOLU, "MAIN"));
+  TrackManager::registerTrack("PROG", &progRegs, DCC_SIGNAL_PIN_PROG, MotorBoardManager::registerBoard(CURRENT_MONITOR_PIN_PROG, SIGNAL_ENABLE_PIN_PROG, MOTOR_BOARD_TYPE::POLOLU, "PROG"));
 #elif MOTOR_SHIELD_TYPE == 2
-  MotorBoardManager::registerBoard(CURRENT_MONITOR_PIN_MAIN, SIGNAL_ENABLE_PIN_MAIN, MOTOR_BOARD_TYPE::BTS7960B_5A, "MAIN");
-  MotorBoardManager::registerBoard(CURRENT_MONITOR_PIN_PROG, SIGNAL_ENABLE_PIN_PROG, MOTOR_BOARD_TYPE::ARDUINO_SHIELD, "PROG");
+  TrackManager::registerTrack("MAIN", &mainRegs, DCC_SIGNAL_PIN_MAIN, MotorBoardManager::registerBoard(CURRENT_MONITOR_PIN_MAIN, SIGNAL_ENABLE_PIN_MAIN, MOTOR_BOARD_TYPE::BTS7960B_5A, "MAIN"));
+  TrackManager::registerTrack("PROG", &progRegs, DCC_SIGNAL_PIN_PROG, MotorBoardManager::registerBoard(CURRENT_MONITOR_PIN_PROG, SIGNAL_ENABLE_PIN_PROG, MOTOR_BOARD_TYPE::ARDUINO_SHIELD, "PROG"));
 #endif
+  TrackManager::registerExtraDistricts();                  // any additional power districts from Config.h
+  AnalogSampler::begin();                                  // start background sampling of the current sense pins registered above
 
 #if COMM_INTERFACE < 4 || (COMM_INTERFACE == 4 && !defined(USE_SERIAL_FOR_WIFI))
   CommManager::registerInterface(new HardwareSerialInterface(Serial));
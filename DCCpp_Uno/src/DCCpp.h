@@ -47,6 +47,13 @@ Part of DCC++ BASE STATION for the Arduino
   #define DCC_SIGNAL_PIN_MAIN 12          // Arduino Mega - uses OC1B
   #define DCC_SIGNAL_PIN_PROG 2           // Arduino Mega - uses OC3B
   #define USE_DCC_GENERATOR_AVR 1
+#elif defined DCCPP_HOST_BUILD           // virtual track on the host, see env:native in platformio.ini
+
+  #define ARDUINO_TYPE    "HOST"
+
+  #define DCC_SIGNAL_PIN_MAIN 0
+  #define DCC_SIGNAL_PIN_PROG 1
+  #define USE_DCC_GENERATOR_HOST 1
 #elif defined ARDUINO_ARCH_ESP32
   #define ARDUINO_TYPE "ESP32"
 
@@ -58,7 +65,11 @@ Part of DCC++ BASE STATION for the Arduino
   # define CURRENT_MONITOR_PIN_MAIN A6
   # define CURRENT_MONITOR_PIN_PROG A5
 
-  #define USE_DCC_GENERATOR_ESP32 1
+  #if ESP32_DCC_GENERATOR == 1
+    #define USE_DCC_GENERATOR_ESP32_I2S 1
+  #else
+    #define USE_DCC_GENERATOR_ESP32 1
+  #endif
 #else
 
   #error CANNOT COMPILE - DCC++ ONLY WORKS WITH AN ARDUINO UNO OR AN ARDUINO MEGA 1280/2560
@@ -124,6 +135,10 @@ Part of DCC++ BASE STATION for the Arduino
   #error CANNOT COMPILE - Please select a proper value for COMM_INTERFACE in CONFIG.H file
 #endif
 
+#if defined(EXTRA_DISTRICTS) && !defined(USE_DCC_GENERATOR_ESP32)
+  #error CANNOT COMPILE - EXTRA_DISTRICTS NEEDS THE ESP32 RMT GENERATOR
+#endif
+
 /////////////////////////////////////////////////////////////////////////////////////
 // SET WHETHER TO SHOW PACKETS - DIAGNOSTIC MODE ONLY
 /////////////////////////////////////////////////////////////////////////////////////
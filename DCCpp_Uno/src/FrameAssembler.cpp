@@ -0,0 +1,32 @@
+/**********************************************************************
+
+FrameAssembler.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "FrameAssembler.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+FrameAssembler::Result FrameAssembler::feed(char ch){
+  if(ch=='<'){
+    inCommand=true;
+    overflow=false;
+    n=0;
+    return BUSY;
+  }
+  if(!inCommand)
+    return NONE;
+  if(ch=='>'){
+    inCommand=false;
+    text[n]='\0';
+    return overflow ? TOO_LONG : COMMAND;
+  }
+  if(n<FRAME_MAX_COMMAND)
+    text[n++]=ch;
+  else
+    overflow=true;
+  return BUSY;
+} // FrameAssembler::feed
@@ -0,0 +1,35 @@
+/**********************************************************************
+
+FrameAssembler.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef FrameAssembler_h
+#define FrameAssembler_h
+
+#include <stdint.h>
+
+// Collects the text between < and > of a command into a fixed buffer, one received character at a time, so that
+// interfaces need no heap.  A < always starts a new command, dropping an unfinished one.  Characters outside < >
+// are ignored.  A command longer than FRAME_MAX_COMMAND is read to its > and then reported as TOO_LONG instead
+// of being run cut short.
+
+#ifdef ARDUINO_ARCH_AVR
+  #define  FRAME_MAX_COMMAND       48      // characters between < and >
+#else
+  #define  FRAME_MAX_COMMAND       128
+#endif
+
+struct FrameAssembler{
+  enum Result{ NONE, BUSY, COMMAND, TOO_LONG };   // ch was outside < >, ch was taken, ch completed text, ch completed a command too long to keep
+  char text[FRAME_MAX_COMMAND+1];          // the command without < and >, null terminated once feed() returns COMMAND
+  uint8_t n;                               // characters in text
+  bool inCommand;
+  bool overflow;
+  FrameAssembler() : n(0), inCommand(false), overflow(false) {}
+  Result feed(char ch);
+}; // FrameAssembler
+
+#endif
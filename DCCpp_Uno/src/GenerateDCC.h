@@ -1,9 +1,19 @@
 #ifndef GENERATE_DCC_H
 #define GENERATE_DCC_H
-//These are defined either in GenerateDCC_avr or GenerateDCC_esp32.cpp
-//depending on USE_DCC_GENERATOR_AVR or USE_DCC_GENERATOR_ESP32 (from Config.h)
+//These are defined in GenerateDCC_avr, GenerateDCC_esp32.cpp, GenerateDCC_ESP32_I2S.cpp or GenerateDCC_host.cpp
+//depending on USE_DCC_GENERATOR_AVR, USE_DCC_GENERATOR_ESP32, USE_DCC_GENERATOR_ESP32_I2S or USE_DCC_GENERATOR_HOST (from DCCpp.h)
+#include <stdint.h>
 namespace GenerateDCC{
     void setup();
     void loop();
+    //Report and reset the waveform quality counters (<J>), only the ESP32 rmt generator keeps them.
+    void showStats();
+    void resetStats();
+#ifdef DCCPP_HOST_BUILD
+    //Host build only (GenerateDCC_host.cpp): generate us microseconds of simulated time, read the simulated clock, flush the stream.
+    void run(uint32_t us);
+    uint64_t now();
+    void finish();
+#endif
 }
 #endif /* end of include guard: GENERATE_DCC_H */
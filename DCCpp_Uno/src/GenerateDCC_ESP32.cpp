@@ -3,8 +3,10 @@
 #if USE_DCC_GENERATOR_ESP32
 #include "CommInterface.h"
 #include "PacketRegister.h"
-#include <array>
-#include <atomic>
+#include "RmtStream.h"
+#include "Tracks.h"
+#include "GeneratorStats.h"
+#include <esp_timer.h>
 #include <Arduino.h>
 #include <driver/rmt.h>
 constexpr uint16_t TIMER_DIVISOR = 80;  //1MHz (1us) timer count
@@ -15,49 +17,80 @@ constexpr uint64_t ONE_PERIOD = 58;
 
 namespace GenerateDCC{
     namespace {
-		constexpr rmt_item32_t createBit(uint32_t duration)
-		{
-			rmt_item32_t item ;//{ duration, duration, 1, 0};
-			item.val = (duration << 16) | duration | 1 << 15;
-			return item;
-		}
-		constexpr rmt_item32_t zero_bit = createBit(ZERO_PERIOD);
-		constexpr rmt_item32_t one_bit = createBit(ONE_PERIOD);
-		constexpr uint16_t tx_buf_size = 128;
+		// Each track's channel owns one or two rmt memory blocks (64 or 128 items) which are sent over and over with wrap around.
+		// Each time the hardware has sent half of them the tx threshold interrupt refills that half
+		// from NextBit(), so the output never stops between packets.
+		constexpr uint16_t block_items = 64;
+		// The refills are also timed against esp_timer: each half is expected to be done sending when the previous
+		// one was plus the duration of the bits put in it, anything later is refill lateness (see GeneratorStats).
+		// After an underrun the hardware has sent a half again, so the expected time is taken afresh from the clock
+		// and the read address; packet starts, timed from it, then show the gap.
 		struct dcc_generator_t {
 		    rmt_channel_t channel;
 			RegisterList volatile* packets;
-			/*std::atomic<uint16_t>*/ uint16_t tx_intr_count;
+			RmtStream stream;
+			GeneratorStats stats;
+			int64_t expected;             // when the hardware should be done with the half that is refilled next
+			uint32_t halfDuration[2];     // us it takes to send each half as last filled
+			volatile uint32_t* mem() const __attribute__ ((always_inline)) { return &RMTMEM.chan[channel].data32[0].val; }
+			// The item the hardware reads now, from the channel status (mem_raddr_ex, bits 12-21).  The address counts
+			// from the start of rmt memory, which is a whole number of channel memories, so RmtStream takes it modulo.
+			uint16_t readItem() const __attribute__ ((always_inline)) { return RMT.status_ch[channel].mem_raddr_ex; }
+			// fill() and refill() run from the interrupt, so they and everything they call are in IRAM: the GeneratorStats
+			// updates are IRAM_ATTR, the packet register and RmtStream code is always_inline.
+			void IRAM_ATTR fill(uint8_t half, int64_t start)   // start: when the hardware will begin sending the half being filled
+			{
+				uint32_t d = 0;
+				stream.fillHalf(mem(), half, [this, start, &d] () __attribute__ ((always_inline)) {
+					bool first = packets->startsPacket();
+					if(first)
+						stats.packetStart(start + d);
+					auto bit = packets->NextBit();
+					if(first && packets->startingLoad) {   // a register just loaded, micros() is esp_timer too
+						stats.loadToRail.add((uint32_t)(start + d) - packets->startingLoad);
+						packets->startingLoad = 0;
+					}
+					d += bit ? 2 * ONE_PERIOD : 2 * ZERO_PERIOD;
+					return bit;
+				});
+				halfDuration[half] = d;
+			}
+			void IRAM_ATTR refill()
+			{
+				auto now = esp_timer_get_time();
+				auto item = readItem();
+				auto half = stream.idleHalf(item);
+				auto other = half ^ 1;             // the half the hardware is sending now
+				int32_t lateness = now - expected;
+				int32_t slack = halfDuration[other];
+				bool skipped = half != stream.nextHalf;   // a threshold event was lost, other is being sent again
+				stats.refill(lateness, skipped ? 0 : slack);
+				if(skipped || lateness > slack || lateness < -slack) {
+					// the hardware is done with other once it has sent the rest of it
+					uint16_t left = stream.halfItems - item % stream.halfItems;
+					expected = now + (int64_t)slack * left / stream.halfItems;
+				} else {
+					expected += slack;
+				}
+				fill(half, expected);
+			}
 		};
 
-		dcc_generator_t p_rmt_obj[RMT_CHANNEL_MAX] = {};
+		DRAM_ATTR dcc_generator_t p_rmt_obj[MAX_TRACKS] = {};
+		DRAM_ATTR uint8_t n_generators = 0;
+		rmt_isr_handle_t isr_handle;
 
+		constexpr uint32_t IRAM_ATTR txThresholdBit(rmt_channel_t channel) { return 1u << (24 + channel); }
 
-		void fillRMTTask(void* arg)
+		void IRAM_ATTR rmtIsr(void*)
 		{
-			auto gen = reinterpret_cast<dcc_generator_t*>(arg);
-			rmt_item32_t bits_to_send[128];
-			std::fill(std::begin(bits_to_send), std::end(bits_to_send), zero_bit);
-			auto n_bits = 128;
-			while(1) { // This may look backwards, but by sending, setting up the next
-				// and then waiting for tx to be done we improve timing a little bit.
-				//Remember that the signal stays still while we are not sending...
-				auto err = rmt_write_items(gen->channel, bits_to_send, n_bits, false);
-				if(err != ESP_OK) {
-					Serial.printf("rmt_write_items failed: %d channel: %d\n", err, gen->channel);
-				}
-				auto p = gen->packets->NextPacket();
-				//Serial.printf("DCC: %d nbits %d\n", gen->channel, p->nBits);
-				if(p->nBits > 120) continue; // this will repeat the same packet again...
-				for(int b = 0; b < p->nBits; ++b) {
-					auto v = p->buf[b/8] & RegisterList::bitMask[b%8] ;
-					bits_to_send[b] = v ? one_bit : zero_bit;
-				}
-				bits_to_send[p->nBits] = one_bit; // push an extra on_bit to ensure that the packet finishs nicely.
-				n_bits = p->nBits + 1;
-				err = rmt_wait_tx_done(gen->channel, portMAX_DELAY);
-				if(err != ESP_OK) {
-					Serial.printf("rmt_wait_tx_done failed: %d channel: %d\n", err, gen->channel);
+			uint32_t status = RMT.int_st.val;
+			for(uint8_t i = 0; i < n_generators; ++i) {
+				auto& gen = p_rmt_obj[i];
+				auto bit = txThresholdBit(gen.channel);
+				if(status & bit) {
+					gen.refill();
+					RMT.int_clr.val = bit;
 				}
 			}
 		}
@@ -65,26 +98,23 @@ namespace GenerateDCC{
 
     void setup()
     {
-        mainRegs.loadPacket(1,RegisterList::idlePacket,2,0);
-        progRegs.loadPacket(1,RegisterList::idlePacket,2,0);    // load idle packet into register 1
-
-//        pinMode(DIRECTION_MOTOR_CHANNEL_PIN_A,INPUT);      // ensure this pin is not active! Direction will be controlled by DCC SIGNAL instead (below)
-//        digitalWrite(DIRECTION_MOTOR_CHANNEL_PIN_A,LOW);
-        pinMode(DCC_SIGNAL_PIN_MAIN, OUTPUT);      // THIS ARDUINO OUPUT PIN MUST BE PHYSICALLY CONNECTED TO THE PIN FOR DIRECTION-A OF MOTOR CHANNEL-A
-//        pinMode(DIRECTION_MOTOR_CHANNEL_PIN_B,INPUT);      // ensure this pin is not active! Direction will be controlled by DCC SIGNAL instead (below)
-//        digitalWrite(DIRECTION_MOTOR_CHANNEL_PIN_B,LOW);
-        pinMode(DCC_SIGNAL_PIN_PROG, OUTPUT);      // THIS ARDUINO OUTPUT PIN MUST BE PHYSICALLY CONNECTED TO THE PIN FOR DIRECTION-B OF MOTOR CHANNEL-B
-
-		p_rmt_obj[0].packets = &mainRegs;
-		p_rmt_obj[1].packets = &progRegs;
+		// The 8 rmt memory blocks are shared out between the tracks: two per channel for up to 4 tracks, otherwise one.
+		const uint8_t mem_blocks = TrackManager::nTracks <= RMT_CHANNEL_MAX / 2 ? 2 : 1;
+		for(uint8_t t = 0; t < TrackManager::nTracks; ++t) {
+			auto& track = TrackManager::tracks[t];
+			track.regs->loadPacket(1,RegisterList::idlePacket,2,0);    // load idle packet into register 1
+			pinMode(track.signalPin, OUTPUT);      // THIS ARDUINO OUPUT PIN MUST BE PHYSICALLY CONNECTED TO THE DIRECTION PIN OF THE TRACK'S MOTOR BOARD
 
-		for(int c = 0; c < 2; ++c) {
+			auto& gen = p_rmt_obj[t];
+			gen.channel = (rmt_channel_t)(t * mem_blocks);
+			gen.packets = track.regs;
+			gen.stream = RmtStream{rmtBitItem(ONE_PERIOD), rmtBitItem(ZERO_PERIOD), (uint16_t)(mem_blocks * block_items / 2)};
 			rmt_config_t c1_config = {
 				/*.rmt_mode =*/ RMT_MODE_TX,
-				/*.channel = */c == 0 ? RMT_CHANNEL_0 : RMT_CHANNEL_4,
+				/*.channel = */gen.channel,
 				/*.clk_div = */TIMER_DIVISOR,
-				/*.gpio_num = */(gpio_num_t)(c == 0 ? DCC_SIGNAL_PIN_MAIN : DCC_SIGNAL_PIN_PROG),
-				/*.mem_block_num = */(uint8_t)(2), // have two rtmem block of 64 32 bit words. (space for 128 bits)
+				/*.gpio_num = */(gpio_num_t)track.signalPin,
+				/*.mem_block_num = */mem_blocks,
 				/*.tx_config =*/ {
 					/*.loop_en =*/ false,          /*!< RMT loop output mode*/
 	    			/*.carrier_freq_hz =*/ 0,      /*!< RMT carrier frequency */
@@ -95,28 +125,43 @@ namespace GenerateDCC{
 					/*.idle_output_en = */false
 				}
 			};
-			p_rmt_obj[c].channel = c1_config.channel;
-			rmt_config(&c1_config);
-			auto intr_alloc_flags = ESP_INTR_FLAG_IRAM | ESP_INTR_FLAG_LOWMED | ESP_INTR_FLAG_LEVEL3;
-			auto err = rmt_driver_install(c1_config.channel, 0, 0);
-			if(err != ESP_OK) Serial.printf("Failed to install driver: %d\n", err);
-			char tn[] = "FILLRMT0";
-			tn[8] += c;
-			// spawn a task
-			err = xTaskCreate(    &fillRMTTask,
-	                            tn,
-                              5* 1024,
-	                            p_rmt_obj + c,
-	                            1, //UBaseType_t uxPriority,
-	                            nullptr//TaskHandle_t *pxCreatedTask
-	                          );
-
-			if(err != pdPASS) Serial.printf("Failed to start task driver: %d\n", err);
+			auto err = rmt_config(&c1_config);
+			if(err != ESP_OK) Serial.printf("Failed to configure rmt: %d channel: %d\n", err, gen.channel);
+			// No rmt_driver_install, the driver's own isr would compete with ours for the threshold events.
+			RMT.apb_conf.fifo_mask = RMT_DATA_MODE_MEM;
+			RMT.apb_conf.mem_tx_wrap_en = 1;
+			gen.stats.reset();
+			auto start = esp_timer_get_time();
+			gen.fill(0, start);
+			gen.fill(1, start + gen.halfDuration[0]);
+			rmt_set_tx_intr_en(gen.channel, false);
+			rmt_set_tx_thr_intr_en(gen.channel, true, gen.stream.halfItems);
+		}
+		n_generators = TrackManager::nTracks;
+		// ESP_INTR_FLAG_IRAM: the refill keeps running while the flash cache is off for EEPROM commits and OTA writes,
+		// which would otherwise hold it off for long enough to resend stale halves.  Threshold events still pending
+		// when it does run late are taken as one; refill() finds the half to fill from the read address.
+		auto err = rmt_isr_register(&rmtIsr, nullptr, ESP_INTR_FLAG_IRAM | ESP_INTR_FLAG_LEVEL3, &isr_handle);
+		if(err != ESP_OK) Serial.printf("Failed to register rmt isr: %d\n", err);
+		for(uint8_t t = 0; t < n_generators; ++t) {
+			p_rmt_obj[t].expected = esp_timer_get_time() + p_rmt_obj[t].halfDuration[0];
+			rmt_tx_start(p_rmt_obj[t].channel, true);
 		}
     }
+
+    void showStats()
+    {
+		for(uint8_t t = 0; t < n_generators; ++t)
+			p_rmt_obj[t].stats.show(TrackManager::tracks[t].name);
+    }
+
+    void resetStats()
+    {
+		for(uint8_t t = 0; t < n_generators; ++t)
+			p_rmt_obj[t].stats.reset();
+    }
     void loop()
     {
-	//	try_fill_buffer(&p_rmt_obj[0]);
 	}
 
 }
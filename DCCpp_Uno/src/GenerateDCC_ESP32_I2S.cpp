@@ -0,0 +1,91 @@
+#include "DCCpp.h"
+#include "GenerateDCC.h"
+#if USE_DCC_GENERATOR_ESP32_I2S
+#include "PacketRegister.h"
+#include "I2sEncoder.h"
+#include <Arduino.h>
+#include <driver/i2s.h>
+
+// Alternative to the RMT generator: each track output is driven by the data pin of one I2S peripheral,
+// sending 1 sample every 2us. A task encodes REFILL_WORDS at a time from the RegisterList and hands them
+// to the DMA, so the cpu is only involved once every few milliseconds.
+// Note that the encoder runs ahead of the rails by up to (DMA_BUF_COUNT + 1) buffers (~16ms), the ACK
+// detection in readCV sees the packets leave the RegisterList that much before they reach the track.
+
+namespace GenerateDCC{
+    namespace {
+		constexpr uint32_t SAMPLE_RATE = 1000000 / I2S_SAMPLE_US / 32;  // 16 bit stereo frames, 32 samples each
+		constexpr int DMA_BUF_COUNT = 3;
+		constexpr int DMA_BUF_FRAMES = 64;
+		constexpr size_t REFILL_WORDS = DMA_BUF_FRAMES;          // one frame is one 32 bit word
+
+		struct dcc_lane_t {
+			i2s_port_t port;
+			RegisterList volatile* packets;
+			int pin;
+			I2sEncoder encoder;
+		};
+
+		dcc_lane_t lanes[2] = {
+			{ I2S_NUM_0, &mainRegs, DCC_SIGNAL_PIN_MAIN, {} },
+			{ I2S_NUM_1, &progRegs, DCC_SIGNAL_PIN_PROG, {} },
+		};
+
+		void refillTask(void* arg)
+		{
+			auto lane = reinterpret_cast<dcc_lane_t*>(arg);
+			uint32_t words[REFILL_WORDS];
+			while(1) {
+				lane->encoder.encode(words, REFILL_WORDS, [lane] { return lane->packets->NextBit(); });
+				// In 16 bit mode the sample at the higher address goes out first, so the high half
+				// of each little endian word is sent first and the bits come out in encoder order.
+				size_t written = 0;
+				auto err = i2s_write(lane->port, words, sizeof(words), &written, portMAX_DELAY);
+				if(err != ESP_OK) {
+					Serial.printf("i2s_write failed: %d port: %d\n", err, lane->port);
+				}
+			}
+		}
+    }
+
+    void setup()
+    {
+        mainRegs.loadPacket(1,RegisterList::idlePacket,2,0);
+        progRegs.loadPacket(1,RegisterList::idlePacket,2,0);    // load idle packet into register 1
+
+		for(auto& lane : lanes) {
+			i2s_config_t config = {
+				/*.mode =*/ (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX),
+				/*.sample_rate =*/ SAMPLE_RATE,
+				/*.bits_per_sample =*/ I2S_BITS_PER_SAMPLE_16BIT,
+				/*.channel_format =*/ I2S_CHANNEL_FMT_RIGHT_LEFT,
+				/*.communication_format =*/ (i2s_comm_format_t)I2S_COMM_FORMAT_I2S_MSB,
+				/*.intr_alloc_flags =*/ 0,
+				/*.dma_buf_count =*/ DMA_BUF_COUNT,
+				/*.dma_buf_len =*/ DMA_BUF_FRAMES,
+				/*.use_apll =*/ false,
+				/*.tx_desc_auto_clear =*/ true       // send zeros rather than stale samples if the task falls behind
+			};
+			i2s_pin_config_t pins = {
+				/*.bck_io_num =*/ I2S_PIN_NO_CHANGE,
+				/*.ws_io_num =*/ I2S_PIN_NO_CHANGE,
+				/*.data_out_num =*/ lane.pin,
+				/*.data_in_num =*/ I2S_PIN_NO_CHANGE
+			};
+			auto err = i2s_driver_install(lane.port, &config, 0, nullptr);
+			if(err != ESP_OK) Serial.printf("Failed to install i2s driver: %d\n", err);
+			err = i2s_set_pin(lane.port, &pins);
+			if(err != ESP_OK) Serial.printf("Failed to set i2s pin: %d\n", err);
+			char tn[] = "FILLI2S0";
+			tn[7] += lane.port;
+			err = xTaskCreate(&refillTask, tn, 3 * 1024, &lane, 2, nullptr);
+			if(err != pdPASS) Serial.printf("Failed to start task driver: %d\n", err);
+		}
+    }
+    void loop()
+    {
+	}
+
+}
+
+#endif
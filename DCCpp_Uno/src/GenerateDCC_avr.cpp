@@ -161,38 +161,25 @@ namespace GenerateDCC {
 // that can be invoked with proper paramters for each interrupt.  This slightly increases the size of the code base by duplicating
 // some of the logic for each interrupt, but saves additional time.
 
-// As structured, the interrupt code below completes at an average of just under 6 microseconds with a worse-case of just under 11 microseconds
-// when a new register is loaded and the logic needs to switch active register packet pointers.
+// The bit to send next is prepared at the end of the previous interrupt, so the OCRA and OCRB registers are always written
+// a fixed number of cycles after the interrupt fires.  Only then is the following bit taken from the RegisterList with NextBit(),
+// the same state machine the ESP32 generators use.  NextBit() shifts the bit out of a one byte shift register and only
+// every eighth bit moves its byte cursor, or at the end of a packet calls NextPacket() to pick the next register or sequence packet.
+// Switching packets therefore costs at most one bit period of slack instead of delaying the compare register update.
 
-// THE INTERRUPT CODE MACRO:  R=REGISTER LIST (mainRegs or progRegs), and N=TIMER (0 or 1)
+// THE INTERRUPT CODE MACRO:  R=REGISTER LIST (mainRegs or progRegs), and N=TIMER (0, 1 or 3)
 
 #define DCC_SIGNAL(R,N) \
-  if(R.currentBit==R.currentReg->activePacket->nBits){    /* IF no more bits in this DCC Packet */ \
-    R.currentBit=0;                                       /*   reset current bit pointer and determine which Register and Packet to process next--- */ \
-    if(R.nRepeat>0 && R.currentReg==R.reg){               /*   IF current Register is first Register AND should be repeated */ \
-      R.nRepeat--;                                        /*     decrement repeat count; result is this same Packet will be repeated */ \
-    } else if(R.nextReg!=NULL){                           /*   ELSE IF another Register has been updated */ \
-      R.currentReg=R.nextReg;                             /*     update currentReg to nextReg */ \
-      R.nextReg=NULL;                                     /*     reset nextReg to NULL */ \
-      R.tempPacket=R.currentReg->activePacket;            /*     flip active and update Packets */ \
-      R.currentReg->activePacket=R.currentReg->updatePacket; \
-      R.currentReg->updatePacket=R.tempPacket; \
-    } else{                                               /*   ELSE simply move to next Register */ \
-      if(R.currentReg==R.maxLoadedReg)                    /*     BUT IF this is last Register loaded */ \
-        R.currentReg=R.reg;                               /*       first reset currentReg to base Register, THEN */ \
-      R.currentReg++;                                     /*     increment current Register (note this logic causes Register[0] to be skipped when simply cycling through all Registers) */ \
-    }                                                     /*   END-ELSE */ \
-  }                                                       /* END-IF: currentReg, activePacket, and currentBit should now be properly set to point to next DCC bit */ \
+  static byte pendingBit;                                 /* bit prepared by the previous interrupt */ \
+  if(pendingBit){                                         /* IF bit is a ONE */ \
+    OCR ## N ## A=DCC_ONE_BIT_TOTAL_DURATION_TIMER ## N;  /*   set OCRA for timer N to full cycle duration of DCC ONE bit */ \
+    OCR ## N ## B=DCC_ONE_BIT_PULSE_DURATION_TIMER ## N;  /*   set OCRB for timer N to half cycle duration of DCC ONE but */ \
+  } else{                                                 /* ELSE it is a ZERO */ \
+    OCR ## N ## A=DCC_ZERO_BIT_TOTAL_DURATION_TIMER ## N; /*   set OCRA for timer N to full cycle duration of DCC ZERO bit */ \
+    OCR ## N ## B=DCC_ZERO_BIT_PULSE_DURATION_TIMER ## N; /*   set OCRB for timer N to half cycle duration of DCC ZERO bit */ \
+  }                                                       /* END-ELSE */ \
                                                           \
-  if(R.currentReg->activePacket->buf[R.currentBit/8] & R.bitMask[R.currentBit%8]){     /* IF bit is a ONE */ \
-    OCR ## N ## A=DCC_ONE_BIT_TOTAL_DURATION_TIMER ## N;                               /*   set OCRA for timer N to full cycle duration of DCC ONE bit */ \
-    OCR ## N ## B=DCC_ONE_BIT_PULSE_DURATION_TIMER ## N;                               /*   set OCRB for timer N to half cycle duration of DCC ONE but */ \
-  } else{                                                                              /* ELSE it is a ZERO */ \
-    OCR ## N ## A=DCC_ZERO_BIT_TOTAL_DURATION_TIMER ## N;                              /*   set OCRA for timer N to full cycle duration of DCC ZERO bit */ \
-    OCR ## N ## B=DCC_ZERO_BIT_PULSE_DURATION_TIMER ## N;                              /*   set OCRB for timer N to half cycle duration of DCC ZERO bit */ \
-  }                                                                                    /* END-ELSE */ \
-                                                                                       \
-  R.currentBit++;                                         /* point to next bit in current Packet */
+  pendingBit=R.NextBit();                                 /* prepare the bit for the next interrupt */
 
 ///////////////////////////////////////////////////////////////////////////////
 
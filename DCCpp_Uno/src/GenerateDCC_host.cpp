@@ -0,0 +1,94 @@
+#include "DCCpp.h"
+#include "GenerateDCC.h"
+#if USE_DCC_GENERATOR_HOST
+#include "PacketRegister.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// The virtual track: the bits of mainRegs and progRegs are generated against a simulated clock instead of timers,
+// as fast as the host can run, and every half-bit is written to a binary stream.  The stream goes to the file named
+// by the DCCPP_TRACK_OUT environment variable, or to stdout.
+//
+// Stream format: the 4 byte header "DCC1", then one byte per half-bit holding its duration in microseconds
+// (58 for a ONE, 100 for a ZERO, always below 0x80).  Each track starts high and alternates level every half-bit.
+// A byte 0x80+N means that the following half-bits belong to track N (0=MAIN, 1=PROG).  Tracks are interleaved in
+// the order their bits start on the simulated clock.
+
+#define DCC_HOST_LOOP_US  1000     // simulated time generated by each call to GenerateDCC::loop()
+
+namespace GenerateDCC{
+    namespace {
+        constexpr uint8_t ONE_HALF_US = 58;
+        constexpr uint8_t ZERO_HALF_US = 100;
+
+        struct virtual_track_t {
+            RegisterList volatile* packets;
+            uint64_t time;     // simulated time the track has been generated up to
+        };
+
+        virtual_track_t tracks[2] = { { &mainRegs, 0 }, { &progRegs, 0 } };
+        uint64_t sim_clock = 0;
+        FILE* out = nullptr;
+        int lastTrack = -1;
+
+        void emitBit(int t, bool one)
+        {
+            if(t != lastTrack) {
+                putc(0x80 + t, out);
+                lastTrack = t;
+            }
+            auto d = one ? ONE_HALF_US : ZERO_HALF_US;
+            putc(d, out);
+            putc(d, out);
+        }
+    }
+
+    void setup()
+    {
+        mainRegs.loadPacket(1,RegisterList::idlePacket,2,0);    // load idle packet into register 1
+        progRegs.loadPacket(1,RegisterList::idlePacket,2,0);
+
+        auto name = getenv("DCCPP_TRACK_OUT");
+        out = name ? fopen(name, "wb") : stdout;
+        if(!out) {
+            perror(name);
+            exit(1);
+        }
+        fwrite("DCC1", 1, 4, out);
+    }
+
+    void run(uint32_t us)
+    {
+        sim_clock += us;
+        while(true) {                  // always extend the track that is furthest behind, so the stream stays in time order
+            virtual_track_t* next = nullptr;
+            for(auto& t : tracks)
+                if(t.time < sim_clock && (!next || t.time < next->time))
+                    next = &t;
+            if(!next)
+                break;
+            bool one = next->packets->NextBit();
+            emitBit(next - tracks, one);
+            next->time += 2 * (one ? ONE_HALF_US : ZERO_HALF_US);
+        }
+    }
+
+    uint64_t now()
+    {
+        return sim_clock;
+    }
+
+    void finish()
+    {
+        fflush(out);
+        if(out != stdout)
+            fclose(out);
+    }
+
+    void loop()
+    {
+        run(DCC_HOST_LOOP_US);
+    }
+}
+
+#endif
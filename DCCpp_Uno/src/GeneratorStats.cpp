@@ -0,0 +1,72 @@
+/**********************************************************************
+
+GeneratorStats.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include <stdio.h>
+#include "GeneratorStats.h"
+#include "CommInterface.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+  // Appends the bins to the n characters in line, closes it with '>' and sends it to the interface that asked.
+  void respondWithBins(char *line, int n, const uint32_t *bins){
+    for(uint8_t i=0;i<GEN_STATS_BINS && n>=0 && n<PRINTF_MAX;i++)
+      n+=snprintf(line+n, PRINTF_MAX-n, " %lu", (unsigned long)bins[i]);
+    if(n>=0 && n<PRINTF_MAX-1){
+      line[n]='>';
+      line[n+1]='\0';
+      CommManager::respond("%s", line);
+    }
+  }
+}
+
+void showHistogram(const char *head, const uint32_t *bins, uint32_t count, uint32_t max){
+  char line[PRINTF_MAX];
+  respondWithBins(line, snprintf(line, sizeof(line), "<%s %lu %lu", head, (unsigned long)count, (unsigned long)max), bins);
+} // showHistogram
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GeneratorStats::reset(){
+  refillLateness.reset();
+  packetInterval.reset();
+  loadToRail.reset();
+  underruns=0;
+  lastPacketStart=0;
+} // GeneratorStats::reset
+
+///////////////////////////////////////////////////////////////////////////////
+
+void IRAM_ATTR GeneratorStats::refill(int32_t lateness, uint32_t slack){
+  if(lateness<0)                         // early (timer and rmt clocks are not quite in step), count as on time
+    lateness=0;
+  refillLateness.add(lateness);
+  if((uint32_t)lateness>slack)
+    underruns++;
+} // GeneratorStats::refill
+
+///////////////////////////////////////////////////////////////////////////////
+
+void IRAM_ATTR GeneratorStats::packetStart(int64_t time){
+  if(lastPacketStart!=0)
+    packetInterval.add((uint32_t)(time-lastPacketStart));
+  lastPacketStart=time;
+} // GeneratorStats::packetStart
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GeneratorStats::show(const char *name) const{
+  char line[PRINTF_MAX];
+  respondWithBins(line, snprintf(line, sizeof(line), "<JL %s %lu %lu %lu", name, (unsigned long)refillLateness.count,
+    (unsigned long)refillLateness.max, (unsigned long)underruns), refillLateness.bins);
+  char head[24];
+  snprintf(head, sizeof(head), "JP %s", name);
+  packetInterval.show(head);
+  snprintf(head, sizeof(head), "JR %s", name);
+  loadToRail.show(head);
+} // GeneratorStats::show
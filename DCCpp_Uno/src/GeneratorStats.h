@@ -0,0 +1,62 @@
+/**********************************************************************
+
+GeneratorStats.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef GeneratorStats_h
+#define GeneratorStats_h
+
+#include <stdint.h>
+#ifdef ARDUINO_ARCH_ESP32
+#include <esp_attr.h>
+#endif
+#ifndef IRAM_ATTR
+#define IRAM_ATTR                          // only the ESP32 puts interrupt code apart
+#endif
+
+// Waveform quality counters kept by a DCC generator for each track output, reported by the <J> command.
+// Updating them costs a shift, a compare and a few increments, cheap enough to be done from the refill interrupt,
+// and the updates are in IRAM so that the interrupt can run while the flash cache is off.
+// Nothing here depends on the Arduino core.
+
+#define  GEN_STATS_BINS            16
+
+void showHistogram(const char *head, const uint32_t *bins, uint32_t count, uint32_t max);   // <HEAD COUNT MAX B0 ... B15>, to the asker
+
+template<uint8_t Shift>
+struct Histogram{
+  uint32_t bins[GEN_STATS_BINS];           // bin i counts values in [i << Shift, (i+1) << Shift), the last bin everything above
+  uint32_t count;
+  uint32_t max;
+  void reset(){
+    for(uint8_t i=0;i<GEN_STATS_BINS;i++)
+      bins[i]=0;
+    count=0;
+    max=0;
+  }
+  void add(uint32_t v) __attribute__ ((always_inline)){
+    uint32_t b=v>>Shift;
+    bins[b<GEN_STATS_BINS ? b : GEN_STATS_BINS-1]++;
+    count++;
+    if(v>max)
+      max=v;
+  }
+  void show(const char *head) const { showHistogram(head,bins,count,max); }
+}; // Histogram
+
+struct GeneratorStats{
+  Histogram<3> refillLateness;             // us from when the hardware ran out of a half buffer to the refill, 8us bins
+  Histogram<10> packetInterval;            // us between the starts of consecutive packets on the rails, 1024us bins
+  Histogram<10> loadToRail;                // us from a register being loaded to the first bit of its packet on the rails, 1024us bins
+  uint32_t underruns;                      // refills so late that the hardware had already resent stale bits
+  int64_t lastPacketStart;                 // 0 until the first packet has been seen
+  void reset();
+  void refill(int32_t lateness, uint32_t slack);   // slack: us the other half buffer covers
+  void packetStart(int64_t time);
+  void show(const char *name) const;
+}; // GeneratorStats
+
+#endif
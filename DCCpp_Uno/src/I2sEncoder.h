@@ -0,0 +1,47 @@
+#ifndef I2S_ENCODER_H
+#define I2S_ENCODER_H
+//Turns the bits coming out of a RegisterList into a DCC waveform sampled every I2S_SAMPLE_US,
+//packed 32 samples to a word with the first sample in the most significant bit.
+//Runs of equal samples are written a word at a time, so the cost is per half-bit rather than per sample.
+//Nothing here touches the I2S peripheral, so it can be run on a host build.
+#include <stddef.h>
+#include <stdint.h>
+
+namespace GenerateDCC {
+	constexpr uint32_t I2S_SAMPLE_US = 2;
+	constexpr uint8_t I2S_ONE_SAMPLES = 58 / I2S_SAMPLE_US;   // 29 samples, 58us
+	constexpr uint8_t I2S_ZERO_SAMPLES = 100 / I2S_SAMPLE_US; // 50 samples, 100us
+
+	struct I2sEncoder {
+		uint8_t remaining = 0; // samples left in the current half-bit
+		uint8_t halves = 0;    // half-bits left in the current bit after the current one
+		uint8_t halfLength = 0;
+
+		//Fill nWords words, calling nextBit() each time a new DCC bit is started.
+		template<class NextBit>
+		void encode(uint32_t* words, size_t nWords, NextBit&& nextBit)
+		{
+			for(size_t i = 0; i < nWords; ++i) {
+				uint32_t word = 0;
+				uint8_t free = 32;
+				while(free) {
+					if(remaining == 0) {
+						if(halves == 0) {
+							halfLength = nextBit() ? I2S_ONE_SAMPLES : I2S_ZERO_SAMPLES;
+							halves = 2;
+						}
+						remaining = halfLength;
+						--halves;
+					}
+					uint8_t n = remaining < free ? remaining : free;
+					free -= n;
+					remaining -= n;
+					if(halves == 1) // first half of the bit is high
+						word |= (n == 32 ? 0xffffffffu : ((1u << n) - 1)) << free;
+				}
+				words[i] = word;
+			}
+		}
+	};
+}
+#endif /* end of include guard: I2S_ENCODER_H */
@@ -0,0 +1,76 @@
+/**********************************************************************
+
+Journal.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "Journal.h"
+#include "Arduino.h"
+#include <stdio.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+void Journal::record(char kind, int id, int value, int8_t direction, const char *name){
+  uint8_t gone=count;
+  for(uint8_t i=0;i<count;i++){
+    const JournalEntry &e=entries[i];
+    if(e.kind==kind && (kind=='p' ? e.name==name : e.id==id))
+      gone=i;                              // replaced by this change
+  }
+  if(gone==count && count==JOURNAL_ENTRIES){
+    gone=0;                                // full: the oldest entry goes while still current
+    lost=entries[0].seq;
+  }
+  if(gone<count){
+    memmove(entries+gone,entries+gone+1,(count-gone-1)*sizeof(JournalEntry));
+    count--;
+  }
+  JournalEntry &e=entries[count++];
+  e.seq=++seq;
+  e.kind=kind;
+  e.id=id;
+  e.value=value;
+  e.direction=direction;
+  e.name=name;
+} // Journal::record
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Taken from micros() the first time a client asks for it, which depends on when the network brought that
+// client's <V> rather than on how long the boot took.
+
+uint16_t Journal::epoch(){
+  if(bootEpoch==0){
+    unsigned long t=micros();
+    bootEpoch=(uint16_t)(t^(t>>16));
+    if(bootEpoch==0)
+      bootEpoch=1;
+  }
+  return bootEpoch;
+} // Journal::epoch
+
+///////////////////////////////////////////////////////////////////////////////
+
+int Journal::format(const JournalEntry &e, char *buf, size_t n){
+  switch(e.kind){
+    case 'T':
+      return snprintf(buf,n,"<T %d %d %d>",e.id,e.value,e.direction);
+    case 'Q':
+      return snprintf(buf,n,"<%c %d>",e.value ? 'Q' : 'q',e.id);
+    case 'p':
+      return e.name ? snprintf(buf,n,"<p%d %s>",e.value,e.name) : snprintf(buf,n,"<p%d>",e.value);
+    default:
+      return snprintf(buf,n,"<%c %d %d>",e.kind,e.id,e.value);
+  }
+} // Journal::format
+
+///////////////////////////////////////////////////////////////////////////////
+
+JournalEntry Journal::entries[JOURNAL_ENTRIES];
+uint32_t Journal::seq=0;
+uint32_t Journal::lost=0;
+uint8_t Journal::count=0;
+uint16_t Journal::bootEpoch=0;
@@ -0,0 +1,59 @@
+/**********************************************************************
+
+Journal.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef Journal_h
+#define Journal_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Numbered record of the last state changes (throttles, turnouts, outputs, sensors and track power), so that a
+// client that lost its connection for a moment can ask for what changed since the last number it saw, <V EPOCH N>,
+// instead of reading everything again.  A change replaces an older journal entry about the same thing, so the
+// journal holds at most one entry per throttle, turnout, output, sensor or motor board, and the entries after it
+// move down to keep the journal in order with no gaps.  When the journal is full the oldest entry goes, and
+// clients that have not seen it need a full snapshot again (see covers()).  The numbers start again at each boot,
+// so they are only meaningful together with epoch(), which is different each time.
+
+#ifdef ARDUINO_ARCH_AVR
+  #define  JOURNAL_ENTRIES         16
+#else
+  #define  JOURNAL_ENTRIES         64
+#endif
+
+struct JournalEntry{
+  uint32_t seq;                            // number of the change
+  char kind;                               // letter of the reply that reports it: T, H, Y, Q (with value 0 for q) or p
+  int id;                                  // cab, turnout, output or sensor
+  int value;                               // speed, throw, state, active or power (0 off, 1 on, 2 overcurrent)
+  int8_t direction;                        // T only
+  const char *name;                        // p only: name of the motor board, NULL for all of them
+}; // JournalEntry
+
+struct Journal{
+  static JournalEntry entries[JOURNAL_ENTRIES];   // oldest first
+  static uint32_t seq;                     // number of the latest change
+  static uint32_t lost;                    // highest number dropped while still current
+  static uint8_t count;                    // entries in use
+  static uint16_t bootEpoch;               // 0 until epoch() is first asked for
+  static void record(char kind, int id, int value, int8_t direction = 0, const char *name = NULL);
+  static uint16_t epoch();                 // the number of this boot, never 0
+  static bool covers(uint32_t since){ return since>=lost; }   // the journal holds every change after since
+  static int format(const JournalEntry &e, char *buf, size_t n);   // the reply that reports e, as snprintf
+  template<class F> static void since(uint32_t n, F &&f);   // calls f(const JournalEntry &) for each entry after n, oldest first
+}; // Journal
+
+///////////////////////////////////////////////////////////////////////////////
+
+template<class F> void Journal::since(uint32_t n, F &&f){
+  for(uint8_t i=0;i<count;i++)
+    if(entries[i].seq>n)
+      f(entries[i]);
+} // Journal::since
+
+#endif
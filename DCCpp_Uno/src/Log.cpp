@@ -0,0 +1,116 @@
+/**********************************************************************
+
+Log.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include <Arduino.h>
+#include "Log.h"
+#include <stdio.h>
+
+#if LOG_RECORDING
+
+// The web server tasks of the ESP32 record too, so the ring is only touched with the other core kept out.
+#ifdef ARDUINO_ARCH_ESP32
+  static portMUX_TYPE logMux=portMUX_INITIALIZER_UNLOCKED;
+  #define  LOG_LOCK()              portENTER_CRITICAL(&logMux)
+  #define  LOG_UNLOCK()            portEXIT_CRITICAL(&logMux)
+#else
+  #define  LOG_LOCK()
+  #define  LOG_UNLOCK()
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+void Log::put(uint8_t format, uint8_t n, const int32_t *args){
+  uint32_t time=micros();
+  LOG_LOCK();
+  LogEntry &e=entries[count%LOG_ENTRIES];
+  e.time=time;
+  e.format=format;
+  e.n=n;
+  for(uint8_t i=0;i<n;i++)
+    e.args[i]=args[i];
+  count++;
+  if(held<LOG_ENTRIES)
+    held++;
+  if(pending<LOG_ENTRIES)
+    pending++;
+  else
+    dropped++;
+  LOG_UNLOCK();
+} // Log::put
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool Log::get(uint16_t i, LogEntry &e){
+  LOG_LOCK();
+  bool ok=i<held;
+  if(ok)
+    e=entries[(count-held+i)%LOG_ENTRIES];
+  LOG_UNLOCK();
+  return ok;
+} // Log::get
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool Log::peek(LogEntry &e, uint32_t &number){
+  LOG_LOCK();
+  bool ok=pending>0;
+  if(ok){
+    number=count-pending;
+    e=entries[number%LOG_ENTRIES];
+  }
+  LOG_UNLOCK();
+  return ok;
+} // Log::peek
+
+///////////////////////////////////////////////////////////////////////////////
+
+void Log::printed(uint32_t number){
+  LOG_LOCK();
+  if(pending>0 && count-pending==number)   // not overwritten while it was printed
+    pending--;
+  LOG_UNLOCK();
+} // Log::printed
+
+///////////////////////////////////////////////////////////////////////////////
+
+int Log::format(const LogEntry &e, char *buf, size_t n){
+  int32_t a[LOG_MAX_ARGS]={0};
+  for(uint8_t i=0;i<e.n && i<LOG_MAX_ARGS;i++)
+    a[i]=e.args[i];
+  int t=snprintf(buf,n,"%10lu ",(unsigned long)e.time);
+  if(t<0 || (size_t)t>=n)
+    return t;
+  buf+=t;
+  n-=t;
+  switch(e.format){
+    case LOG_COMMAND:
+      return t+snprintf(buf,n,"command %c, %ld characters\n",(char)a[0],(long)a[1]);
+    case LOG_THROTTLE:
+      return t+snprintf(buf,n,"throttle register %ld cab %ld speed %ld direction %ld\n",(long)a[0],(long)a[1],(long)a[2],(long)a[3]);
+    case LOG_QUEUED:
+      return t+snprintf(buf,n,"queued command %c, %ld pending\n",(char)a[0],(long)a[1]);
+    case LOG_CAB_CLIENT:
+      return t+snprintf(buf,n,"cab client %ld event %ld\n",(long)a[0],(long)a[1]);
+    case LOG_CAB_FRAME:
+      return t+snprintf(buf,n,"cab client %ld frame at %ld length %ld final %ld\n",(long)a[0],(long)a[1],(long)a[2],(long)a[3]);
+    case LOG_CAB_MESSAGE:
+      return t+snprintf(buf,n,"cab message %c\n",(char)a[0]);
+    default:
+      return t+snprintf(buf,n,"format %d: %ld %ld %ld %ld\n",e.format,(long)a[0],(long)a[1],(long)a[2],(long)a[3]);
+  }
+} // Log::format
+
+///////////////////////////////////////////////////////////////////////////////
+
+LogEntry Log::entries[LOG_ENTRIES];
+uint32_t Log::count=0;
+uint16_t Log::held=0;
+uint16_t Log::pending=0;
+uint32_t Log::dropped=0;
+
+#endif
@@ -0,0 +1,120 @@
+/**********************************************************************
+
+Log.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef Log_h
+#define Log_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Diagnostic log that costs the command path about as much as a few stores.  LOG() keeps a record of a format
+// number and up to LOG_MAX_ARGS numbers in a ring of LOG_ENTRIES; nothing is formatted or printed there.  With
+// the local web interface, where Serial carries no replies, the main loop prints pending records to Serial later,
+// only as much as the UART buffer takes without blocking (see drain()).  <G> returns the raw records for a host
+// to decode with Log::format.  When the ring is full the oldest record is overwritten.
+//
+// LOG_LEVEL and LOG_MODULES select at compile time what is recorded at all: a LOG() whose module is not in
+// LOG_MODULES or whose level is above LOG_LEVEL compiles to nothing.  Both can be set with build flags, for
+// example -DLOG_LEVEL=LOG_WARN or -DLOG_MODULES=(LOG_THROTTLES|LOG_CABS).
+
+#define  LOG_ERROR                 1
+#define  LOG_WARN                  2
+#define  LOG_INFO                  3
+#define  LOG_DEBUG                 4
+
+#define  LOG_COMMANDS              0x01    // commands read by SerialCommand
+#define  LOG_THROTTLES             0x02    // throttle packets loaded by RegisterList
+#define  LOG_WEB                   0x04    // commands queued by the web server (DCCpp_ESP)
+#define  LOG_CABS                  0x08    // cab websocket (CabCache)
+#define  LOG_ALL                   0xFF
+
+#ifdef ARDUINO_ARCH_AVR
+  #define  LOG_ENTRIES             8
+  #ifndef LOG_LEVEL
+    #define  LOG_LEVEL             LOG_INFO
+  #endif
+#else
+  #define  LOG_ENTRIES             128
+  #ifndef LOG_LEVEL
+    #define  LOG_LEVEL             LOG_DEBUG
+  #endif
+#endif
+#ifndef LOG_MODULES
+  #define  LOG_MODULES             LOG_ALL
+#endif
+#define  LOG_MAX_ARGS              4
+#define  LOG_LINE_MAX              80      // longest line format() writes, including the newline
+
+// Every LOG() so far is at LOG_DEBUG, so with a lower LOG_LEVEL, as on the AVR, nothing can be recorded: then the
+// ring and <G> are left out of the build, and LOG() and drain() do nothing.
+#define  LOG_RECORDING             (LOG_LEVEL>=LOG_DEBUG && LOG_MODULES!=0)
+
+#if LOG_RECORDING
+  #define LOG(module, level, format, ...) \
+    do{ if(((module) & LOG_MODULES) && (level)<=LOG_LEVEL) Log::record(format, ##__VA_ARGS__); }while(0)
+#else
+  #define LOG(module, level, format, ...) do{}while(0)
+#endif
+
+enum LogFormat : uint8_t{                  // the texts are in Log::format
+  LOG_COMMAND,                             // letter, length
+  LOG_THROTTLE,                            // register, cab, speed, direction
+  LOG_QUEUED,                              // letter, commands pending
+  LOG_CAB_CLIENT,                          // client, event (AwsEventType)
+  LOG_CAB_FRAME,                           // client, index, length, final
+  LOG_CAB_MESSAGE,                         // first letter of the message type
+  LOG_FORMATS
+}; // LogFormat
+
+struct LogEntry{
+  uint32_t time;                           // micros() when recorded
+  uint8_t format;                          // LogFormat
+  uint8_t n;
+  int32_t args[LOG_MAX_ARGS];
+}; // LogEntry
+
+struct Log{
+  static LogEntry entries[LOG_ENTRIES];
+  static uint32_t count;                   // records made since start
+  static uint16_t held;                    // entries holding a record, the newest ones
+  static uint16_t pending;                 // newest records not printed yet
+  static uint32_t dropped;                 // records overwritten before they were printed
+  static void put(uint8_t format, uint8_t n, const int32_t *args);
+  template<class... A> static void record(uint8_t format, A... args){
+    static_assert(sizeof...(A)<=LOG_MAX_ARGS,"too many arguments for a log record");
+    int32_t v[sizeof...(A)+1]={(int32_t)args...};
+    put(format,sizeof...(A),v);
+  }
+  static bool get(uint16_t i, LogEntry &e);   // copies the i-th held record, oldest first
+  static bool peek(LogEntry &e, uint32_t &number);   // copies the oldest pending record and its number
+  static void printed(uint32_t number);    // the record numbered number is no longer pending
+  static int format(const LogEntry &e, char *buf, size_t n);   // one line of text for e, as snprintf
+  template<class Write> static void drain(int budget, Write &&write);   // write(const char *line, int n) prints pending lines that fit budget bytes
+}; // Log
+
+///////////////////////////////////////////////////////////////////////////////
+
+template<class Write> void Log::drain(int budget, Write &&write){
+#if LOG_RECORDING
+  LogEntry e;
+  uint32_t number;
+  char line[LOG_LINE_MAX];
+  while(peek(e,number)){
+    int n=format(e,line,sizeof(line));
+    if(n>=(int)sizeof(line))
+      n=sizeof(line)-1;
+    if(n>budget)
+      break;
+    write(line,n);
+    budget-=n;
+    printed(number);
+  }
+#endif
+} // Log::drain
+
+#endif
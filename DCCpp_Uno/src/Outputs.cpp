@@ -75,6 +75,7 @@ the state of any outputs being monitored or controlled by a separate interface o
 #include "SerialCommand.h"
 #include "DCCpp.h"
 #include "EEStore.h"
+#include "Journal.h"
 #include <EEPROM.h>
 #include "CommInterface.h"
 
@@ -85,7 +86,8 @@ void Output::activate(int s){
   digitalWrite(data.pin,data.oStatus ^ bitRead(data.iFlag,0));      // set state of output pin to HIGH or LOW depending on whether bit zero of iFlag is set to 0 (ACTIVE=HIGH) or 1 (ACTIVE=LOW)
   if(num>0)
     EEPROM.put(num,data.oStatus);
-  CommManager::printf("<Y %d %d>", data.id, data.oStatus);
+  CommManager::send(Reply::output(data.id, data.oStatus));
+  Journal::record('Y',data.id,data.oStatus);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -103,7 +105,7 @@ void Output::remove(int n){
   for(tt=firstOutput;tt!=NULL && tt->data.id!=n;pp=tt,tt=tt->nextOutput);
 
   if(tt==NULL){
-    CommManager::printf("<X>");
+    CommManager::reject();
     return;
   }
 
@@ -119,17 +121,19 @@ void Output::remove(int n){
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void Output::show(int n){
+void Output::show(int n, bool toSource){
   Output *tt;
 
   if(firstOutput==NULL){
-    CommManager::printf("<X>");
+    CommManager::reject();
     return;
   }
 
   for(tt=firstOutput;tt!=NULL;tt=tt->nextOutput){
     if(n==1) {
       CommManager::printf("<Y %d %d %d %d>", tt->data.id, tt->data.pin, tt->data.iFlag, tt->data.oStatus);
+    } else if(toSource) {
+      CommManager::respond(Reply::output(tt->data.id, tt->data.oStatus));
     } else {
       CommManager::printf("<Y %d %d>", tt->data.id, tt->data.oStatus);
     }
@@ -139,17 +143,34 @@ void Output::show(int n){
 ///////////////////////////////////////////////////////////////////////////////
 
 void Output::parse(const char *c){
-  int n,s,m;
+  CommandArgs a;
+
+  if(!a.parse(c,0,3)){
+    CommManager::reject();
+    return;
+  }
+  parse(a);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void Output::parse(const CommandArgs &a){
   Output *t;
 
-  switch(sscanf(c,"%d %d %d",&n,&s,&m)){
+  if((a.n>=1 && !a.inRange(0,0,32767)) || (a.n==2 && !a.inRange(1,0,1)) || (a.n==3 && (!a.inRange(1,0,255) || !a.inRange(2,0,7)))){
+    CommManager::reject();
+    return;
+  }
+  int n=a[0],s=a[1],m=a[2];
+
+  switch(a.n){
 
     case 2:                     // argument is string with id number of output followed by zero (LOW) or one (HIGH)
       t=get(n);
       if(t!=NULL)
         t->activate(s);
       else
-        CommManager::printf("<X>");
+        CommManager::reject();
       break;
 
     case 3:                     // argument is string with id number of output followed by a pin number and invert flag
@@ -160,7 +181,7 @@ void Output::parse(const char *c){
       remove(n);
     break;
 
-    case -1:                    // no arguments
+    case 0:                     // no arguments
       show(1);                  // verbose show
     break;
   }
@@ -218,7 +239,7 @@ Output *Output::create(int id, int pin, int iFlag, int v){
 
   if(tt==NULL){       // problem allocating memory
     if(v==1)
-      CommManager::printf("<X>");
+      CommManager::reject();
     return(tt);
   }
 
@@ -8,6 +8,7 @@ Part of DCC++ BASE STATION for the Arduino
 **********************************************************************/
 
 #include "Arduino.h"
+#include "CommandArgs.h"
 
 #ifndef Outputs_h
 #define Outputs_h
@@ -26,12 +27,13 @@ struct Output{
   Output *nextOutput;
   void activate(int s);
   static void parse(const char *c);
+  static void parse(const CommandArgs &a);
   static Output* get(int);
   static void remove(int);
   static void load();
   static void store();
   static Output *create(int, int, int, int=0);
-  static void show(int=0);
+  static void show(int=0, bool toSource=false);   // toSource: to the interface whose command runs only
 }; // Output
   
 #endif
@@ -11,6 +11,11 @@ Part of DCC++ BASE STATION for the Arduino
 #include "PacketRegister.h"
 #include "CommInterface.h"
 #include "GenerateDCC.h"
+#include "AnalogSampler.h"
+#include "CommandArgs.h"
+#include "CommandBatch.h"
+#include "Journal.h"
+#include "Log.h"
 #include <algorithm>
 
 constexpr auto timing_pin = 17;
@@ -74,12 +79,17 @@ RegisterList::RegisterList(int maxNumRegs)
     reg[i].initPackets();
   regMap=(Register **)calloc((maxNumRegs+1),sizeof(Register *));
   speedTable=(int *)calloc((maxNumRegs+1),sizeof(int *));
+  cabTable=(int *)calloc((maxNumRegs+1),sizeof(int));
   currentReg=reg;
   regMap[0]=reg;
   maxLoadedReg=reg;
   nextReg=NULL;
-  currentBit=0;
-  nRepeat=0;
+  loadedAt=0;
+  startingLoad=0;
+  bitCursor=nullptr;
+  shiftReg=0;
+  byteBitsLeft=0;                        // the first NextBit() starts on the packet returned by NextPacket()
+  packetBitsLeft=0;
   pinMode(timing_pin, OUTPUT);
   digitalWrite(timing_pin, LOW);
 } // RegisterList::RegisterList
@@ -92,7 +102,11 @@ RegisterList::RegisterList(int maxNumRegs)
 
 void RegisterList::loadPacket(int nReg, byte *b, int nBytes, int nRepeat, int printFlag) volatile
 {
+  if(CommandBatch::open && CommandBatch::capture(this,nReg,b,nBytes,nRepeat))
+    return;                        // sent when the batch is committed
   nReg=nReg%((maxNumRegs+1));      // force nReg to be between 0 and maxNumRegs, inclusive
+  if(CommandBatch::nRefresh || CommandBatch::nMembers)
+    CommandBatch::supersede(this,nReg);   // newer than what a batch holds for this register
   bool updateRegMap = regMap[nReg]==nullptr;
   if(updateRegMap)                 // first time this Register Number has been called
    regMap[nReg] = maxLoadedReg+1;  // set Register Pointer for this Register Number to next available Register
@@ -101,8 +115,10 @@ void RegisterList::loadPacket(int nReg, byte *b, int nBytes, int nRepeat, int pr
   r->updatePacket->setup(b, nBytes, nRepeat);
   std::swap(r->updatePacket, r->activePacket);
   if(!currentPacket) currentPacket=r->activePacket;
-	if(!nextReg)
+	if(!nextReg || r==reg){          // Register 0 is only sent when it is next, so it goes ahead of a waiting update
 	  nextReg=r;
+	  loadedAt=micros();
+	}
   if(updateRegMap)
     maxLoadedReg=std::max(const_cast<Register*>(maxLoadedReg), r);
 
@@ -113,18 +129,29 @@ void RegisterList::loadPacket(int nReg, byte *b, int nBytes, int nRepeat, int pr
 ///////////////////////////////////////////////////////////////////////////////
 
 void RegisterList::setThrottle(const char *s) volatile{
-  byte b[5];                      // save space for checksum byte
-  int nReg;
-  int cab;
-  int tSpeed;
-  int tDirection;
-  byte nB=0;
+  CommandArgs a;
 
-  if(sscanf(s,"%d %d %d %d",&nReg,&cab,&tSpeed,&tDirection)!=4)
+  if(!a.parse(s,4,4)){
+    CommManager::reject();
     return;
+  }
+  setThrottle(a);
+} // RegisterList::setThrottle()
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RegisterList::setThrottle(const CommandArgs &a) volatile{
+  byte b[5];                      // save space for checksum byte
+  byte nB=0;
 
-  if(nReg<1 || nReg>maxNumRegs)
+  if(!a.inRange(0,1,maxNumRegs) || !a.inRange(1,0,10293) || !a.inRange(2,-1,126) || !a.inRange(3,0,1)){
+    CommManager::reject();
     return;
+  }
+  int nReg=a[0];
+  int cab=a[1];
+  int tSpeed=a[2];
+  int tDirection=a[3];
 
   if(cab>127)
     b[nB++]=highByte(cab) | 0xC0;      // convert train number into a two-byte address
@@ -139,25 +166,40 @@ void RegisterList::setThrottle(const char *s) volatile{
   }
 
   loadPacket(nReg,b,nB,0,1);
-  CommManager::printf("<T %d %d %d>", cab /*nReg*/, tSpeed, tDirection);
-Serial.printf("set throttle sent.%d %d %d %d\n", nReg, cab, tSpeed, tDirection);
+  CommManager::send(Reply::throttle(cab /*nReg*/, tSpeed, tDirection));
+  Journal::record('T',cab,tSpeed,tDirection);
+  LOG(LOG_THROTTLES,LOG_DEBUG,LOG_THROTTLE,nReg,cab,tSpeed,tDirection);
   speedTable[nReg]=tDirection==1?tSpeed:-tSpeed;
+  cabTable[nReg]=cab;
 
 } // RegisterList::setThrottle()
 
 ///////////////////////////////////////////////////////////////////////////////
 
 void RegisterList::setFunction(const char *s) volatile{
+  CommandArgs a;
+
+  if(!a.parse(s,2,3)){
+    CommManager::reject();
+    return;
+  }
+  setFunction(a);
+} // RegisterList::setFunction()
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RegisterList::setFunction(const CommandArgs &a) volatile{
   byte b[5];                      // save space for checksum byte
-  int cab;
-  int fByte, eByte;
-  int nParams;
   byte nB=0;
 
-  nParams=sscanf(s,"%d %d %d",&cab,&fByte,&eByte);
-
-  if(nParams<2)
+  if(!a.inRange(0,0,10293) || !a.inRange(1,0,255) || (a.n==3 && !a.inRange(2,0,255))){
+    CommManager::reject();
     return;
+  }
+  int cab=a[0];
+  int fByte=a[1];
+  int eByte=a.n==3 ? a[2] : 0;
+  int nParams=a.n;
 
   if(cab>127)
     b[nB++]=highByte(cab) | 0xC0;      // convert train number into a two-byte address
@@ -178,13 +220,27 @@ void RegisterList::setFunction(const char *s) volatile{
 ///////////////////////////////////////////////////////////////////////////////
 
 void RegisterList::setAccessory(const char *s) volatile{
+  CommandArgs a;
+
+  if(!a.parse(s,3,3)){
+    CommManager::reject();
+    return;
+  }
+  setAccessory(a);
+} // RegisterList::setAccessory()
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RegisterList::setAccessory(const CommandArgs &a) volatile{
   byte b[3];                      // save space for checksum byte
-  int aAdd;                       // the accessory address (0-511 = 9 bits)
-  int aNum;                       // the accessory number within that address (0-3)
-  int activate;                   // flag indicated whether accessory should be activated (1) or deactivated (0) following NMRA recommended convention
 
-  if(sscanf(s,"%d %d %d",&aAdd,&aNum,&activate)!=3)
+  if(!a.inRange(0,0,511) || !a.inRange(1,0,3) || !a.inRange(2,0,1)){
+    CommManager::reject();
     return;
+  }
+  int aAdd=a[0];                  // the accessory address (0-511 = 9 bits)
+  int aNum=a[1];                  // the accessory number within that address (0-3)
+  int activate=a[2];              // flag indicated whether accessory should be activated (1) or deactivated (0) following NMRA recommended convention
 
   b[0]=aAdd%64+128;                                           // first byte is of the form 10AAAAAA, where AAAAAA represent 6 least signifcant bits of accessory address
   b[1]=((((aAdd/64)%8)<<4) + (aNum%4<<1) + activate%2) ^ 0xF8;      // second byte is of the form 1AAACDDD, where C should be 1, and the least significant D represent activate/deactivate
@@ -197,23 +253,25 @@ void RegisterList::setAccessory(const char *s) volatile{
 
 void RegisterList::writeTextPacket(const char *s) volatile{
 
-  int nReg;
+  CommandArgs a;
   byte b[6];
-  int nBytes;
-  unsigned int ub[6];
-  nBytes=sscanf(s,"%d %x %x %x %x %x",&nReg,ub,ub+1,ub+2,ub+3,ub+4)-1;
-  for(int i = 0; i < 6; ++i) b[i] = ub[i];
-  if(nBytes<2 || nBytes>5){    // invalid valid packet
+  bool valid=a.parse(s,3,6,0x3E) && a.inRange(0,0,maxNumRegs);   // register number, then 2-5 hex bytes
+  for(int i=1;valid && i<a.n;i++){
+    valid=a.inRange(i,0,0xFF);
+    b[i-1]=a[i];
+  }
+  if(!valid){    // invalid valid packet
+    CommManager::fail();
     CommManager::printf("<mInvalid Packet>");
     return;
   }
-  loadPacket(nReg,b,nBytes,0,1);
+  loadPacket(a[0],b,a.n-1,0,1);
 } // RegisterList::writeTextPacket()
 
 void RegisterList::scheduleSequence(Packet* packets, size_t n) volatile
 {
+  sequenceLength = n;              // the length first, the generator only reads it once sequence is set
   sequence = packets;
-  sequenceLength = n;
 }
 void RegisterList::waitForSequence(size_t expectedRemainingLength) volatile const
 {
@@ -227,32 +285,54 @@ void RegisterList::killSequence()
 
 namespace {
   struct AckPoller {
+    int8_t channel;
     int32_t base;
 
     AckPoller()
-    : base{0}
+    : channel{AnalogSampler::registerPin(CURRENT_MONITOR_PIN_PROG)}
+    , base{AnalogSampler::baseline(channel)}   // kept if the sampler delivers nothing
     {
-      digitalWrite(timing_pin, HIGH);
-      for(int j=0;j<ACK_BASE_COUNT;j++) {
-        base += analogRead(CURRENT_MONITOR_PIN_PROG);
+      int32_t sum = 0;
+      uint8_t next = AnalogSampler::sampleCount(channel);
+      for(int j=0;j<ACK_BASE_COUNT;++j){
+        if(!fresh(next))
+          return;
+        sum += AnalogSampler::sample(channel, next++);
       }
-      base/=ACK_BASE_COUNT;
-      digitalWrite(timing_pin, LOW);
+      base = sum / ACK_BASE_COUNT;
+    }
+
+    // Waits for the sampler to deliver conversion next, for at most ACK_STALL_MICROS.
+    bool fresh(uint8_t next)
+    {
+      if(channel < 0)
+        return false;
+      unsigned long start = micros();
+      while(next == AnalogSampler::sampleCount(channel))
+        if(micros() - start >= ACK_STALL_MICROS)
+          return false;
+      return true;
     }
 
     auto pollNow()
     {
+      if(channel < 0)                        // no sampler channel left for the programming track
+        return 0;
       digitalWrite(timing_pin, HIGH);
       int d = 0;
       int32_t c = base;
+      uint8_t next = AnalogSampler::sampleCount(channel);
       //Serial.printf("ACK: base %d\n", base);
-      for(int j=0;j<ACK_SAMPLE_COUNT;j++){
-        c=(analogRead(CURRENT_MONITOR_PIN_PROG)-base)*ACK_SAMPLE_SMOOTHING+c*(1.0-ACK_SAMPLE_SMOOTHING);
+      for(int j=0;j<ACK_SAMPLE_COUNT;){
+        if(!fresh(next))
+          break;                             // the sampler stalled, count it as no ACK
+        c=(AnalogSampler::sample(channel, next++)-base)*ACK_SAMPLE_SMOOTHING+c*(1.0-ACK_SAMPLE_SMOOTHING);
         if( j > 20 && c > ACK_SAMPLE_THRESHOLD) {
           //Serial.printf("A! c: %d j: %d\n", c, j);
           d=1;
           break;
         }
+        ++j;
       }
       digitalWrite(timing_pin, LOW);
       return d;
@@ -262,70 +342,137 @@ namespace {
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void RegisterList::readCV(const char *s) volatile{
-  byte bRead[4];
-  int bValue;
-  int cv, callBack, callBackSub;
-  if(sscanf(s,"%d %d %d",&cv,&callBack,&callBackSub) != 3) {         // cv = 1-1024
-    return;
-  }
-  cv--;                              // actual CV addresses are cv-1 (0-1023)
+// SENDS A SINGLE SERVICE MODE VERIFY INSTRUCTION (BIT OR BYTE) ON THE PROGRAMMING TRACK AND LISTENS FOR AN ACK
+// bVerify MUST HOLD THE 3 INSTRUCTION BYTES PLUS ONE SPARE BYTE FOR THE CHECKSUM
 
-  bRead[0]=0x78+(highByte(cv)&0x03);   // any CV>1023 will become modulus(1024) due to bit-mask of 0x03
-  bRead[1]=lowByte(cv);
+bool RegisterList::verify(byte *bVerify) volatile{
   Packet seq[] = { Packet{resetPacket, 3}, Packet{}, Packet{resetPacket, 2}};
-  bValue=0;
-
-  for(int i=0;i<8;i++) {
-    bRead[2]=0xE8+i;
-    seq[0].nRepeat = 5;
-    seq[1].setup(bRead, 3, 5);
-    seq[2].nRepeat = 7;
-    scheduleSequence(seq);
-    while(seq[0].nRepeat > 3) {} // wait fo some reset packets, so that we know the previous ack has finished.
-    AckPoller ack;
-    //waitForSequence(1); //listen for ack during the resetpacket.
-    while(seq[1].nRepeat == 5) { /* nothing */}
-
-    auto start = micros();
-    auto d = ack.pollNow();
-    auto end = micros();
-    const_cast<RegisterList*>(this)->killSequence();
-    //Serial.printf("Read bit %d d = %d, base = %d micros %d\n", i, d, ack.base, end - start);
-    bitWrite(bValue, i, d);
-
-    while(currentPacket == seq + 2) {/*nothing*/}
-  }
-
-  bRead[0]=0x74+(highByte(cv)&0x03);   // set-up to re-verify entire byte
-  bRead[1]=lowByte(cv);
-  bRead[2]=bValue;
-  auto backup = bValue;
   seq[0].nRepeat = 5;
-  seq[1].setup(bRead, 3, 5);
+  seq[1].setup(bVerify, 3, 5);
   seq[2].nRepeat = 7;
   scheduleSequence(seq);
   while(seq[0].nRepeat > 3) {} // wait fo some reset packets, so that we know the previous ack has finished.
   AckPoller ack;
   //waitForSequence(1); //listen for ack during the resetpacket.
   while(seq[1].nRepeat == 5) { /* nothing */}
+
   auto d = ack.pollNow();
-  if(d==0)    // verify unsuccessful
-    bValue=-1;
   const_cast<RegisterList*>(this)->killSequence();
+
   while(currentPacket == seq + 2) {/*nothing*/}
-  CommManager::printf("<r%d|%d|%d %d> <%d>", callBack, callBackSub, cv+1, bValue, backup);
+  return d;
+} // RegisterList::verify()
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool RegisterList::verifyCVByte(int cv, int bValue) volatile{
+  byte bVerify[4];
+  cv--;                              // actual CV addresses are cv-1 (0-1023)
+  bVerify[0]=0x74+(highByte(cv)&0x03);   // any CV>1023 will become modulus(1024) due to bit-mask of 0x03
+  bVerify[1]=lowByte(cv);
+  bVerify[2]=bValue;
+  return verify(bVerify);
+} // RegisterList::verifyCVByte()
+
+///////////////////////////////////////////////////////////////////////////////
+
+// READS A CV ONE BIT AT A TIME (8 BIT VERIFIES) AND THEN VERIFIES THE WHOLE BYTE
+// RETURNS THE VERIFIED VALUE 0-255, OR -1 IF THE FINAL BYTE VERIFY FAILED.  THE UNVERIFIED BIT-BY-BIT VALUE IS STORED IN *raw IF GIVEN
+
+int RegisterList::readCVValue(int cv, int *raw) volatile{
+  byte bRead[4];
+  int bValue=0;
+
+  bRead[0]=0x78+(highByte(cv-1)&0x03);   // actual CV addresses are cv-1 (0-1023), any CV>1023 will become modulus(1024) due to bit-mask of 0x03
+  bRead[1]=lowByte(cv-1);
+
+  for(int i=0;i<8;i++) {
+    bRead[2]=0xE8+i;
+    bitWrite(bValue, i, verify(bRead));
+  }
+
+  if(raw)
+    *raw=bValue;
+  return verifyCVByte(cv, bValue) ? bValue : -1;
+} // RegisterList::readCVValue()
+
+///////////////////////////////////////////////////////////////////////////////
+
+// LIKE readCVValue(), BUT FIRST TRIES A BYTE VERIFY OF EACH LIKELY VALUE.  A HIT COSTS ONE VERIFY INSTEAD OF NINE
+
+int RegisterList::readCVGuess(int cv, const byte *guesses, int nGuesses) volatile{
+  for(int i=0;i<nGuesses;i++)
+    if(verifyCVByte(cv, guesses[i]))
+      return guesses[i];
+  return readCVValue(cv);
+} // RegisterList::readCVGuess()
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RegisterList::readCV(const char *s) volatile{
+  int bValue;
+  CommandArgs a;
+  if(!a.parse(s,3,3) || !a.inRange(0,1,1024)) {         // cv = 1-1024
+    CommManager::reject();
+    return;
+  }
+  int cv=a[0], callBack=a[1], callBackSub=a[2];
+
+  int backup;
+  bValue=readCVValue(cv, &backup);
+  if(bValue<0)
+    CommManager::fail();
+  CommManager::printf("<r%d|%d|%d %d> <%d>", callBack, callBackSub, cv, bValue, backup);   // with the diagnostic backup value, so not a Reply
 } // RegisterList::readCV()
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// IDENTIFIES THE LOCOMOTIVE ON THE PROGRAMMING TRACK: READS CV29 AND THEN ONLY THE ADDRESS CVS THAT CV29 BIT 5 SELECTS
+// (CV1 FOR A SHORT ADDRESS, CV17/CV18 FOR A LONG ADDRESS).  COMMON FACTORY VALUES ARE VERIFIED BEFORE FALLING BACK TO A FULL READ.
+
+void RegisterList::identify(const char *s) volatile{
+  static const byte cv29Guesses[]={0x06,0x26};     // 28/128 steps + analog conversion, with a short or a long address
+  static const byte cv1Guesses[]={0x03};           // factory default short address
+  CommandArgs a;
+
+  if(!a.parse(s,0,0)){                              // <I> takes no arguments
+    CommManager::reject();
+    return;
+  }
+
+  int cv29=readCVGuess(29, cv29Guesses, sizeof(cv29Guesses));
+  if(cv29<0){
+    CommManager::fail();
+    CommManager::printf("<ident -1>");
+    return;
+  }
+
+  int steps=bitRead(cv29,1) ? 28 : 14;
+  int addr;
+  if(bitRead(cv29,5)){
+    int cv17=readCVValue(17);
+    int cv18=cv17<0 ? -1 : readCVValue(18);
+    addr=(cv18<0) ? -1 : ((cv17&0x3F)<<8)+cv18;
+  } else {
+    addr=readCVGuess(1, cv1Guesses, sizeof(cv1Guesses));
+  }
+  if(addr<0)
+    CommManager::fail();
+
+  CommManager::printf("<ident %d %s %d>", addr, bitRead(cv29,5) ? "LONG" : "SHORT", steps);
+} // RegisterList::identify()
+
+///////////////////////////////////////////////////////////////////////////////
+
 void RegisterList::writeCVByte(const char *s) volatile{
   byte bWrite[4];
-  int bValue;
-  int cv, callBack, callBackSub;
+  CommandArgs a;
 
-  if(sscanf(s,"%d %d %d %d",&cv,&bValue,&callBack,&callBackSub)!=4)          // cv = 1-1024
+  if(!a.parse(s,4,4) || !a.inRange(0,1,1024) || !a.inRange(1,0,255)){          // cv = 1-1024
+    CommManager::reject();
     return;
+  }
+  int cv=a[0], bValue=a[1], callBack=a[2], callBackSub=a[3];
   cv--;                              // actual CV addresses are cv-1 (0-1023)
 
   bWrite[0]=0x7C+(highByte(cv)&0x03);   // any CV>1023 will become modulus(1024) due to bit-mask of 0x03
@@ -346,22 +493,25 @@ void RegisterList::writeCVByte(const char *s) volatile{
   loadPacket(0,resetPacket,2,1);          // forces code to wait until all repeats of bRead are completed (and decoder begins to respond)
 
   auto d = ack.pollNow();
-  if(d==0)    // verify unsuccessful
+  if(d==0){   // verify unsuccessful
     bValue=-1;
+    CommManager::fail();
+  }
 
-  CommManager::printf("<r%d|%d|%d %d>", callBack, callBackSub, cv+1, bValue);
+  CommManager::send(Reply::cv(callBack, callBackSub, cv+1, bValue));
 } // RegisterList::writeCVByte()
 
 ///////////////////////////////////////////////////////////////////////////////
 
 void RegisterList::writeCVBit(const char *s) volatile{
   byte bWrite[4];
-  int bNum,bValue;
-  int c,d,base;
-  int cv, callBack, callBackSub;
+  CommandArgs a;
 
-  if(sscanf(s,"%d %d %d %d %d",&cv,&bNum,&bValue,&callBack,&callBackSub)!=5)          // cv = 1-1024
+  if(!a.parse(s,5,5) || !a.inRange(0,1,1024) || !a.inRange(1,0,7) || !a.inRange(2,0,1)){          // cv = 1-1024
+    CommManager::reject();
     return;
+  }
+  int cv=a[0], bNum=a[1], bValue=a[2], callBack=a[3], callBackSub=a[4];
   cv--;                              // actual CV addresses are cv-1 (0-1023)
   bValue=bValue%2;
   bNum=bNum%8;
@@ -375,13 +525,7 @@ void RegisterList::writeCVBit(const char *s) volatile{
   loadPacket(0,resetPacket,2,1);
   loadPacket(0,idlePacket,2,10);
 
-  c=0;
-  d=0;
-  base=0;
-
-  for(int j=0;j<ACK_BASE_COUNT;j++)
-    base+=analogRead(CURRENT_MONITOR_PIN_PROG);
-  base/=ACK_BASE_COUNT;
+  AckPoller ack;
 
   bitClear(bWrite[2],4);              // change instruction code from Write Bit to Verify Bit
 
@@ -389,28 +533,39 @@ void RegisterList::writeCVBit(const char *s) volatile{
   loadPacket(0,bWrite,3,5);               // NMRA recommends 5 verfy packets
   loadPacket(0,resetPacket,2,1);          // forces code to wait until all repeats of bRead are completed (and decoder begins to respond)
 
-  for(int j=0;j<ACK_SAMPLE_COUNT;j++){
-    c=(analogRead(CURRENT_MONITOR_PIN_PROG)-base)*ACK_SAMPLE_SMOOTHING+c*(1.0-ACK_SAMPLE_SMOOTHING);
-    if(c>ACK_SAMPLE_THRESHOLD)
-      d=1;
-  }
-
-  if(d==0)    // verify unsuccessful
+  auto d = ack.pollNow();
+  if(d==0){   // verify unsuccessful
     bValue=-1;
-  CommManager::printf("<r%d|%d|%d %d %d>", callBack, callBackSub, cv+1, bNum, bValue);
+    CommManager::fail();
+  }
+  CommManager::send(Reply::cv(callBack, callBackSub, cv+1, bValue, bNum));
 } // RegisterList::writeCVBit()
 
 ///////////////////////////////////////////////////////////////////////////////
 
 void RegisterList::writeCVByteMain(const char *s) volatile{
+  CommandArgs a;
+
+  if(!a.parse(s,3,3)){
+    CommManager::reject();
+    return;
+  }
+  writeCVByteMain(a);
+} // RegisterList::writeCVByteMain()
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RegisterList::writeCVByteMain(const CommandArgs &a) volatile{
   byte b[6];                      // save space for checksum byte
-  int cab;
-  int cv;
-  int bValue;
   byte nB=0;
 
-  if(sscanf(s,"%d %d %d",&cab,&cv,&bValue)!=3)
+  if(!a.inRange(0,0,10293) || !a.inRange(1,1,1024) || !a.inRange(2,0,255)){
+    CommManager::reject();
     return;
+  }
+  int cab=a[0];
+  int cv=a[1];
+  int bValue=a[2];
   cv--;
 
   if(cab>127)
@@ -429,14 +584,17 @@ void RegisterList::writeCVByteMain(const char *s) volatile{
 
 void RegisterList::writeCVBitMain(const char *s) volatile{
   byte b[6];                      // save space for checksum byte
-  int cab;
-  int cv;
-  int bNum;
-  int bValue;
+  CommandArgs a;
   byte nB=0;
 
-  if(sscanf(s,"%d %d %d %d",&cab,&cv,&bNum,&bValue)!=4)
+  if(!a.parse(s,4,4) || !a.inRange(0,0,10293) || !a.inRange(1,1,1024) || !a.inRange(2,0,7) || !a.inRange(3,0,1)){
+    CommManager::reject();
     return;
+  }
+  int cab=a[0];
+  int cv=a[1];
+  int bNum=a[2];
+  int bValue=a[3];
   cv--;
 
   bValue=bValue%2;
@@ -456,6 +614,22 @@ void RegisterList::writeCVBitMain(const char *s) volatile{
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// Reports the throttles by cab, as setThrottle() and the journal do.
+
+void RegisterList::showThrottles(bool toSource) volatile {
+  for(int i=1;i<=maxNumRegs;i++){
+    if(speedTable[i]==0)
+      continue;
+    Reply r=Reply::throttle(cabTable[i], speedTable[i]>0 ? speedTable[i] : -speedTable[i], speedTable[i]>0 ? 1 : 0);
+    if(toSource)
+      CommManager::respond(r);
+    else
+      CommManager::send(r);
+  }
+} // RegisterList::showThrottles()
+
+///////////////////////////////////////////////////////////////////////////////
+
 void RegisterList::printPacket(int nReg, byte *b, int nBytes, int nRepeat) volatile {
   CommManager::printf("<*%d:", nReg);
   for(int i=0;i<nBytes;i++){
@@ -469,4 +643,3 @@ void RegisterList::printPacket(int nReg, byte *b, int nBytes, int nRepeat) volat
 byte RegisterList::idlePacket[3]={0xFF,0x00,0};                 // always leave extra byte for checksum computation
 byte RegisterList::resetPacket[3]={0x00,0x00,0};
 
-byte RegisterList::bitMask[]={0x80,0x40,0x20,0x10,0x08,0x04,0x02,0x01};         // masks used in interrupt routine to speed the query of a single bit in a Packet
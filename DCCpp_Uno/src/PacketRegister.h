@@ -12,13 +12,18 @@ Part of DCC++ BASE STATION for the Arduino
 
 #include "Arduino.h"
 #include <atomic>
+#include "CommandArgs.h"
 
 // Define constants used for reading CVs from the Programming Track
 
-#define  ACK_BASE_COUNT            100      // number of analogRead samples to take before each CV verify to establish a baseline current
-#define  ACK_SAMPLE_COUNT          2500     // number of analogRead samples to take when monitoring current after a CV verify (bit or byte) has been sent
-#define  ACK_SAMPLE_SMOOTHING      0.2      // exponential smoothing to use in processing the analogRead samples after a CV verify (bit or byte) has been sent
-#define  ACK_SAMPLE_THRESHOLD       40      // the threshold that the exponentially-smoothed analogRead samples (after subtracting the baseline current) must cross to establish ACKNOWLEDGEMENT
+// The baseline current is the mean of ACK_BASE_COUNT conversions taken just before each verify packet, while the
+// decoder draws its idle current; the running baseline of the AnalogSampler lags behind a change of loco.
+
+#define  ACK_BASE_COUNT            16       // number of sampler conversions averaged for the baseline current
+#define  ACK_STALL_MICROS          10000    // longest wait for the sampler to deliver one conversion before the ACK poll gives up
+#define  ACK_SAMPLE_COUNT          2500     // number of sampler conversions to examine when monitoring current after a CV verify (bit or byte) has been sent
+#define  ACK_SAMPLE_SMOOTHING      0.2      // exponential smoothing to use in processing the samples after a CV verify (bit or byte) has been sent
+#define  ACK_SAMPLE_THRESHOLD       40      // the threshold that the exponentially-smoothed samples (after subtracting the baseline current) must cross to establish ACKNOWLEDGEMENT
 
 // Define a series of registers that can be sequentially accessed over a loop to generate a repeating series of DCC Packets
 
@@ -53,28 +58,41 @@ struct RegisterList{
   Register *currentReg;
   Register *maxLoadedReg;
   Register *nextReg;  // The most recently updated register, to be sent next, once the current packet is sent.
-  Packet *tempPacket;  // for the _uno
+  unsigned long loadedAt;      // micros() when nextReg was last set
+  unsigned long startingLoad;  // loadedAt of the register NextRegister() just moved to, until the generator has timed it
   std::atomic<Packet*> sequence;   //A sequnece of packets to be sent without other packets interrupting.
   std::atomic<byte>    sequenceLength;
   std::atomic<Packet*> currentPacket; // packet acutally being sent at the moment.
-  byte currentBit;
-  byte nRepeat;
+  const byte *bitCursor;   // next byte of currentPacket to move into shiftReg
+  byte shiftReg;           // bits of the current byte not yet sent, next bit in the msb
+  byte byteBitsLeft;       // bits left in shiftReg
+  byte packetBitsLeft;     // bits of currentPacket not yet moved into shiftReg
   int *speedTable;
+  int *cabTable;           // cab of the last throttle command of each register
   static byte idlePacket[3];
   static byte resetPacket[3];
-  static byte bitMask[8];
   RegisterList(int);
   void loadPacket(int nReg, byte *b, int nBytes, int nRepeat, int printFlag = 0) volatile;
   void setThrottle(const char *) volatile;
+  void setThrottle(const CommandArgs &) volatile;
   void setFunction(const char *) volatile;
+  void setFunction(const CommandArgs &) volatile;
   void setAccessory(const char *) volatile;
+  void setAccessory(const CommandArgs &) volatile;
   void writeTextPacket(const char *) volatile;
+  bool verify(byte *) volatile;
+  bool verifyCVByte(int, int) volatile;
+  int readCVValue(int, int * = nullptr) volatile;
+  int readCVGuess(int, const byte *, int) volatile;
   void readCV(const char *) volatile;
+  void identify(const char *) volatile;
   void writeCVByte(const char *) volatile;
   void writeCVBit(const char *) volatile;
   void writeCVByteMain(const char *) volatile;
+  void writeCVByteMain(const CommandArgs &) volatile;
   void writeCVBitMain(const char *s) volatile;
   void printPacket(int, byte *, int, int) volatile;
+  void showThrottles(bool toSource = false) volatile;   // toSource: to the interface whose command runs only
 
   template<size_t n>
   void scheduleSequence(Packet (&packets)[n]) volatile { return scheduleSequence(packets, n); }
@@ -88,9 +106,10 @@ struct RegisterList{
     if(nextReg) {                           /* IF another Register has been updated */
 	    auto r = nextReg;                     /*     update currentReg to nextReg */
       nextReg = nullptr;                    /*     reset nextReg to NULL */
+      startingLoad = loadedAt;
       return r;
-	  } else {                                  /*   ELSE simply move to next Register */
-	    return (currentReg == maxLoadedReg) ? reg : (currentReg + 1);
+	  } else {                                  /*   ELSE simply move to next Register, skipping Register 0 which is only sent when loaded */
+	    return (currentReg >= maxLoadedReg) ? (reg + 1) : (currentReg + 1);
     }
   }
 
@@ -116,16 +135,33 @@ struct RegisterList{
     }
   }
 
-  inline auto NextBit() volatile __attribute__ ((always_inline))
+  // Moves the next byte of the current packet into shiftReg, switching to the next packet when this one is done.
+  // Called once every 8 bits, so the per bit work in NextBit is a test, a shift and a decrement.
+  void NextByte() volatile __attribute__ ((always_inline))
   {
-    auto currBitNo = currentBit;
-    auto packet = currentPacket.load();
-    if(currBitNo == packet->nBits){    /* IF no more bits in this DCC Packet */
-      currentBit = currBitNo = 0;
-      packet = currentPacket = NextPacket();
+    if(packetBitsLeft == 0) {          /* IF no more bits in this DCC Packet */
+      Packet *packet;
+      do {
+        packet = NextPacket();
+      } while(packet->nBits == 0);     /* skip registers that were never loaded, such as an unused Register 0 */
+      bitCursor = packet->buf;
+      packetBitsLeft = packet->nBits;
     }
-    auto bit = packet->buf[currBitNo/8] & bitMask[currBitNo%8];
-    ++currentBit;
+    shiftReg = *bitCursor++;
+    byte n = packetBitsLeft < 8 ? packetBitsLeft : 8;
+    byteBitsLeft = n;
+    packetBitsLeft -= n;
+  }
+
+  bool startsPacket() const volatile { return byteBitsLeft == 0 && packetBitsLeft == 0; }  // the next NextBit() is the first bit of a packet
+
+  inline byte NextBit() volatile __attribute__ ((always_inline))
+  {
+    if(byteBitsLeft == 0)
+      NextByte();
+    byte bit = shiftReg & 0x80;
+    shiftReg <<= 1;
+    --byteBitsLeft;
     return bit;
   }
 };
@@ -0,0 +1,19 @@
+/**********************************************************************
+
+RateLimit.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "RateLimit.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool RateLimit::ready(uint32_t now){
+  uint32_t full=cost*burst;
+  uint32_t elapsed=now-last;
+  last=now;
+  credit=(elapsed>=full || credit>=full-elapsed) ? full : credit+elapsed;
+  return credit>=cost;
+} // RateLimit::ready
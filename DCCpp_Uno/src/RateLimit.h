@@ -0,0 +1,37 @@
+/**********************************************************************
+
+RateLimit.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef RateLimit_h
+#define RateLimit_h
+
+#include <stdint.h>
+
+// Token bucket that limits how many commands a client or an interface may run per second.  Credit is kept in
+// microseconds: it grows with time, up to BURST commands' worth, and each command costs 1000000/RATE of it.
+// An interface stops reading while it has no credit, so further commands wait in the socket buffer, or on the ESP,
+// until a later pass of the main loop instead of being lost.  A UART is not limited (see CommInterface::pacing):
+// it has no flow control, so its buffer would overflow, and its baud rate keeps it to a few commands per
+// millisecond anyway.
+
+#define  INTERFACE_COMMAND_RATE    200     // commands per second over all clients of an interface
+#define  INTERFACE_COMMAND_BURST   32      // commands an interface may run back to back after a pause
+#define  CLIENT_COMMAND_RATE       100     // commands per second of one client
+#define  CLIENT_COMMAND_BURST      16
+
+struct RateLimit{
+  uint32_t cost;                           // credit a command takes
+  uint32_t credit;
+  uint32_t last;                           // micros() at the last refill
+  RateLimit(uint16_t perSecond, uint8_t burst) : cost(1000000UL/perSecond), credit(cost*burst), last(0), burst(burst) {}
+  bool ready(uint32_t now);                // a command may run now
+  void take(){ credit=credit>cost ? credit-cost : 0; }
+private:
+  uint8_t burst;
+}; // RateLimit
+
+#endif
@@ -0,0 +1,115 @@
+/**********************************************************************
+
+Reply.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "Reply.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+Reply &Reply::number(long v, char before){
+  if(nArgs<REPLY_ARGS)
+    args[nArgs++]=v;
+  char digits[11];
+  uint8_t d=0;
+  unsigned long u=v<0 ? 0UL-(unsigned long)v : (unsigned long)v;
+  do{
+    digits[d++]='0'+u%10;
+    u/=10;
+  } while(u>0);
+  if(before)
+    put(before);
+  if(v<0)
+    put('-');
+  while(d>0)
+    put(digits[--d]);
+  buf[n]='\0';
+  return *this;
+} // Reply::number
+
+///////////////////////////////////////////////////////////////////////////////
+
+Reply &Reply::text(const char *s, char before){
+  if(before)
+    put(before);
+  if(textAt==0)
+    textAt=n;
+  while(*s)
+    put(*s++);
+  buf[n]='\0';
+  return *this;
+} // Reply::text
+
+///////////////////////////////////////////////////////////////////////////////
+
+Reply &Reply::end(){
+  buf[n++]='>';
+  buf[n]='\0';
+  return *this;
+} // Reply::end
+
+///////////////////////////////////////////////////////////////////////////////
+
+// The keys are the ones CommInterface gives the same replies when they come through CommManager::printf.
+
+Reply Reply::throttle(int cab, int speed, int direction){
+  Reply r('T');
+  r.number(cab).number(speed).number(direction).end();
+  r.key=(uint32_t)'T'<<16 | (uint16_t)cab;
+  return r;
+} // Reply::throttle
+
+///////////////////////////////////////////////////////////////////////////////
+
+Reply Reply::turnout(int id, int thrown){
+  Reply r('H');
+  r.number(id).number(thrown).end();
+  r.key=(uint32_t)'H'<<16 | (uint16_t)id;
+  return r;
+} // Reply::turnout
+
+///////////////////////////////////////////////////////////////////////////////
+
+Reply Reply::output(int id, int state){
+  Reply r('Y');
+  r.number(id).number(state).end();
+  r.key=(uint32_t)'Y'<<16 | (uint16_t)id;
+  return r;
+} // Reply::output
+
+///////////////////////////////////////////////////////////////////////////////
+
+Reply Reply::sensor(int id, bool active){
+  Reply r(active ? 'Q' : 'q');
+  r.number(id).end();
+  r.key=(uint32_t)'Q'<<16 | (uint16_t)id;
+  return r;
+} // Reply::sensor
+
+///////////////////////////////////////////////////////////////////////////////
+
+Reply Reply::current(int value, const char *board){
+  Reply r('a');
+  r.number(value);
+  if(board){
+    r.text(board);                         // one reply per board, none replaces another
+  } else {
+    r.key=(uint32_t)'a'<<16;
+  }
+  r.end();
+  return r;
+} // Reply::current
+
+///////////////////////////////////////////////////////////////////////////////
+
+Reply Reply::cv(int callBack, int callBackSub, int cv, int value, int bit){
+  Reply r('r');
+  r.number(callBack,0).number(callBackSub,'|').number(cv,'|');
+  if(bit>=0)
+    r.number(bit);
+  r.number(value).end();
+  return r;
+} // Reply::cv
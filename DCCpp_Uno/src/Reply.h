@@ -0,0 +1,47 @@
+/**********************************************************************
+
+Reply.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef Reply_h
+#define Reply_h
+
+#include <stdint.h>
+#include "Topics.h"
+
+// Builder for the replies that go out often: <T>, <H>, <Y>, <Q>/<q>, <a> and <r>.  The numbers are written as
+// digits straight into a REPLY_MAX byte buffer, without a format string, and the reply carries the key by which
+// a newer one replaces it in the transmit queues (see TxRing.h), and the numbers it was built from, so nothing has
+// to read it again on the way out.
+// CommManager::send() hands it to the interfaces.  CommManager::printf stays for the rare replies and diagnostics.
+// Nothing here depends on the Arduino core.
+
+#define  REPLY_MAX                 32      // longest reply, including the terminating NUL; longer text is cut
+#define  REPLY_ARGS                5       // numbers kept in args, <r CALLBACKNUM|CALLBACKSUB|CV BIT VALUE> has the most
+
+struct Reply{
+  char buf[REPLY_MAX];
+  uint8_t n;                               // characters in buf, without the NUL
+  uint32_t key;                            // 0 if no newer reply replaces this one
+  int32_t args[REPLY_ARGS];                // the numbers, in order
+  uint8_t nArgs;
+  uint8_t textAt;                          // where text() put its text in buf, 0 for none
+  explicit Reply(char letter) : n(2), key(0), nArgs(0), textAt(0) { buf[0]='<'; buf[1]=letter; buf[2]='\0'; }
+  Reply &number(long v, char before=' ');  // appends before and v, before 0 for none
+  Reply &text(const char *s, char before=' ');
+  Reply &end();                            // appends the closing >
+  uint8_t topic() const { return topicOf(buf[1]); }
+  static Reply throttle(int cab, int speed, int direction);   // <T CAB SPEED DIRECTION>
+  static Reply turnout(int id, int thrown);                   // <H ID THROW>
+  static Reply output(int id, int state);                     // <Y ID STATE>
+  static Reply sensor(int id, bool active);                   // <Q ID> or <q ID>
+  static Reply current(int value, const char *board = 0);     // <a CURRENT> or <a CURRENT BOARD>
+  static Reply cv(int callBack, int callBackSub, int cv, int value, int bit = -1);   // <r CALLBACKNUM|CALLBACKSUB|CV [BIT] VALUE>
+private:
+  void put(char c) { if(n<REPLY_MAX-2) buf[n++]=c; }   // leaves room for > and the NUL
+}; // Reply
+
+#endif
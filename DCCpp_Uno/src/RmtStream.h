@@ -0,0 +1,61 @@
+#ifndef RMT_STREAM_H
+#define RMT_STREAM_H
+//Refill logic for streaming DCC bits continuously through an RMT channel.
+//The channel memory is used as a ring of two halves: while the hardware sends one half
+//the other is refilled from the tx threshold interrupt. Nothing here touches the RMT
+//peripheral, so it can be run on a host build against a plain array standing in for the RMT memory.
+#include <stddef.h>
+#include <stdint.h>
+
+namespace GenerateDCC {
+	//An RMT item is {duration0:15, level0:1, duration1:15, level1:1}; a DCC bit is high then low for the same duration.
+	constexpr uint32_t rmtBitItem(uint32_t duration)
+	{
+		return (duration << 16) | duration | 1 << 15;
+	}
+
+	struct RmtStream {
+		uint32_t oneItem = 0;
+		uint32_t zeroItem = 0;
+		uint16_t halfItems = 0; // items in each half, 32 per rmt memory block used by the channel.
+		uint8_t nextHalf = 0;   // the half that the hardware will be done with next, as of the last fill.
+
+		RmtStream() = default;
+		constexpr RmtStream(uint32_t one, uint32_t zero, uint16_t half) : oneItem{one}, zeroItem{zero}, halfItems{half} {}
+
+		//The half the hardware is not sending, from the item it reads now (taken modulo the 2 * halfItems items).
+		//Refills go there rather than to nextHalf: when two threshold events were taken as one, or one came so late
+		//that the hardware has moved on, nextHalf is the half being sent and a refill there would tear it.
+		uint8_t idleHalf(uint16_t readItem) const __attribute__ ((always_inline))
+		{
+			return readItem % (2 * halfItems) < halfItems ? 1 : 0;
+		}
+
+		//Fill half of mem (2 * halfItems items) with the next bits.
+		//always_inline, as is nextBit in the generator, so that it goes in IRAM with the interrupt that calls it.
+		template<class NextBit>
+		__attribute__ ((always_inline)) void fillHalf(volatile uint32_t* mem, uint8_t half, NextBit&& nextBit)
+		{
+			auto dest = mem + half * halfItems;
+			for(uint16_t i = 0; i < halfItems; ++i)
+				dest[i] = nextBit() ? oneItem : zeroItem;
+			nextHalf = half ^ 1;
+		}
+
+		template<class NextBit>
+		void fillHalf(volatile uint32_t* mem, NextBit&& nextBit)
+		{
+			fillHalf(mem, nextHalf, nextBit);
+		}
+
+		//Fill both halves before starting the channel, the first threshold event then refills half 0.
+		template<class NextBit>
+		void prime(volatile uint32_t* mem, NextBit&& nextBit)
+		{
+			nextHalf = 0;
+			fillHalf(mem, nextBit);
+			fillHalf(mem, nextBit);
+		}
+	};
+}
+#endif /* end of include guard: RMT_STREAM_H */
@@ -60,6 +60,8 @@ decide to ignore the <q ID> return and only react to <Q ID> triggers.
 #include "EEStore.h"
 #include <EEPROM.h>
 #include "CommInterface.h"
+#include "CommandArgs.h"
+#include "Journal.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -71,10 +73,12 @@ void Sensor::check(){
 
     if(!tt->active && tt->signal<0.5){
       tt->active=true;
-      CommManager::printf("<Q %d>", tt->data.snum);
+      CommManager::send(Reply::sensor(tt->data.snum, true));
+      Journal::record('Q',tt->data.snum,1);
     } else if(tt->active && tt->signal>0.9){
       tt->active=false;
-      CommManager::printf("<q %d>", tt->data.snum);
+      CommManager::send(Reply::sensor(tt->data.snum, false));
+      Journal::record('Q',tt->data.snum,0);
     }
   } // loop over all sensors
 
@@ -98,7 +102,7 @@ Sensor *Sensor::create(int snum, int pin, int pullUp, int v){
 
   if(tt==NULL){       // problem allocating memory
     if(v==1)
-      CommManager::printf("<X>");
+      CommManager::reject();
     return(tt);
   }
 
@@ -131,7 +135,7 @@ void Sensor::remove(int n){
   for(tt=firstSensor;tt!=NULL && tt->data.snum!=n;pp=tt,tt=tt->nextSensor);
 
   if(tt==NULL){
-    CommManager::printf("<X>");
+    CommManager::reject();
     return;
   }
 
@@ -151,7 +155,7 @@ void Sensor::show(){
   Sensor *tt;
 
   if(firstSensor==NULL){
-    CommManager::printf("<X>");
+    CommManager::reject();
     return;
   }
 
@@ -162,26 +166,35 @@ void Sensor::show(){
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void Sensor::status(){
+void Sensor::status(bool toSource){
   Sensor *tt;
 
   if(firstSensor==NULL){
-    CommManager::printf("<X>");
+    CommManager::reject();
     return;
   }
 
   for(tt=firstSensor;tt!=NULL;tt=tt->nextSensor){
-    CommManager::printf("<%c %d>", tt->active?'Q':'q', tt->data.snum);
+    if(toSource)
+      CommManager::respond(Reply::sensor(tt->data.snum, tt->active));
+    else
+      CommManager::send(Reply::sensor(tt->data.snum, tt->active));
   }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 void Sensor::parse(const char *c) {
-  int n,s,m;
+  CommandArgs a;
   //Sensor *t;
 
-  switch(sscanf(c,"%d %d %d",&n,&s,&m)){
+  if(!a.parse(c,0,3) || (a.n>=1 && !a.inRange(0,0,32767)) || (a.n==3 && (!a.inRange(1,0,255) || !a.inRange(2,0,1)))){
+    CommManager::reject();
+    return;
+  }
+  int n=a[0],s=a[1],m=a[2];
+
+  switch(a.n){
 
     case 3:                     // argument is string with id number of sensor followed by a pin number and pullUp indicator (0=LOW/1=HIGH)
       create(n,s,m,1);
@@ -191,12 +204,12 @@ void Sensor::parse(const char *c) {
       remove(n);
     break;
 
-    case -1:                    // no arguments
+    case 0:                     // no arguments
       show();
     break;
 
     case 2:                     // invalid number of arguments
-      CommManager::printf("<X>");
+      CommManager::reject();
       break;
   }
 }
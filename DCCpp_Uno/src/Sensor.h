@@ -32,7 +32,7 @@ struct Sensor{
   static Sensor* get(int);  
   static void remove(int);  
   static void show();
-  static void status();
+  static void status(bool toSource=false);   // toSource: to the interface whose command runs only
   static void parse(const char *c);
   static void check();   
 }; // Sensor
@@ -10,7 +10,8 @@ Part of DCC++ BASE STATION for the Arduino
 // DCC++ BASE STATION COMMUNICATES VIA THE SERIAL PORT USING SINGLE-CHARACTER TEXT COMMANDS
 // WITH OPTIONAL PARAMTERS, AND BRACKETED BY < AND > SYMBOLS.  SPACES BETWEEN PARAMETERS
 // ARE REQUIRED.  SPACES ANYWHERE ELSE ARE IGNORED.  A SPACE BETWEEN THE SINGLE-CHARACTER
-// COMMAND AND THE FIRST PARAMETER IS ALSO NOT REQUIRED.
+// COMMAND AND THE FIRST PARAMETER IS ALSO NOT REQUIRED.  COMMANDS WITH MISSING, EXTRA, NON-NUMERIC
+// OR OUT OF RANGE PARAMETERS RETURN <X> (SEE CommandArgs.h).
 
 // See SerialCommand::parse() below for defined text commands.
 
@@ -21,7 +22,13 @@ Part of DCC++ BASE STATION for the Arduino
 #include "Outputs.h"
 #include "EEStore.h"
 #include "CommInterface.h"
+#include "CommInterfaceLocalWeb.h"
 #include "CurrentMonitor.h"
+#include "Tracks.h"
+#include "GenerateDCC.h"
+#include "CommandBatch.h"
+#include "Journal.h"
+#include "Log.h"
 #ifdef ARDUINO_ARCH_ESP32
 
 #else
@@ -42,7 +49,7 @@ void SerialCommand::init(volatile RegisterList *_mRegs, volatile RegisterList *_
 ///////////////////////////////////////////////////////////////////////////////
 
 void SerialCommand::parse(const char *com){
-	Serial.printf("SerialCommand::parse() %s\n", com);
+  LOG(LOG_COMMANDS,LOG_DEBUG,LOG_COMMAND,com[0],strlen(com));
   switch(com[0]){
 
 /***** SET ENGINE THROTTLES USING 128-STEP SPEED CONTROL ****/
@@ -262,6 +269,206 @@ void SerialCommand::parse(const char *com){
       pRegs->readCV(com+1);
       break;
 
+/***** IDENTIFY THE ENGINE DECODER ON THE PROGRAMMING TRACK  ****/
+
+    case 'I':     // <I>
+/*
+ *    reads CV29 and, depending on its bit 5, either the short address in CV1 or the long address in CV17/CV18
+ *    of the decoder of an engine on the programming track
+ *
+ *    returns: <ident ADDRESS LONG|SHORT STEPS>
+ *    where ADDRESS is the active address of the decoder (or -1 if it could not be read), and STEPS is 14 or 28
+ *    as selected by CV29 bit 1 (128-step throttle commands work in either mode).  Returns <ident -1> if CV29 could not be read,
+ *    or <X> if any parameters are given
+*/
+      pRegs->identify(com+1);
+      break;
+
+/***** REPORT DCC GENERATOR JITTER STATISTICS  ****/
+
+    case 'J':     // <J>
+/*
+ *    reports the waveform quality counters kept by the ESP32 rmt generator for each track, and the latency of commands
+ *    from the web server, or resets them with <J 0>
+ *
+ *    returns: for each track <JL NAME COUNT MAX UNDERRUNS B0 ... B15> <JP NAME COUNT MAX B0 ... B15> <JR NAME COUNT MAX B0 ... B15>
+ *    where JL is the histogram of refill lateness (8 microsecond bins) and the number of refills too late to avoid resending
+ *    stale bits, JP the histogram of intervals between packet starts and JR that of the time from a register being loaded
+ *    to the first bit of its packet on the rails (both 1024 microsecond bins).  In the LocalWeb build (COMM_INTERFACE 5)
+ *    also <JW COUNT MAX B0 ... B15>, the time from the web server queuing a command to it being run (1024 microsecond
+ *    bins); JW plus JR is the latency from the web to the track.  COUNT is the number of samples and MAX the largest,
+ *    in microseconds.  The last bin holds all larger values.  Each line goes whole to the interface that asked only.
+ *    Returns <X> for anything but <J> and <J 0>, and on builds that keep none of these statistics
+ */
+#if USE_DCC_GENERATOR_ESP32 || COMM_INTERFACE == 5
+      {
+        CommandArgs a;
+        if(!a.parse(com+1,0,1) || (a.n==1 && !a.inRange(0,0,0))){
+          CommManager::reject();
+          break;
+        }
+        if(a.n==0){
+#if USE_DCC_GENERATOR_ESP32
+          GenerateDCC::showStats();
+#endif
+#if COMM_INTERFACE == 5
+          LocalWebInterface::showLatency();
+#endif
+        } else{
+#if USE_DCC_GENERATOR_ESP32
+          GenerateDCC::resetStats();
+#endif
+#if COMM_INTERFACE == 5
+          LocalWebInterface::resetLatency();
+#endif
+        }
+      }
+#else
+      CommManager::reject();
+#endif
+      break;
+
+/***** SET OPTIONS OF THE INTERFACE SENDING THE COMMAND  ****/
+
+    case 'U':     // <U BIN ON>
+/*
+ *    switches replies sent through the interface this command arrived on between text and binary frames (see BinaryCommand.h).
+ *    Binary commands are accepted on every interface either way
+ *
+ *    ON: 1 = binary replies, 0 = text replies
+ *
+ *    returns: <U BIN ON>, sent in the format used before the switch, or <X> if the interface can not send binary frames
+ *
+ *    <U SUB TOPIC ...>
+ *
+ *    selects which replies about changes made elsewhere (by other interfaces, or sensors changing) the interface gets.
+ *    Replies to its own commands, and replies outside these topics, are always sent.  Every topic is selected at start
+ *
+ *    TOPIC: THROTTLE (T), SENSORS (Q and q), TURNOUTS (H), OUTPUTS (Y), POWER (p and a), PROGRAMMING (r), DEBUG (* and m),
+ *           ALL, NONE, or a MASK as returned.  A TOPIC with + is added and one with - taken away, starting from the
+ *           topics selected now if the first TOPIC has either: <U SUB -DEBUG> keeps everything but DEBUG.  See Topics.h
+ *
+ *    returns: <U SUB MASK> with MASK the sum of 1 THROTTLE, 2 SENSORS, 4 TURNOUTS, 8 OUTPUTS, 16 POWER, 32 PROGRAMMING
+ *    and 64 DEBUG, or <X> if a TOPIC is unknown
+ */
+      CommManager::option(com+1);
+      break;
+
+/***** RESYNCHRONIZE A CLIENT FROM THE CHANGE JOURNAL  ****/
+
+    case 'V':     // <V EPOCH N> or <V 0>
+/*
+ *    sends a client that reconnects only what changed since the last journal number it saw (see Journal.h): the
+ *    latest state of each throttle, turnout, output, sensor and motor board that changed, in the order of the changes.
+ *    If the journal no longer holds all of those changes, N is 0, or EPOCH is not this boot's (the base station
+ *    restarted), sends a full snapshot instead: power status, throttles, turnouts, outputs and sensors, as <s>, <T>,
+ *    <Z> and <Q> would.  Throttles are reported by cab in both cases
+ *
+ *    EPOCH, N: the numbers from the last <V EPOCH N> reply the client got; <V 0> the first time
+ *
+ *    returns: the <T>, <H>, <Y>, <Q>/<q> and <p> replies for the changes or the snapshot, to this interface only,
+ *    then <V EPOCH N> with EPOCH the number of this boot and N the number of the latest change
+ */
+      {
+        CommandArgs a;
+        if(!a.parse(com+1,1,2) || !a.inRange(0,0,a.n==1 ? 0 : 0xFFFF) || (a.n==2 && !a.inRange(1,0,0x7FFFFFFF))){
+          CommManager::reject();
+          break;
+        }
+        uint32_t n=a.n==2 ? a.v[1] : 0;
+        if(n==0 || a.v[0]!=Journal::epoch() || n>Journal::seq || !Journal::covers(n)){
+          MotorBoardManager::showStatus(true);
+          mRegs->showThrottles(true);
+          if(Turnout::firstTurnout!=NULL)
+            Turnout::show(0,true);
+          if(Output::firstOutput!=NULL)
+            Output::show(0,true);
+          if(Sensor::firstSensor!=NULL)
+            Sensor::status(true);
+        } else {
+          Journal::since(n,[](const JournalEntry &e){
+            char buf[48];
+            Journal::format(e,buf,sizeof(buf));
+            CommManager::respond("%s",buf);
+          });
+        }
+        CommManager::respond("<V %u %lu>",Journal::epoch(),(unsigned long)Journal::seq);
+      }
+      break;
+
+/***** SHOW TRANSMIT QUEUE COUNTERS  ****/
+
+    case 'C':     // <C>
+/*
+ *    lists for every interface how many reply bytes went through its transmit queue (see TxRing.h).  Status replies
+ *    (T, H, Y, Q, q and a) replace older ones about the same thing that are still queued.  Replies to the interface's
+ *    own commands wait for space, and are dropped only when the interface takes nothing for TX_WAIT_MICROS; other
+ *    replies are dropped if the queue is full.  FILTERED counts replies the
+ *    interface did not subscribe to (see <U SUB>).  COMMANDS counts the commands the interface ran, and DEFERRED how
+ *    often it stopped reading with commands waiting because it or one of its clients used up its commands per second
+ *    (see RateLimit.h).  OVERRUNS counts passes of the main loop in which reading commands used up COMM_UPDATE_MICROS
+ *
+ *    returns: <C INDEX QUEUED SENT DROPPED MERGED FILTERED COMMANDS DEFERRED> for each interface, then <C OVERRUNS N>
+ */
+      CommManager::showCounters();
+      break;
+
+/***** READ THE DIAGNOSTIC LOG  ****/
+
+    case 'G':     // <G>
+/*
+ *    lists the records held in the diagnostic log (see Log.h), oldest first, without formatting them.  FORMAT is the
+ *    number of the LogFormat and the ARGs its numbers, which Log::format turns into text on a host.  TIME is micros()
+ *    when the record was made.  DROPPED counts records overwritten before the main loop printed them to Serial
+ *
+ *    returns: <G TIME FORMAT ARG ...> for each record, then <G DROPPED N>.  Returns <X> on builds that record
+ *    nothing (see LOG_RECORDING), which the AVR is unless built with -DLOG_LEVEL=LOG_DEBUG
+ */
+#if LOG_RECORDING
+      {
+        LogEntry e;
+        for(uint16_t i=0;Log::get(i,e);i++){
+          char buf[64];
+          int n=snprintf(buf,sizeof(buf),"<G %lu %d",(unsigned long)e.time,e.format);
+          for(uint8_t j=0;j<e.n;j++)
+            n+=snprintf(buf+n,sizeof(buf)-n," %ld",(long)e.args[j]);
+          CommManager::printf("%s>",buf);
+        }
+        CommManager::printf("<G DROPPED %lu>",(unsigned long)Log::dropped);
+      }
+#else
+      CommManager::reject();
+#endif
+      break;
+
+/***** SEND A GROUP OF MAIN TRACK COMMANDS TOGETHER  ****/
+
+    case '[':     // <[>
+/*
+ *    starts a batch: the packets of the following main operations track commands (t, f, a, w, b, M and T ID THROW) from this
+ *    interface for the current track are collected, up to BATCH_MAX_MEMBERS, instead of being sent.  Commands are checked and
+ *    reply as usual.  A <[> while a batch is open drops the collected packets and starts again
+ *
+ *    returns: NONE, or <X> if the batch committed before has not started yet
+ */
+      CommandBatch::begin();
+      break;
+
+    case ']':     // <]>
+/*
+ *    commits the open batch: the first packets of all members are sent back to back, ahead of the packets being refreshed,
+ *    then the remaining repeats of function and accessory packets.  Throttles are refreshed as usual afterwards
+ *
+ *    returns: <] MEMBERS FIRST LAST>
+ *    once the last member has started, where MEMBERS is the number of packets sent together and FIRST and LAST are the
+ *    microseconds from the start of the batch until the generator started the first packet of the first and of the last
+ *    member (-1 if it did not within a second), as seen by the main loop, so to within one pass of it.  A batch starts when
+ *    the one before is done with its repeats; nothing waits for it.  On the ESP32 the generator works one refill ahead of
+ *    the rails.  Returns <X> if no batch is open
+ */
+      CommandBatch::commit();
+      break;
+
 /***** TURN ON POWER FROM MOTOR SHIELD TO TRACKS  ****/
 
     case '1':      // <1>
@@ -306,11 +513,7 @@ void SerialCommand::parse(const char *com){
  *    returns: series of status messages that can be read by an interface to determine status of DCC++ Base Station and important settings
  */
       MotorBoardManager::showStatus();
-      for(int i=1;i<=MAX_MAIN_REGISTERS;i++){
-        if(mRegs->speedTable[i]==0)
-          continue;
-        CommManager::printf("<T%d %d %d>", i, mRegs->speedTable[i]>0 ? mRegs->speedTable[i] : -mRegs->speedTable[i], mRegs->speedTable[i]>0 ? 1 : 0);
-      }
+      mRegs->showThrottles();
       CommManager::printf("<iDCC++ BASE STATION FOR ARDUINO %s / %s: V-%s / %s %s>", ARDUINO_TYPE, MOTOR_SHIELD_NAME, VERSION, __DATE__, __TIME__);
       CommManager::showInitInfo();
       Turnout::show();
@@ -432,6 +635,70 @@ void SerialCommand::parse(const char *com){
       pRegs->writeTextPacket(com+1);
       break;
 
+/***** SEND A MAIN TRACK COMMAND TO A POWER DISTRICT  ****/
+
+    case '@':       // <@NAME COMMAND>
+/*
+ *    sends a main operations track command to the register list of the named track output instead of MAIN
+ *
+ *    NAME: the name of the track, MAIN or PROG, or one of the EXTRA_DISTRICTS defined in Config.h
+ *    COMMAND: one of the t, f, a, w, b or M commands, with its parameters
+ *
+ *    returns: whatever COMMAND returns, or <X> if NAME is not a track or COMMAND can not be sent to a district
+ */
+      {
+        const char *name=com+1;
+        const char *cmd=name;
+        while(*cmd!=' ' && *cmd!='\0')
+          cmd++;
+        Track *track=TrackManager::find(name, cmd-name);
+        while(*cmd==' ')
+          cmd++;
+        if(track==nullptr || *cmd=='\0' || strchr("tfawbM", *cmd)==nullptr){
+          CommManager::reject();
+          break;
+        }
+        volatile RegisterList *saved=mRegs;
+        mRegs=track->regs;
+        parse(cmd);
+        mRegs=saved;
+      }
+      break;
+
+/***** TAG A COMMAND WITH A REQUEST ID  ****/
+
+    case '#':       // <#ID COMMAND>
+/*
+ *    runs COMMAND and then acknowledges it to the interface that sent it (only), so that a client can keep several commands
+ *    in flight and match each one to its outcome.  COMMAND replies as usual
+ *
+ *    ID: a number from 0 through 65535 chosen by the client
+ *    COMMAND: any other command, with its parameters
+ *
+ *    returns: <# ID OK MICROS> after the replies of COMMAND, once it has been applied or its packets loaded for the track,
+ *    where OK is 1, or 0 if COMMAND failed (answered <X>, <mInvalid Packet> or <ident -1>, or read or wrote a CV
+ *    and got no ACK), and MICROS the time the base station took to run it.
+ *    Returns <X> if ID is missing or out of range
+ */
+      {
+        const char *cmd=com+1;
+        uint32_t id=0;
+        byte digits=0;
+        for(;*cmd>='0' && *cmd<='9' && digits<6;cmd++,digits++)
+          id=id*10+(*cmd-'0');
+        while(*cmd==' ')
+          cmd++;
+        if(digits==0 || id>65535 || *cmd=='\0' || *cmd=='#'){
+          CommManager::reject();
+          break;
+        }
+        uint16_t errors=CommManager::errorCount();
+        unsigned long start=micros();
+        parse(cmd);
+        acknowledge(id, errors, start);
+      }
+      break;
+
 /***** ATTEMPTS TO DETERMINE HOW MUCH FREE SRAM IS AVAILABLE IN ARDUINO  ****/
 
     case 'F':     // <F>
@@ -443,7 +710,7 @@ void SerialCommand::parse(const char *com){
  *     returns: <f MEM>
  *     where MEM is the number of free bytes remaining in the Arduino's SRAM
  */
- #ifndef ARDUINO_ARCH_ESP32
+ #if !defined(ARDUINO_ARCH_ESP32) && !defined(DCCPP_HOST_BUILD)
       int v;
       CommManager::printf("<f%d>", (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval));
 #endif
@@ -458,14 +725,14 @@ void SerialCommand::parse(const char *com){
  */
       CommManager::printf("\n");
       for(Register *p=mRegs->reg;p<=mRegs->maxLoadedReg;p++){
-        CommManager::printf("M%d:\t%d\t%d\t%d\t", (int)(p-mRegs->reg), (int)p, (int)p->activePacket, p->activePacket->nBits);
+        CommManager::printf("M%d:\t%d\t%d\t%d\t", (int)(p-mRegs->reg), (int)(intptr_t)p, (int)(intptr_t)p->activePacket, p->activePacket->nBits);
         for(int i=0;i<10;i++){
           CommManager::printf("%02x\t", p->activePacket->buf[i]);
         }
         CommManager::printf("\n");
       }
       for(Register *p=pRegs->reg;p<=pRegs->maxLoadedReg;p++){
-        CommManager::printf("P%d:\t%d\t%d\t%d\t", (int)(p-pRegs->reg), (int)p, (int)p->activePacket, p->activePacket->nBits);
+        CommManager::printf("P%d:\t%d\t%d\t%d\t", (int)(p-pRegs->reg), (int)(intptr_t)p, (int)(intptr_t)p->activePacket, p->activePacket->nBits);
         for(int i=0;i<10;i++){
           CommManager::printf("%02x\t", p->activePacket->buf[i]);
         }
@@ -484,3 +751,9 @@ void SerialCommand::parse(const char *com){
 }; // SerialCommand::parse
 
 ///////////////////////////////////////////////////////////////////////////////
+
+void SerialCommand::acknowledge(uint16_t id, uint16_t errors, unsigned long start){
+  CommManager::respond("<# %u %d %lu>", id, CommManager::errorCount()==errors, micros()-start);
+} // SerialCommand::acknowledge
+
+///////////////////////////////////////////////////////////////////////////////
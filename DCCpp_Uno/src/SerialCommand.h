@@ -16,6 +16,7 @@ struct SerialCommand{
   static volatile RegisterList *mRegs, *pRegs;
   static void init(volatile RegisterList *, volatile RegisterList *);
   static void parse(const char *);
+  static void acknowledge(uint16_t id, uint16_t errors, unsigned long start);   // errors: CommManager::errorCount() before the command ran
 }; // SerialCommand
   
 #endif
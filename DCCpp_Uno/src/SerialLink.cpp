@@ -0,0 +1,271 @@
+/**********************************************************************
+
+SerialLink.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "SerialLink.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint16_t crc16(const uint8_t *p, uint8_t n){
+  uint16_t crc=0xFFFF;
+  while(n--){
+    crc^=(uint16_t)*p++<<8;
+    for(uint8_t i=0;i<8;i++)
+      crc=(crc&0x8000) ? (crc<<1)^0x1021 : crc<<1;
+  }
+  return crc;
+} // crc16
+
+///////////////////////////////////////////////////////////////////////////////
+
+SerialLink::SerialLink(Stream &serial) : counters(), serial(serial), linkUp(false), session(0), peerSession(0), peerFresh(true),
+  lastSent(0), lastHeard(0), txHead(0), txUsed(0), txFramed(0), nFrames(0), firstSeq(0), peerCredit(0), sentAt(0),
+  rxHead(0), rxUsed(0), expected(0), ackDue(false), creditSent(0), got(0){
+  goDown();
+} // SerialLink::SerialLink
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SerialLink::poll(){
+  while(serial.available())
+    receive(serial.read());
+  unsigned long now=micros();
+  if(!linkUp){
+    if(now-lastSent>=LINK_HELLO_MICROS)
+      hello();
+    return;
+  }
+  if(now-lastHeard>=LINK_DEAD_MICROS){
+    goDown();
+    return;
+  }
+  if(nFrames>0 && now-sentAt>=LINK_RETRY_MICROS){   // go back to the oldest frame not acknowledged
+    for(uint8_t i=0;i<nFrames;i++)
+      sendData(i);
+    counters.resent+=nFrames;
+    sentAt=now;
+  }
+  while(nFrames<LINK_WINDOW && txUsed>txFramed && peerCredit>(int)txFramed){
+    int len=txUsed-txFramed;
+    if(len>LINK_PAYLOAD)
+      len=LINK_PAYLOAD;
+    if(len>peerCredit-(int)txFramed)
+      len=peerCredit-txFramed;
+    frameLength[nFrames]=len;
+    txFramed+=len;
+    if(nFrames==0)
+      sentAt=now;
+    sendData(nFrames++);
+    counters.sent++;
+  }
+  uint16_t credit=rxFree()<255 ? rxFree() : 255;
+  if(ackDue || credit>=creditSent+LINK_PAYLOAD || now-lastSent>=LINK_IDLE_MICROS)
+    send(LINK_ACK,0,NULL,0);
+} // SerialLink::poll
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SerialLink::receive(uint8_t b){
+  if(got==0 && b!=LINK_SYNC)
+    return;                                // text printed outside frames, or the rest of a broken frame
+  in[got++]=b;
+  if(got==3 && (in[1]<LINK_HELLO || in[1]>LINK_ACK || in[2]>LINK_PAYLOAD)){
+    got=0;
+    counters.rejected++;
+    return;
+  }
+  if(got<3 || got<8+in[2])
+    return;
+  got=0;
+  uint8_t n=in[2];
+  if(crc16(in+1,5+n)!=((uint16_t)in[6+n]<<8 | in[7+n])){
+    counters.rejected++;
+    return;
+  }
+  handle(micros());
+} // SerialLink::receive
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SerialLink::handle(unsigned long now){
+  uint8_t type=in[1], n=in[2], seq=in[3], ack=in[4], credit=in[5];
+  const uint8_t *p=in+6;
+
+  if(type==LINK_HELLO){
+    if(n<8)
+      return;
+    uint16_t s=(uint16_t)p[0]<<8 | p[1];
+    uint16_t heard=(uint16_t)p[2]<<8 | p[3];
+    if(linkUp && s!=peerSession)
+      goDown();                            // the other end went down, or started again
+    peerSession=s;
+    if(p[7])
+      peerFresh=true;
+    if(!linkUp && heard==session)
+      goUp(credit,p[5],p[6]);
+    if(!p[4])                              // it is not up yet, let it hear us
+      hello();
+    return;
+  }
+  if(!linkUp)
+    return;
+  lastHeard=now;
+
+  acknowledge(ack+1,now);
+  peerCredit=credit;
+
+  if(type==LINK_DATA){
+    ackDue=true;
+    if(seq!=expected || n>rxFree()){       // a frame was lost before this one, or it was sent again
+      counters.rejected++;
+      return;
+    }
+    for(uint8_t i=0;i<n;i++)
+      rx[(rxHead+rxUsed+i)%LINK_RX_SIZE]=p[i];
+    rxUsed+=n;
+    expected++;
+    counters.received++;
+  }
+} // SerialLink::handle
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SerialLink::acknowledge(uint8_t next, unsigned long now){
+  uint8_t acked=next-firstSeq;             // frames in flight this acknowledges
+  if(acked>nFrames)
+    return;
+  uint16_t bytes=0;
+  for(uint8_t i=0;i<acked;i++)
+    bytes+=frameLength[i];
+  for(uint8_t i=acked;i<nFrames;i++)
+    frameLength[i-acked]=frameLength[i];
+  nFrames-=acked;
+  firstSeq+=acked;
+  txHead=(txHead+bytes)%LINK_TX_SIZE;
+  txUsed-=bytes;
+  txFramed-=bytes;
+  if(acked>0)
+    sentAt=now;
+} // SerialLink::acknowledge
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SerialLink::hello(){
+  uint8_t p[8]={(uint8_t)(session>>8),(uint8_t)session,(uint8_t)(peerSession>>8),(uint8_t)peerSession,linkUp,
+    expected,firstSeq,counters.ups==0};
+  send(LINK_HELLO,0,p,sizeof(p));
+} // SerialLink::hello
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SerialLink::sendData(uint8_t frame){
+  uint8_t p[LINK_PAYLOAD];
+  uint16_t at=txHead;
+  for(uint8_t i=0;i<frame;i++)
+    at+=frameLength[i];
+  for(uint8_t i=0;i<frameLength[frame];i++)
+    p[i]=tx[(at+i)%LINK_TX_SIZE];
+  send(LINK_DATA,firstSeq+frame,p,frameLength[frame]);
+} // SerialLink::sendData
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SerialLink::send(uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t n){
+  uint8_t f[8+LINK_PAYLOAD];
+  creditSent=rxFree()<255 ? rxFree() : 255;
+  f[0]=LINK_SYNC;
+  f[1]=type;
+  f[2]=n;
+  f[3]=seq;
+  f[4]=expected-1;
+  f[5]=creditSent;
+  for(uint8_t i=0;i<n;i++)
+    f[6+i]=payload[i];
+  uint16_t crc=crc16(f+1,5+n);
+  f[6+n]=crc>>8;
+  f[7+n]=crc;
+  serial.write(f,8+n);
+  ackDue=false;
+  lastSent=micros();
+} // SerialLink::send
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SerialLink::goDown(){
+  linkUp=false;
+  session=session*31+(uint16_t)micros()+1;
+  if(session==0)
+    session=1;
+  got=0;                                   // frames in flight are sent again once up, or dropped if the other end took them
+  lastSent=micros()-LINK_HELLO_MICROS;     // say hello at once
+} // SerialLink::goDown
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SerialLink::goUp(uint8_t credit, uint8_t peerExpected, uint8_t peerFirst){
+  unsigned long now=micros();
+  linkUp=true;
+  counters.ups++;
+  if(peerFresh){                           // it knows nothing of frames before, carry on from its numbers
+    firstSeq=peerExpected;
+    expected=peerFirst;
+    peerFresh=false;
+  }else{
+    acknowledge(peerExpected,now);
+    if(firstSeq!=peerExpected)             // cannot happen between ends that kept their numbers
+      firstSeq=peerExpected;
+    if((uint8_t)(expected-peerFirst)>LINK_WINDOW)
+      expected=peerFirst;
+  }
+  peerCredit=credit;
+  ackDue=false;
+  lastHeard=now;
+  sentAt=now-LINK_RETRY_MICROS;            // send what is still in flight at once
+} // SerialLink::goUp
+
+///////////////////////////////////////////////////////////////////////////////
+
+int SerialLink::available(){
+  return rxUsed;
+} // SerialLink::available
+
+///////////////////////////////////////////////////////////////////////////////
+
+int SerialLink::peek(){
+  return rxUsed>0 ? rx[rxHead] : -1;
+} // SerialLink::peek
+
+///////////////////////////////////////////////////////////////////////////////
+
+int SerialLink::read(){
+  if(rxUsed==0)
+    return -1;
+  uint8_t b=rx[rxHead];
+  rxHead=(rxHead+1)%LINK_RX_SIZE;
+  rxUsed--;
+  return b;
+} // SerialLink::read
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t SerialLink::write(const uint8_t *buf, size_t n){
+  unsigned long start=micros();
+  size_t done=0;
+  while(done<n){
+    if(txUsed==LINK_TX_SIZE){
+      if(!linkUp || micros()-start>=LINK_WAIT_MICROS){
+        counters.dropped+=n-done;
+        break;
+      }
+      poll();
+      continue;
+    }
+    tx[(txHead+txUsed)%LINK_TX_SIZE]=buf[done++];
+    txUsed++;
+  }
+  return done;
+} // SerialLink::write
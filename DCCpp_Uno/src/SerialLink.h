@@ -0,0 +1,117 @@
+/**********************************************************************
+
+SerialLink.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef SerialLink_h
+#define SerialLink_h
+
+#include <Arduino.h>
+
+// Reliable byte stream over the serial line between the base station and the ESP (COMM_INTERFACE 4, and the
+// DCCpp_ESP bridge on the other end).  Both ends use this same code.  Bytes written are sent in frames:
+//
+//   LINK_SYNC TYPE LENGTH SEQ ACK CREDIT PAYLOAD... CRC
+//
+// CRC is CRC-16/CCITT over TYPE to the end of PAYLOAD, high byte first.  A DATA frame carries the next SEQ.  Every
+// frame acknowledges all data frames up to ACK, and allows the other end CREDIT more payload bytes after those: the
+// free space of its receive buffer.  Data frames not acknowledged within LINK_RETRY_MICROS are sent again from the
+// oldest one (go back N).  Frames that fail the CRC or arrive out of order are dropped and recovered that way.
+//
+// Before any data, both ends send HELLO frames with their session number and the last session number they heard
+// from the other end.  An end is up once it hears its own number back, and answers a HELLO from an end that is not
+// up yet.  An end that hears nothing for LINK_DEAD_MICROS, or hears a new session number, goes down with a new number
+// of its own.  Sequence numbers carry on across sessions: a HELLO also holds the SEQ of the next data frame the end
+// accepts and of its oldest frame in flight, so on the way up each end drops the frames the other already took
+// before the ack got lost, and sends the rest again.  Every byte is delivered once, unless an end restarted; a
+// HELLO says whether the end has been up since it started, and a new one starts the numbers from the other's.
+// Nothing here blocks, except write() while the link is up and its transmit buffer is full (see LINK_WAIT_MICROS).
+
+#ifdef ARDUINO_ARCH_AVR
+  #define  LINK_TX_SIZE            96      // bytes written and not yet acknowledged
+  #define  LINK_RX_SIZE            64      // bytes received and not yet read
+#else
+  #define  LINK_TX_SIZE            1024
+  #define  LINK_RX_SIZE            512
+#endif
+#define  LINK_PAYLOAD              32      // data bytes per frame, the same on both ends
+#define  LINK_WINDOW               4       // data frames sent and not yet acknowledged
+#define  LINK_SYNC                 0xA5    // never part of the text the ends print outside frames
+#define  LINK_RETRY_MICROS         40000
+#define  LINK_HELLO_MICROS         250000
+#define  LINK_IDLE_MICROS          500000  // an idle link still sends an ACK this often
+#define  LINK_DEAD_MICROS          3000000
+#define  LINK_WAIT_MICROS          50000   // longest write() waits for the other end to take bytes
+
+enum LinkFrame : uint8_t{
+  LINK_HELLO=1,                            // payload: session (2 bytes), session heard (2 bytes), 1 if up,
+                                           // SEQ expected, SEQ of the oldest frame in flight, 1 if never up
+  LINK_DATA,
+  LINK_ACK
+}; // LinkFrame
+
+struct LinkCounters{
+  uint32_t sent;                           // data frames sent, not counting retransmissions
+  uint32_t resent;                         // data frames sent again
+  uint32_t received;                       // data frames accepted
+  uint32_t rejected;                       // frames with a bad CRC or length, and data frames out of sequence
+  uint32_t dropped;                        // bytes write() could not take
+  uint16_t ups;                            // times the link came up
+}; // LinkCounters
+
+class SerialLink : public Stream {
+public:
+  SerialLink(Stream &serial);
+  void poll();                             // reads and sends frames, call it often
+  bool up() const { return linkUp; }
+  int space() const { return LINK_TX_SIZE-txUsed; }   // bytes write() takes without waiting
+  LinkCounters counters;
+  int available();
+  int read();
+  int peek();
+  void flush() {}
+  size_t write(uint8_t b) { return write(&b,1); }
+  size_t write(const uint8_t *buf, size_t n);
+  int availableForWrite() { return space(); }
+private:
+  void receive(uint8_t b);
+  void handle(unsigned long now);
+  void hello();                            // sends our session, the one we heard and whether we are up
+  void send(uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t n);
+  void sendData(uint8_t frame);            // in-flight frame number frame, 0 the oldest
+  void goDown();
+  void goUp(uint8_t credit, uint8_t peerExpected, uint8_t peerFirst);
+  void acknowledge(uint8_t next, unsigned long now);   // the other end took every data frame before SEQ next
+  uint16_t rxFree() const { return LINK_RX_SIZE-rxUsed; }
+  Stream &serial;
+  bool linkUp;
+  uint16_t session;                        // ours, new each time the link goes down
+  uint16_t peerSession;                    // the other end's, as last heard
+  bool peerFresh;                          // the other end started again since the link was last up
+  unsigned long lastSent;
+  unsigned long lastHeard;
+  // transmit: txUsed bytes from txHead, of which txFramed are in the nFrames data frames in flight
+  uint8_t tx[LINK_TX_SIZE];
+  uint16_t txHead;
+  uint16_t txUsed;
+  uint16_t txFramed;
+  uint8_t frameLength[LINK_WINDOW];
+  uint8_t nFrames;
+  uint8_t firstSeq;                        // SEQ of the oldest frame in flight
+  int peerCredit;                          // payload bytes the other end takes after the frames it acknowledged
+  unsigned long sentAt;                    // when the oldest frame in flight was last sent
+  // receive
+  uint8_t rx[LINK_RX_SIZE];
+  uint16_t rxHead;
+  uint16_t rxUsed;
+  uint8_t expected;                        // SEQ of the next data frame to accept
+  bool ackDue;
+  uint16_t creditSent;
+  uint8_t in[6+LINK_PAYLOAD+2];            // frame being read
+  uint8_t got;
+}; // SerialLink
+
+#endif
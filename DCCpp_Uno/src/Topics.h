@@ -0,0 +1,87 @@
+/**********************************************************************
+
+Topics.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef Topics_h
+#define Topics_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Replies that report a change nobody asked for (a sensor flipping, another throttle's speed) are sorted into
+// topics by their letter, so that a client can choose which of them it gets with <U SUB TOPIC ...> (see
+// SerialCommand.cpp).  Replies outside these topics, and every reply to a client's own command, are always sent.
+// Header only, the ESP bridge in DCCpp_ESP filters its clients with the same table.
+
+#define  TOPIC_THROTTLE            0x01    // <T>
+#define  TOPIC_SENSORS             0x02    // <Q>, <q>
+#define  TOPIC_TURNOUTS            0x04    // <H>
+#define  TOPIC_OUTPUTS             0x08    // <Y>
+#define  TOPIC_POWER               0x10    // <p>, <a>
+#define  TOPIC_PROGRAMMING         0x20    // <r>
+#define  TOPIC_DEBUG               0x40    // <*>, <m>
+#define  TOPIC_ALL                 0x7F
+#define  TOPIC_NONE                0x80    // not in any topic, always sent
+
+inline uint8_t topicOf(char letter){
+  switch(letter){
+    case 'T': return TOPIC_THROTTLE;
+    case 'Q': case 'q': return TOPIC_SENSORS;
+    case 'H': return TOPIC_TURNOUTS;
+    case 'Y': return TOPIC_OUTPUTS;
+    case 'p': case 'a': return TOPIC_POWER;
+    case 'r': return TOPIC_PROGRAMMING;
+    case '*': case 'm': return TOPIC_DEBUG;
+  }
+  return TOPIC_NONE;
+} // topicOf
+
+// Reads topics separated by spaces up to the end of s or a >: names (THROTTLE SENSORS TURNOUTS OUTPUTS POWER
+// PROGRAMMING DEBUG, or ALL or NONE, in any case) or masks as a number.  A topic with a + is added and one with a -
+// taken away; when the first one has either, that starts from current, otherwise from no topics, so "-DEBUG" is
+// everything current has but DEBUG.  Returns the mask, or -1 if a topic is unknown.
+
+inline int parseTopics(const char *s, uint8_t current){
+  static const char *const names[]={"THROTTLE","SENSORS","TURNOUTS","OUTPUTS","POWER","PROGRAMMING","DEBUG"};
+  bool first=true;
+  int mask=0;
+  while(true){
+    while(*s==' ')
+      s++;
+    char sign=(*s=='+' || *s=='-') ? *s++ : 0;
+    if(first && sign)
+      mask=current;
+    first=false;
+    size_t n=strcspn(s," >");
+    if(n==0)
+      return sign ? -1 : mask;
+    int bit=-1;
+    for(int i=0;i<7;i++)
+      if(n==strlen(names[i]) && strncasecmp(s,names[i],n)==0)
+        bit=1<<i;
+    if(n==3 && strncasecmp(s,"ALL",3)==0)
+      bit=TOPIC_ALL;
+    else if(n==4 && strncasecmp(s,"NONE",4)==0)
+      bit=0;
+    else if(bit<0 && strspn(s,"0123456789")==n && n<=3){
+      bit=atoi(s);
+      if(bit>TOPIC_ALL)
+        bit=-1;
+    }
+    if(bit<0)
+      return -1;
+    if(sign=='-')
+      mask&=~bit;
+    else
+      mask|=bit;
+    s+=n;
+  }
+} // parseTopics
+
+#endif
@@ -0,0 +1,52 @@
+/**********************************************************************
+
+Tracks.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "DCCpp.h"
+#include "Tracks.h"
+#include "CommInterface.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+Track *TrackManager::registerTrack(const char *name, volatile RegisterList *regs, int signalPin, MotorBoard *board){
+  if(nTracks>=MAX_TRACKS){
+    CommManager::reject();
+    return nullptr;
+  }
+  Track *t=tracks+nTracks;
+  t->name=name;
+  t->regs=regs;
+  t->signalPin=signalPin;
+  t->board=board;
+  nTracks++;
+  return t;
+} // TrackManager::registerTrack
+
+///////////////////////////////////////////////////////////////////////////////
+
+void TrackManager::registerExtraDistricts(){
+#ifdef EXTRA_DISTRICTS
+  static const TrackConfig districts[]={ EXTRA_DISTRICTS };
+  for(const TrackConfig &d : districts)
+    registerTrack(d.name, new RegisterList(d.maxRegisters), d.signalPin,
+      MotorBoardManager::registerBoard(d.sensePin, d.enablePin, d.type, d.name));
+#endif
+} // TrackManager::registerExtraDistricts
+
+///////////////////////////////////////////////////////////////////////////////
+
+Track *TrackManager::find(const char *name, size_t length){
+  for(uint8_t i=0;i<nTracks;i++)
+    if(strlen(tracks[i].name)==length && strncasecmp(tracks[i].name, name, length)==0)
+      return tracks+i;
+  return nullptr;
+} // TrackManager::find
+
+///////////////////////////////////////////////////////////////////////////////
+
+Track TrackManager::tracks[MAX_TRACKS];
+uint8_t TrackManager::nTracks=0;
@@ -0,0 +1,49 @@
+/**********************************************************************
+
+Tracks.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef Tracks_h
+#define Tracks_h
+
+#include "PacketRegister.h"
+#include "CurrentMonitor.h"
+
+// A track output (power district) is one independently scheduled RegisterList, the pin its DCC signal is generated on
+// and the MotorBoard that powers it.  MAIN and PROG always exist, additional districts can be defined with
+// EXTRA_DISTRICTS in Config.h (ESP32 only, each district uses its own RMT channel).
+
+#ifdef ARDUINO_ARCH_ESP32
+  #define MAX_TRACKS 8
+#else
+  #define MAX_TRACKS 2
+#endif
+
+struct TrackConfig{
+  const char *name;
+  int signalPin;
+  int enablePin;
+  int sensePin;
+  MOTOR_BOARD_TYPE type;
+  int maxRegisters;
+}; // TrackConfig
+
+struct Track{
+  const char *name;
+  volatile RegisterList *regs;
+  int signalPin;
+  MotorBoard *board;
+}; // Track
+
+struct TrackManager{
+  static Track tracks[MAX_TRACKS];
+  static uint8_t nTracks;
+  static Track *registerTrack(const char *name, volatile RegisterList *regs, int signalPin, MotorBoard *board);
+  static void registerExtraDistricts();
+  static Track *find(const char *name, size_t length);
+}; // TrackManager
+
+#endif
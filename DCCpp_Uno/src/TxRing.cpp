@@ -0,0 +1,77 @@
+/**********************************************************************
+
+TxRing.cpp
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "TxRing.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint16_t TxRing::recordBytes(uint16_t n, bool keyed){
+  return n+(n+TX_RECORD_MAX-1)/TX_RECORD_MAX+(keyed ? 3 : 0);
+} // TxRing::recordBytes
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool TxRing::push(const uint8_t *data, uint16_t n, uint32_t key){
+  bool keyed=key!=0 && n<=TX_RECORD_MAX;   // only single record replies can be replaced
+  if(recordBytes(n,keyed)>space())
+    return false;
+  if(keyed)
+    replace(key);
+  counters.queued+=n;
+  uint16_t tail=(head+used)%TX_RING_SIZE;
+  while(n>0){
+    uint8_t len=n>TX_RECORD_MAX ? TX_RECORD_MAX : n;
+    uint16_t size=recordBytes(len,keyed);
+    buf[tail]=len|(keyed ? 0x80 : 0);
+    if(keyed){
+      buf[(tail+1)%TX_RING_SIZE]=key>>16;
+      buf[(tail+2)%TX_RING_SIZE]=key>>8;
+      buf[(tail+3)%TX_RING_SIZE]=key;
+    }
+    for(uint16_t i=size-len;i<size;i++)
+      buf[(tail+i)%TX_RING_SIZE]=*data++;
+    tail=(tail+size)%TX_RING_SIZE;
+    used+=size;
+    pushed+=size;
+    n-=len;
+  }
+  return true;
+} // TxRing::push
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool TxRing::unpush(const TxMark &m){
+  uint16_t n=pushed-m.pushed;              // ring bytes pushed since m
+  if(n>used || (n==used && headSent>0))    // sent, or being sent
+    return false;
+  used-=n;
+  pushed=m.pushed;
+  counters.queued=m.queued;
+  return true;
+} // TxRing::unpush
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Marks queued records with the same key as replaced, except one that is partly sent already.
+
+void TxRing::replace(uint32_t key){
+  uint16_t i=head;
+  for(uint16_t left=used;left>0;){
+    uint8_t h=buf[i];
+    uint16_t size=recordBytes(h&0x3F,h&0x80);
+    if((h&0xC0)==0x80 && !(i==head && headSent>0)){
+      uint32_t k=(uint32_t)at(i+1)<<16 | (uint32_t)at(i+2)<<8 | at(i+3);
+      if(k==key){
+        buf[i]=h|0x40;
+        counters.merged+=h&0x3F;
+      }
+    }
+    i=(i+size)%TX_RING_SIZE;
+    left-=size;
+  }
+} // TxRing::replace
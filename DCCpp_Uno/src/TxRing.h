@@ -0,0 +1,85 @@
+/**********************************************************************
+
+TxRing.h
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef TxRing_h
+#define TxRing_h
+
+#include <stdint.h>
+
+// Bounded transmit queue of one interface.  Replies are stored as records of up to TX_RECORD_MAX bytes so that a
+// reply is either queued whole or not at all, and so that a status reply can replace an older one about the same
+// thing (the same cab, turnout, output or sensor) that has not been sent yet.  A reply pushed in several parts, as
+// binary frames, is taken back with unpush() if a later part finds no space.  CommManager::update() drains the
+// queue as fast as the interface takes bytes without blocking.  Nothing here depends on the Arduino core.
+
+#ifdef ARDUINO_ARCH_AVR
+  #define  TX_RING_SIZE            128     // bytes queued per interface, including record headers
+#else
+  #define  TX_RING_SIZE            512
+#endif
+#define  TX_RECORD_MAX             63      // data bytes per record
+
+struct TxCounters{
+  uint32_t queued;                         // bytes accepted into the queue
+  uint32_t sent;                           // bytes handed to the interface
+  uint32_t dropped;                        // bytes of replies dropped because the queue was full
+  uint32_t merged;                         // bytes of replies dropped because a newer reply replaced them
+  uint32_t filtered;                       // bytes of replies not queued because the client did not subscribe to them (see Topics.h)
+}; // TxCounters
+
+struct TxMark{                             // where a reply starts, see TxRing::mark()
+  uint16_t pushed;
+  uint32_t queued;
+}; // TxMark
+
+struct TxRing{
+  uint8_t buf[TX_RING_SIZE];               // records: header (bit 7 keyed, bit 6 replaced, bits 5-0 length), 3 key bytes if keyed, data
+  uint16_t head;                           // header of the oldest record
+  uint16_t used;
+  uint8_t headSent;                        // data bytes of the oldest record already sent
+  uint16_t pushed;                         // ring bytes ever pushed, wrapping
+  TxCounters counters;
+  TxRing() : head(0), used(0), headSent(0), pushed(0), counters() {}
+  static uint16_t recordBytes(uint16_t n, bool keyed);   // ring space n data bytes take
+  uint16_t space() const { return TX_RING_SIZE-used; }
+  bool empty() const { return used==0; }
+  bool push(const uint8_t *data, uint16_t n, uint32_t key = 0);   // key 0: never replaced.  Fails if there is no space for all n bytes
+  TxMark mark() const { return {pushed,counters.queued}; }
+  bool unpush(const TxMark &m);            // takes back the records pushed since m, unless the interface has some of them
+  template<class Write> void drain(uint16_t budget, Write &&write);   // write(const uint8_t *data, uint16_t n) sends n bytes
+private:
+  uint8_t at(uint16_t i) const { return buf[i%TX_RING_SIZE]; }
+  void replace(uint32_t key);
+}; // TxRing
+
+///////////////////////////////////////////////////////////////////////////////
+
+template<class Write> void TxRing::drain(uint16_t budget, Write &&write){
+  uint8_t chunk[16];
+  while(used>0 && budget>0){
+    uint8_t h=buf[head];
+    uint8_t len=h&0x3F;
+    uint16_t data=head+1+((h&0x80) ? 3 : 0);
+    if(!(h&0x40)){                         // not replaced, send what the interface takes
+      uint8_t n=0;
+      while(headSent<len && n<sizeof(chunk) && n<budget)
+        chunk[n++]=at(data+headSent++);
+      write(chunk,n);
+      counters.sent+=n;
+      budget-=n;
+      if(headSent<len)
+        continue;
+    }
+    uint16_t size=data-head+len;           // record done, or replaced
+    head=(head+size)%TX_RING_SIZE;
+    used-=size;
+    headSent=0;
+  }
+} // TxRing::drain
+
+#endif